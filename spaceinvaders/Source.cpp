@@ -2,14 +2,41 @@
 #include <SFML/Audio.hpp>
 #include <iostream>
 #include <memory>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "particles.h"
+#include "governor.h"
+#include "pacing.h"
+#include "simulation.h"
+#include "runner.h"
+#include "render.h"
+#include "softrender.h"
+#include "rendercommands.h"
+#include "net.h"
+#include "telemetry.h"
+#include "allocations.h"
+#include "flightrecorder.h"
+#include "scenarios.h"
+
+// every allocation in the game goes through the tracker; it only counts while F4 has it on
+void* operator new(std::size_t size)
+{
+    return allocationTracker.allocate(size);
+}
 
-struct Config
+void operator delete(void* pointer) noexcept
 {
-    float minx = 300;
-    float maxx = 1300;
-    float miny = 50;
-    float maxy = 750;
-};
+    allocationTracker.release(pointer);
+}
+
+void operator delete(void* pointer, std::size_t size) noexcept
+{
+    allocationTracker.release(pointer);
+}
+
 Config config;
 
 class Textures
@@ -32,6 +59,14 @@ public:
     sf::Texture* enemyTexture;
     sf::Texture* bossTexture;
     sf::Texture* explosionTexture;
+    sf::Texture* scoreAnimationTexture;
+    sf::Texture* explosionBlueTextures[4];
+
+    // same textures, indexed by TextureId so components can refer to them by value
+    std::vector<sf::Texture*> byId;
+
+    // per texel hit masks of the ships, handed to the simulation
+    std::shared_ptr<const CollisionMasks> collisionMasks;
 
     Textures() = default;
     ~Textures()
@@ -45,96 +80,208 @@ public:
 
     void init()
     {
+        // every texture comes from the file table in render.h
+        this->byId.clear();
+        for (int i = 0; i < (int)TextureId::COUNT; i++)
+        {
+            sf::Texture* texture = new sf::Texture();
+            texture->loadFromFile(textureFile((TextureId)i));
+            this->byId.push_back(texture);
+        }
+        this->get(TextureId::BACKGROUND)->setRepeated(true);
+        this->get(TextureId::BACKGROUND_STARS)->setRepeated(true);
+
         // player
-        this->playerTexture = new sf::Texture();
-        (*this->playerTexture).loadFromFile("./assets/graphics/playerShip1_blue.png");
-        this->leftEngineTexture = new sf::Texture();
-        (*this->leftEngineTexture).loadFromFile("./assets/graphics/leftEngine.png");
-        this->rightEngineTexture = new sf::Texture();
-        (*this->rightEngineTexture).loadFromFile("./assets/graphics/rightEngine.png");
-        this->playerLaserTexture = new sf::Texture;
-        (*this->playerLaserTexture).loadFromFile("./assets/graphics/laserBlue05.png");
-        this->playerMissileTexture = new sf::Texture;
-        (*this->playerMissileTexture).loadFromFile("./assets/graphics/missile.png");
-        this->playerShieldTexture = new sf::Texture;
-        (*this->playerShieldTexture).loadFromFile("./assets/graphics/shield3.png");
+        this->playerTexture = this->get(TextureId::PLAYER);
+        this->leftEngineTexture = this->get(TextureId::LEFT_ENGINE);
+        this->rightEngineTexture = this->get(TextureId::RIGHT_ENGINE);
+        this->playerLaserTexture = this->get(TextureId::PLAYER_LASER);
+        this->playerMissileTexture = this->get(TextureId::PLAYER_MISSILE);
+        this->playerShieldTexture = this->get(TextureId::PLAYER_SHIELD);
 
         // powerups
-        this->powerupShieldTexture = new sf::Texture();
-        (*this->powerupShieldTexture).loadFromFile("./assets/graphics/powerup_shield.png");
-        this->powerupFireTexture = new sf::Texture();
-        (*this->powerupFireTexture).loadFromFile("./assets/graphics/powerup_fire.png");
+        this->powerupShieldTexture = this->get(TextureId::POWERUP_SHIELD);
+        this->powerupFireTexture = this->get(TextureId::POWERUP_FIRE);
 
         // enemy
-        this->enemyLaserTexture = new sf::Texture;
-        (*this->enemyLaserTexture).loadFromFile("./assets/graphics/laserRed05.png");
-        this->enemyTexture = new sf::Texture();
-        (*this->enemyTexture).loadFromFile("./assets/graphics/enemyRed3.png");
-        this->bossTexture = new sf::Texture();
-        (*this->bossTexture).loadFromFile("./assets/graphics/enemyRed5.png");
-        this->explosionTexture = new sf::Texture;
-        (*this->explosionTexture).loadFromFile("./assets/graphics/explosionSprite.png");
+        this->enemyLaserTexture = this->get(TextureId::ENEMY_LASER);
+        this->enemyTexture = this->get(TextureId::ENEMY);
+        this->bossTexture = this->get(TextureId::BOSS);
+        this->explosionTexture = this->get(TextureId::EXPLOSION);
+        this->scoreAnimationTexture = this->get(TextureId::SCORE_ANIMATION);
+        for (int i = 0; i < 4; i++)
+        {
+            this->explosionBlueTextures[i] = this->get((TextureId)((int)TextureId::EXPLOSION_BLUE_1 + i));
+        }
+
+        this->collisionMasks = loadCollisionMasks();
+    }
+
+    sf::Texture* get(TextureId id)
+    {
+        return this->byId[(int)id];
     }
 };
 Textures globalTextures;
 
-// utility functions
-const float pi = 3.141592f;
+// ===================================
+// ANIMATIONS
+// ===================================
 
-float norm(sf::Vector2f v)
+enum class AnimationClipId
 {
-    return std::sqrt(v.x * v.x + v.y * v.y);
-}
+    EXPLOSION = 0,
+    SCORE = 1,
+    COUNT = 2
+};
 
-sf::Vector2f normalize(sf::Vector2f v)
+// immutable description of a flipbook, built once per sprite sheet
+struct AnimationClip
 {
-    return v / norm(v);
-}
+    TextureId texture;
+    std::vector<sf::IntRect> frames;
+    float duration; // one play through all the frames
+    int plays; // 0 loops forever
+    sf::Vector2f size;
+    sf::Vector2f velocity;
+    sf::Vector2f acceleration;
 
-sf::Vector2f lerp(sf::Vector2f A, sf::Vector2f B, float t)
-{
-    return A * (1 - t) + t * B;
-}
+    float totalDuration() const
+    {
+        return this->plays == 0 ? std::numeric_limits<float>::infinity() : this->duration * this->plays;
+    }
+};
 
-sf::Vector2f bezier(std::vector<sf::Vector2f> poly, float t)
+class AnimationClips
 {
-    sf::Vector2f result;
-    std::vector<std::vector<sf::Vector2f>> vectors;
-    vectors.push_back(poly);
-    for (int i = 0; i < poly.size(); i++)
+public:
+    std::vector<AnimationClip> clips;
+
+    // horizontal strip of equally sized frames
+    void addStrip(AnimationClipId id, TextureId texture, sf::Vector2u frameSize, float duration, int plays, sf::Vector2f size, sf::Vector2f velocity = { 0, 0 }, sf::Vector2f acceleration = { 0, 0 })
     {
-		std::vector<sf::Vector2f> v;
-        v.clear();
-        for (int j = 0; j < vectors[i].size() - 1; j++)
+        AnimationClip clip;
+        clip.texture = texture;
+        clip.duration = duration;
+        clip.plays = plays;
+        clip.size = size;
+        clip.velocity = velocity;
+        clip.acceleration = acceleration;
+        int totalFrames = globalTextures.get(texture)->getSize().x / frameSize.x;
+        for (int i = 0; i < std::max(totalFrames, 1); i++)
+        {
+            clip.frames.push_back({ i * (int)frameSize.x, 0, (int)frameSize.x, (int)frameSize.y });
+        }
+        if ((int)id >= this->clips.size())
         {
-            v.push_back(lerp(vectors[i][j], vectors[i][j + 1], t));
+            this->clips.resize((int)id + 1);
         }
-        vectors.push_back(v);
+        this->clips[(int)id] = clip;
     }
-    return vectors[poly.size()-1][0];
-}
 
-sf::Vector2f computeBezierPointDeCasteljau(std::vector<sf::Vector2f> controlPoints, float t)
+    void init()
+    {
+        this->addStrip(AnimationClipId::EXPLOSION, TextureId::EXPLOSION, { 50, 50 }, 0.2f, 1, { 50, 50 });
+        this->addStrip(AnimationClipId::SCORE, TextureId::SCORE_ANIMATION, { 40, 20 }, 0.5f, 6, { 40, 20 }, { 30, -100 }, { 0, 100 });
+    }
+
+    const AnimationClip& get(AnimationClipId id) const
+    {
+        return this->clips[(int)id];
+    }
+};
+AnimationClips animationClips;
+
+// a playing animation is just a clip, a start time and a spawn point. the current frame
+// and position are derived from the pool clock, so there's nothing to tick per instance.
+struct AnimationInstance
+{
+    AnimationClipId clip;
+    float startTime;
+    sf::Vector2f position;
+};
+
+class AnimationPool
 {
-    for (int i = controlPoints.size() -1 ; i > 0 ; i--)
+public:
+    std::vector<AnimationInstance> instances;
+    float time{ 0.0f };
+    std::size_t limit{ 0 }; // live instances, 0 for no limit
+    std::vector<sf::Vertex> vertices;
+
+    void clear()
     {
-        for (int j = 0; j < i; j++)
+        this->instances.clear();
+        this->time = 0.0f;
+    }
+
+    // past the limit new animations are skipped, the ones already playing finish
+    void spawn(AnimationClipId clip, sf::Vector2f position)
+    {
+        if (this->limit && this->instances.size() >= this->limit)
         {
-            controlPoints[j] = controlPoints[j] * (1 - t) + controlPoints[j + 1] * t;
+            return;
         }
+        this->instances.push_back({ clip, this->time, position });
     }
-    return controlPoints[0];
-}
 
+    // advance the clock and compact away the finished instances in one pass
+    void update(float dt)
+    {
+        this->time += dt;
+        std::size_t alive = 0;
+        for (std::size_t i = 0; i < this->instances.size(); i++)
+        {
+            const AnimationInstance& instance = this->instances[i];
+            if (this->time - instance.startTime < animationClips.get(instance.clip).totalDuration())
+            {
+                this->instances[alive++] = instance;
+            }
+        }
+        this->instances.resize(alive);
+    }
 
-class Updatable //abstract class because it has at least one pure virtual method
-{
-public:
-    virtual void update(float dt) = 0; //pure virtual method
+    // one batched draw per clip
+    void draw(RenderBackend& backend)
+    {
+        for (int c = 0; c < (int)AnimationClipId::COUNT; c++)
+        {
+            const AnimationClip& clip = animationClips.get((AnimationClipId)c);
+            this->vertices.clear();
+            for (std::size_t i = 0; i < this->instances.size(); i++)
+            {
+                const AnimationInstance& instance = this->instances[i];
+                if ((int)instance.clip != c)
+                {
+                    continue;
+                }
+                float elapsed = this->time - instance.startTime;
+                float local = std::fmod(elapsed, clip.duration);
+                int frame = std::min((int)(local / clip.duration * clip.frames.size()), (int)clip.frames.size() - 1);
+                const sf::IntRect& rect = clip.frames[frame];
+                sf::Vector2f center = instance.position + clip.velocity * elapsed + clip.acceleration * (0.5f * elapsed * elapsed);
+                sf::Vector2f half = clip.size / 2.0f;
+
+                this->vertices.push_back(sf::Vertex(center - half, sf::Vector2f((float)rect.left, (float)rect.top)));
+                this->vertices.push_back(sf::Vertex({ center.x + half.x, center.y - half.y }, sf::Vector2f((float)(rect.left + rect.width), (float)rect.top)));
+                this->vertices.push_back(sf::Vertex(center + half, sf::Vector2f((float)(rect.left + rect.width), (float)(rect.top + rect.height))));
+                this->vertices.push_back(sf::Vertex({ center.x - half.x, center.y + half.y }, sf::Vector2f((float)rect.left, (float)(rect.top + rect.height))));
+            }
+            if (!this->vertices.empty())
+            {
+                backend.drawQuads(clip.texture, this->vertices.data(), this->vertices.size());
+            }
+        }
+    }
 };
 
 // game stuff
 
+// the scenes are a stack: the game sits on the menu, the pause screen and the results sit on
+// the game. only the top one runs. the ones below keep everything they had and carry on from
+// there when they are on top again, nothing is loaded twice. a pushed scene is 'entered',
+// main starts it fresh before its first frame: a round is a reset of the game's state, not
+// a reload
 class Navigation
 {
 public:
@@ -146,10 +293,54 @@ public:
         VICTORY = 3,
         PAUSE = 4
     };
-    Navigation::NavigationStates currentState{ Navigation::NavigationStates::MENU };
     float cooldownTimerDuration{ 2.0f };
     float cooldownTimer{ 0.0f };
-    bool gameOver{ false };
+
+    Navigation::NavigationStates current() const
+    {
+        return this->stack.back();
+    }
+
+    void push(Navigation::NavigationStates state)
+    {
+        this->stack.push_back(state);
+        this->entered = true;
+    }
+
+    // back to the scene below, which resumes
+    void pop()
+    {
+        if (this->stack.size() > 1)
+        {
+            this->stack.pop_back();
+        }
+    }
+
+    // back down to 'state', which resumes
+    void popTo(Navigation::NavigationStates state)
+    {
+        while (this->stack.size() > 1 && this->current() != state)
+        {
+            this->stack.pop_back();
+        }
+    }
+
+    // back down to 'state' and start it over
+    void restart(Navigation::NavigationStates state)
+    {
+        this->popTo(state);
+        this->entered = true;
+    }
+
+    // true once after a push or a restart, for main to start the new top scene
+    bool takeEntered()
+    {
+        return std::exchange(this->entered, false);
+    }
+
+private:
+    std::vector<Navigation::NavigationStates> stack{ Navigation::NavigationStates::MENU };
+    bool entered{ false };
 };
 Navigation navigation;
 
@@ -193,1040 +384,216 @@ sf::VertexArray createVertexArray(std::vector<sf::Vector2f> v, sf::Color color)
     return va;
 }
 
-// -------------------------------
-// class definitions
-// -------------------------------
-
-class GameEntity : public sf::Drawable, public Updatable
+class MenuEntity
 {
 public:
-    sf::Vector2f position;
-    sf::Vector2f velocity;
-    sf::Vector2f acceleration;
-    sf::Sprite sprite;
-    sf::Vector2f size;
+    bool keyPressed, restartPressed;
+    int currentMenu, menuOptions;
+    float menuOptionSelected, menuOptionSelectCooldown;
 
-    GameEntity()
-    {
-        ;
-    }
+    float startButtonSpriteSize;
+    float exitButtonSpriteSize;
+    float menuBackgroundSpriteSize;
 
-    GameEntity(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace)
-    {
-        this->sprite.setTexture((*texture));
-        this->sprite.setOrigin(texture->getSize().x / 2, texture->getSize().y / 2);
-        this->sprite.setScale(sizeInWorldSpace.x / texture->getSize().x, sizeInWorldSpace.y / texture->getSize().y);
-        this->acceleration = acceleration;
-        this->velocity = velocity;
-        this->position = position;
-        this->size = sizeInWorldSpace;
-    }
+    sf::Vector2f menuPosition;
 
-    ~GameEntity()
+    void menu_init()
     {
-        ;
-    }
+        this->keyPressed = false;
+        this->restartPressed = false;
+        this->menuOptions = 2;
+        this->currentMenu = 0; // start button
+        this->menuOptionSelected = 0.0f;
+        this->menuOptionSelectCooldown = 0.25f;
 
-    GameEntity& operator=(const GameEntity& e)
-    {
-        this->sprite = e.sprite;
-        this->acceleration = e.acceleration;
-        this->velocity = e.velocity;
-        this->position = e.position;
+        // textures come from globalTextures, only the on screen widths live here
+        this->menuBackgroundSpriteSize = 200.0f;
+        this->startButtonSpriteSize = 190.0f;
+        this->exitButtonSpriteSize = 190.0f;
 
-        return *this;
+        this->menuPosition = { config.minx + (config.maxx - config.minx) / 3, config.miny + (config.maxy - config.miny) / 2 };
     }
 
-    void virtual update(float dt) override
+    // whole texture, top left corner at position, scaled to 'width' (0 keeps the native size)
+    void drawImage(RenderBackend& frame, TextureId texture, sf::Vector2f position, float width)
     {
-        this->velocity += this->acceleration * dt;
-        this->position += this->velocity * dt;
-        this->sprite.setPosition(this->position);
+        sf::Vector2u native = frame.textureSize(texture);
+        sf::Vector2f size(native);
+        if (width > 0.0f && native.x > 0)
+        {
+            size *= width / native.x;
+        }
+        frame.drawSprite(texture, { 0, 0, (int)native.x, (int)native.y }, position + size / 2.0f, size);
     }
 
-    void changeVelocity(sf::Vector2f v)
+    void menu_loop(float dt, sf::RenderWindow& window, RenderBackend& frame)
     {
-        this->velocity = v;
+        if (this->menuOptionSelected != 0.0f)
+        {
+            this->menuOptionSelected -= dt;
+            if (this->menuOptionSelected < 0.0f)
+            {
+                this->menuOptionSelected = 0.0f;
+            }
+        }
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up) || sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
+        {
+            if (this->menuOptionSelected == 0.0f)
+            {
+                this->currentMenu = (this->currentMenu + 1) % this->menuOptions;
+                this->menuOptionSelected = this->menuOptionSelectCooldown;
+            }
+        }
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Enter))
+        {
+            if (this->currentMenu == 0 && navigation.current() == Navigation::NavigationStates::MENU)
+            {
+                navigation.push(Navigation::NavigationStates::GAME);
+            }
+            else
+            {
+                window.close();
+            }
+        }
+
+        // draw
+        frame.clear(sf::Color::Black);
+        frame.setLayer((int)FrameLayer::BACKGROUND);
+        this->drawImage(frame, TextureId::MENU_BACKGROUND, this->menuPosition, this->menuBackgroundSpriteSize);
+        frame.setLayer((int)FrameLayer::HUD);
+        this->drawImage(frame, this->currentMenu == 0 ? TextureId::START_BUTTON_SELECTED : TextureId::START_BUTTON, this->menuPosition + sf::Vector2f(5, 125), this->startButtonSpriteSize);
+        this->drawImage(frame, this->currentMenu == 1 ? TextureId::EXIT_BUTTON_SELECTED : TextureId::EXIT_BUTTON, this->menuPosition + sf::Vector2f(5, 175), this->exitButtonSpriteSize);
     }
 
-    void changePosition(sf::Vector2f v)
+    // the results screen waits a moment, then R plays another round right away and any
+    // other key goes back to the menu
+    void results_init()
     {
-        this->position = v;
-        this->sprite.setPosition(this->position);
+        this->keyPressed = false;
+        this->restartPressed = false;
+        navigation.cooldownTimer = navigation.cooldownTimerDuration;
     }
 
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const override
+    void results_loop(float dt, RenderBackend& frame, TextureId image)
     {
-        target.draw(this->sprite);
+        if (navigation.cooldownTimer > 0.0f)
+        {
+            navigation.cooldownTimer -= dt;
+        }
+        else if (this->restartPressed)
+        {
+            navigation.restart(Navigation::NavigationStates::GAME);
+            return;
+        }
+        else if (this->keyPressed)
+        {
+            navigation.popTo(Navigation::NavigationStates::MENU);
+            return;
+        }
+        frame.clear(sf::Color::Black);
+        frame.setLayer((int)FrameLayer::HUD);
+        this->drawImage(frame, image, this->menuPosition, 0.0f);
+        frame.drawText("R to play again", this->menuPosition + sf::Vector2f(0, 250), 24, sf::Color::Cyan);
     }
+
 };
 
-// projectiles
 
-class Projectile : public GameEntity
+
+class Game
 {
 public:
-    int damage{ 100 };
 
-    Projectile() = default;
+    // text
+    sf::Font font;
 
-    Projectile(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace, int damage) :
-        GameEntity(position, acceleration, velocity, texture, sizeInWorldSpace)
-    {
-    }
+    // game area boundaries
+    float minx, maxx, miny, maxy;
+    std::vector<sf::Vector2f> boundaries;
 
-    void virtual update(float dt) override
-    {
-        this->GameEntity::update(dt);
-    }
+    sf::Vector2i mousePos;
+    sf::Vector2f mousePosWorld;
 
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const
-    {
-        target.draw(this->sprite);
-    }
-};
+    bool lPressed, rPressed, uPressed;
+    bool changeDirection;
+    bool debugEnabled;
 
-class Laser : public Projectile
-{
-public:
+    // background
+    sf::Texture* backgroundTexture;
+    sf::Texture* backgroundTexture2;
+    sf::Vector2u backgroundSize;
+    float backgroundSpriteSize;
+    sf::Vector2i backgroundVelocity;
+    sf::Vector2f backgroundDefaultPosition;
+    sf::Vector2i backgroundTextureSize;
+    sf::Vector2i backgroundTexturePosition;
+    sf::Vector2f backgroundTexturePositionFloat;
+    sf::Vector2i backgroundTexturePosition2;
+    sf::Vector2f backgroundTexturePositionFloat2;
 
-    Laser() = default;
+    std::vector<sf::Vector2f> backgroundStars;
+    float backgroundStarsSpeed;
+    float backgroundStarsAmount;
 
-    Laser(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace, int damage):
-        Projectile(position, acceleration, velocity, texture, sizeInWorldSpace, damage)
-    {
-        this->damage = damage;
-    }
+    // the match itself; Game only reads it back to draw and play sounds
+    Simulation sim;
+    // hud strings and the command sort of the current frame, main resets it after submitting
+    FrameArena frameArena{ 256 * 1024 };
+    // 2 for co-op: a second keyboard set, or the remote player when hosting
+    int playerCount{ 1 };
+    NetHost* host{ nullptr };
+    float netAccumulator{ 0.0f }, netClock{ 0.0f };
+    AnimationPool animations;
+    // lowers resolution and effects when frames run long, main feeds it the frame times
+    FrameGovernor governor;
+    // main's frame pacer, for the debug overlay
+    const FramePacer* pacer{ nullptr };
+
+    // particles and the events that emit them
+    ParticleSystem particles;
+    ParticleEmitter deathEmitter, hitEmitter, thrustEmitter, shieldEmitter;
 
-    void update(float dt)
-    {
-        this->GameEntity::update(dt);
-    }
+    // player
+    sf::Texture* playerTexture;
+    sf::Vector2u playerSize;
+    float playerSpriteSize;
+    float playerSpeed;
 
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const override
-    {
-        target.draw(this->sprite);
-    }
-};
+    // power ups
+    sf::Texture* powerupShieldTexture;
+    sf::Texture* powerupFireTexture;
 
-class Missile : public Projectile
-{
-public:
-	int damage{ 200 };
-	float speed{ 200.0f };
-	std::vector<sf::Vector2f> path;
-	float currentTime{ 0.0f };
-
-    Missile() = default;
-
-    Missile(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace, int damage, std::vector<sf::Vector2f> path)
-        :Projectile(position, acceleration, velocity, texture, sizeInWorldSpace, damage)
-	{
-		this->damage = damage;
-		this->speed = 200.0f;
-		this->currentTime = 0.0f;
-
-		this->path.clear();
-		for (int i = 0; i < path.size(); i++)
-		{
-			this->path.push_back(path[i]);
-		}
-	}
-
-	void update(float dt)
-	{
-		float totalTime = std::fabs((config.maxy - config.miny) / this->speed);
-		this->currentTime += dt;
-		this->changePosition(computeBezierPointDeCasteljau(path, this->currentTime / totalTime));
-		if (currentTime > totalTime)
-		{
-			this->acceleration = { 0 ,0 };
-			this->velocity = { this->speed, 0 };
-		}
-	}
-
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const override
-    {
-        target.draw(this->sprite);
-    }
-};
+    // enemy
+    sf::Texture* enemyTexture;
+    sf::Texture* bossTexture;
 
-// powerups
+    // player laser
+    sf::Texture* playerLaserTexture;
+    sf::Vector2f playerLaserSize;
+    float playerLaserSpriteSize;
+    float playerLaserSpeed;
 
-class Powerup : public GameEntity
-{
-public:
-    enum class PowerupTypes
-    {
-        SHIELD = 0,
-        FIRE = 1
-    };
-    PowerupTypes type;
+    // enemy laser
+    sf::Texture* enemyLaserTexture;
+    sf::Vector2f enemyLaserSize;
+    float enemyLaserSpriteSize;
+    float enemyLaserSpeed;
 
-    Powerup(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace, PowerupTypes type):
-        GameEntity(position, acceleration, velocity, texture, sizeInWorldSpace)
-    {
-        this->type = type;
-    }
+    // explosion
+    sf::Texture* explosionTexture;
 
-    void update(float dt)
-    {
-        this->GameEntity::update(dt);
-    }
+    // sounds
+    float masterVolume = 10.0f;
+    sf::SoundBuffer playerLaserBuffer;
+    sf::Sound playerLaserSound;
+    sf::SoundBuffer playerMissileBuffer;
+    sf::Sound playerMissileSound;
+    sf::SoundBuffer enemyLaserBuffer;
+    sf::Sound enemyLaserSound;
+    sf::SoundBuffer enemyExplosionBuffer;
+    sf::Sound enemyExplosionSound;
 
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const
-    {
-        target.draw(this->sprite);
-    }
-};
-
-// ===================================
-// FIRING PATTERNS
-// ===================================
-
-// firing pattern interface
-
-class IFiringPattern
-{
-public:
-    sf::Texture* texture;
-    sf::Vector2f size;
-    float speed;
-    float damage;
-
-    virtual std::vector<Projectile*> fire(GameEntity* actor) = 0;
-    virtual ~IFiringPattern() = default;
-};
-
-// laser firing patterns
-class SingleLaser : public IFiringPattern
-{
-public:
-    SingleLaser(sf::Texture* texture, sf::Vector2f size, float speed, float damage)
-    {
-        this->texture = texture;
-        this->size = size;
-        this->speed = speed;
-        this->damage = damage;
-    }
-    std::vector<Projectile*> fire(GameEntity* actor)
-    {
-        std::vector<Projectile*> v;
-        v.push_back(new Laser(actor->position, actor->acceleration, sf::Vector2f({ 0.0f, -this->speed }), this->texture, this->size, this->damage));
-        return v;
-    }
-};
-
-class BurstLaser : public IFiringPattern
-{
-public:
-    BurstLaser(sf::Texture* texture, sf::Vector2f size, float speed, float damage)
-    {
-        this->texture = texture;
-        this->size = size;
-        this->speed = speed;
-        this->damage = damage;
-    }
-
-    std::vector<Projectile*> fire(GameEntity* actor)
-    {
-        float angle = 5 * pi / 12;
-        std::vector<Projectile*> v;
-        v.push_back(new Laser(actor->position, actor->acceleration, sf::Vector2f({ 0.0f, -this->speed }), this->texture, this->size, this->damage));
-        v.push_back(new Laser(actor->position, actor->acceleration, sf::Vector2f({ this->speed * std::cos(angle), -this->speed * std::sin(angle) }), this->texture, this->size, this->damage));
-        v.push_back(new Laser(actor->position, actor->acceleration, sf::Vector2f({ -this->speed * std::cos(angle), -this->speed * std::sin(angle) }), this->texture, this->size, this->damage));
-        return v;
-    }
-};
-
-class MissileCluster : public IFiringPattern
-{
-public:
-    MissileCluster(sf::Texture* texture, sf::Vector2f size, float speed, float damage)
-    {
-        this->texture = texture;
-        this->size = size;
-        this->speed = speed;
-        this->damage = damage;
-    }
-
-	std::vector<Projectile*> fire2(GameEntity* actor)
-	{
-		std::vector<Projectile*> v;
-		std::vector<sf::Vector2f> path;
-
-        // right side
-		path.push_back(actor->position);
-		path.push_back(actor->position + sf::Vector2f({ 100.0f, 0.0f }));
-		path.push_back(actor->position + sf::Vector2f({ 100.0f, -(config.maxy - config.miny) / 3 }));
-		path.push_back(actor->position + sf::Vector2f({ -100.0f, -(config.maxy - config.miny) / 3 }));
-		path.push_back(actor->position + sf::Vector2f({ -100.0f, -2 * (config.maxy - config.miny) / 3 }));
-		path.push_back(actor->position + sf::Vector2f({ 100.0f, -config.maxy }));
-		v.push_back(new Missile(actor->position, actor->acceleration, actor->velocity, this->texture, this->size, this->damage, path));
-
-		path.clear();
-        path.push_back(actor->position);
-		path.push_back(actor->position + sf::Vector2f({ 150.0f, 0.0f }));
-		path.push_back(actor->position + sf::Vector2f({ 150.0f, -2 * (config.maxy - config.miny) / 3 }));
-		path.push_back(actor->position + sf::Vector2f({ -150.0f, -config.maxy }));
-		v.push_back(new Missile(actor->position, actor->acceleration, actor->velocity, this->texture, this->size, this->damage, path));
-
-        // left side
-        path.clear();
-        path.push_back(actor->position);
-        path.push_back(actor->position + sf::Vector2f({ -100.0f, 0.0f }));
-        path.push_back(actor->position + sf::Vector2f({ -100.0f, -(config.maxy - config.miny) / 3 }));
-        path.push_back(actor->position + sf::Vector2f({ 100.0f, -(config.maxy - config.miny) / 3 }));
-        path.push_back(actor->position + sf::Vector2f({ 100.0f, -2 * (config.maxy - config.miny) / 3 }));
-        path.push_back(actor->position + sf::Vector2f({ -100.0f, -config.maxy }));
-        v.push_back(new Missile(actor->position, actor->acceleration, actor->velocity, this->texture, this->size, this->damage, path));
-
-        path.clear();
-        path.push_back(actor->position);
-        path.push_back(actor->position + sf::Vector2f({ -150.0f, 0.0f }));
-        path.push_back(actor->position + sf::Vector2f({ -150.0f, -2 * (config.maxy - config.miny) / 3 }));
-        path.push_back(actor->position + sf::Vector2f({ 150.0f, -config.maxy }));
-        v.push_back(new Missile(actor->position, actor->acceleration, actor->velocity, this->texture, this->size, this->damage, path));
-
-		return v;
-	}
-
-    std::vector<Projectile*> fire(GameEntity* actor)
-    {
-        std::vector<Projectile*> v;
-        return v;
-    }
-};
-
-// mount points
-class Mountable
-{
-public:
-    IFiringPattern* fp;
-};
-
-// =================================
-// GAME ENTITIES
-// =================================
-
-// player entity
-
-class PlayerShip : public GameEntity
-{
-public:
-    enum FiringPatterns
-    {
-        LASER_SINGLE = 0,
-        LASER_BURST = 1,
-        MISSILES = 2
-    };
-    bool powerupShield{ false };
-    bool powerupFire{ false };
-    sf::Sprite leftEngine, rightEngine, shieldSprite;
-    bool leftEngineActive{ false }, rightEngineActive{ false };
-    float playerSpeed{ 400.0f };
-    int hp{ 100 };
-    int laserDamage{ 100 };
-    int missileDamage{ 200 };
-    float playerLaserSpeed{ 400.0f };
-    float playerMissileSpeed{ 200.0f };
-    sf::Vector2f playerLaserSize{ 7.5f, 20.0f };
-    sf::Vector2f playerMissileSize{ 10.0f, 25.0f };
-
-    IFiringPattern* firingPattern = nullptr;
-    std::map<FiringPatterns, IFiringPattern*> firingPatterns;
-
-    PlayerShip() = default;
-
-    PlayerShip(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace):
-        GameEntity(position, acceleration, velocity, texture, sizeInWorldSpace)
-    {
-        this->powerupShield = false;
-        this->powerupFire = false;
-        this->hp = 100;
-
-        this->shieldSprite.setTexture(*globalTextures.playerShieldTexture);
-        this->shieldSprite.setOrigin((*globalTextures.playerShieldTexture).getSize().x / 2, (*globalTextures.playerShieldTexture).getSize().y / 2);
-        this->shieldSprite.setScale(sizeInWorldSpace.x / (*globalTextures.playerShieldTexture).getSize().x, sizeInWorldSpace.y / (*globalTextures.playerShieldTexture).getSize().y);
-
-        this->leftEngine.setTexture(*globalTextures.leftEngineTexture);
-
-        this->rightEngine.setTexture(*globalTextures.rightEngineTexture);
-
-        this->firingPatterns.insert(std::pair<FiringPatterns, IFiringPattern*>(PlayerShip::FiringPatterns::LASER_SINGLE, new SingleLaser(globalTextures.playerLaserTexture, this->playerLaserSize, this->playerLaserSpeed, this->laserDamage)));
-        this->firingPatterns.insert(std::pair<FiringPatterns, IFiringPattern*>(PlayerShip::FiringPatterns::LASER_BURST, new BurstLaser(globalTextures.playerLaserTexture, this->playerLaserSize, this->playerLaserSpeed, this->laserDamage)));
-    }
-
-    ~PlayerShip()
-    {
-        delete this->firingPatterns[FiringPatterns::LASER_SINGLE];
-        delete this->firingPatterns[FiringPatterns::LASER_BURST];
-    }
-
-    PlayerShip& operator=(const PlayerShip& ship)
-    {
-        this->sprite = ship.sprite;
-        this->acceleration = ship.acceleration;
-        this->velocity = ship.velocity;
-        this->position = ship.position;
-
-        this->powerupShield = false;
-        this->powerupFire = false;
-        this->hp = 100;
-
-        this->shieldSprite.setTexture(*globalTextures.playerShieldTexture);
-        this->shieldSprite.setOrigin((*globalTextures.playerShieldTexture).getSize().x / 2, (*globalTextures.playerShieldTexture).getSize().y / 2);
-        this->shieldSprite.setScale(ship.sprite.getLocalBounds().width / (*globalTextures.playerShieldTexture).getSize().x, ship.sprite.getLocalBounds().height / (*globalTextures.playerShieldTexture).getSize().y);
-
-        this->leftEngine.setTexture(*globalTextures.leftEngineTexture);
-        this->rightEngine.setTexture(*globalTextures.rightEngineTexture);
-
-        this->firingPatterns.clear();
-        this->firingPatterns.insert(std::pair<FiringPatterns, IFiringPattern*>(PlayerShip::FiringPatterns::LASER_SINGLE, new SingleLaser(globalTextures.playerLaserTexture, this->playerLaserSize, this->playerLaserSpeed, this->laserDamage)));
-        this->firingPatterns.insert(std::pair<FiringPatterns, IFiringPattern*>(PlayerShip::FiringPatterns::LASER_BURST, new BurstLaser(globalTextures.playerLaserTexture, this->playerLaserSize, this->playerLaserSpeed, this->laserDamage)));
-
-        return *this;
-    }
-
-    void update(float dt)
-    {
-        this->changeVelocity({ 0 ,0 });
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
-        {
-            this->rightEngineActive = true;
-            this->changeVelocity({ -this->playerSpeed, 0 });
-        }
-        else
-        {
-            this->rightEngineActive = false;
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
-        {
-            this->leftEngineActive = true;
-            this->changeVelocity({ this->playerSpeed, 0 });
-        }
-        else
-        {
-            this->leftEngineActive = false;
-        }
-
-        this->GameEntity::update(dt);
-        this->leftEngine.setPosition(this->position + sf::Vector2f({ -60.0f, 00.0f }));
-        this->rightEngine.setPosition(this->position + sf::Vector2f({ 20.0f, 00.0f }));
-        this->shieldSprite.setPosition(this->position);
-    }
-
-    int hit(int damage)
-    {
-        if (this->powerupShield)
-        {
-            this->powerupShield = false;
-            this->powerupFire = false;
-        }
-        else
-        {
-            this->hp -= damage;
-        }
-        return this->hp;
-    }
-
-    std::vector<Projectile*> fire(std::vector<Projectile*>& vector)
-    {
-        if (!this->powerupFire)
-        {
-            this->firingPattern = this->firingPatterns[FiringPatterns::LASER_SINGLE];
-        }
-        else
-        {
-            this->firingPattern = this->firingPatterns[FiringPatterns::LASER_BURST];
-        }
-        std::vector<Projectile*> projectiles = this->firingPattern->fire(this);
-        for (int i = 0; i < projectiles.size(); i++)
-        {
-            vector.push_back(projectiles[i]);
-        }
-        return projectiles;
-    }
-
-    std::vector<Projectile*> fire2()
-    {
-        std::unique_ptr<MissileCluster> mc = std::make_unique<MissileCluster>(globalTextures.playerMissileTexture, this->playerMissileSize, this->playerMissileSpeed, this->missileDamage);
-        return mc->fire2(this);
-    }
-
-    void draw(sf::RenderTarget& target, sf::RenderStates states) const
-    {
-        this->GameEntity::draw(target, states);
-        if (this->leftEngineActive)
-        {
-            target.draw(this->leftEngine);
-        }
-        if (this->rightEngineActive)
-        {
-            target.draw(this->rightEngine);
-        }
-        if (this->powerupShield)
-        {
-            target.draw(this->shieldSprite);
-        }
-    }
-};
-
-class EnemyShip : public GameEntity
-{
-public:
-    enum class MovementType
-    {
-        DEFAULT = 0,
-        PATH = 1,
-        BEZIER = 2
-    };
-    int index;
-    int hp{ 100 };
-    int laserDamage{ 100 };
-    float laserSpeed{ -400.0f };
-    float speed{ 100.0f };
-    float minx, maxx;
-    sf::Vector2f laserSize{ 7.5f, 20.0f };
-    MovementType movement{ MovementType::DEFAULT };
-    std::vector<sf::Vector2f> path;
-    float currentTime;
-
-    IFiringPattern* firingPattern = nullptr;
-
-    EnemyShip() = default;
-
-    EnemyShip(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace):
-        GameEntity(position, acceleration, velocity, texture, sizeInWorldSpace)
-    {
-        this->minx = position.x - 200;
-        this->maxx = position.x + 200;
-        this->movement = EnemyShip::MovementType::DEFAULT;
-        this->hp = 100;
-
-        this->firingPattern = new SingleLaser(globalTextures.enemyLaserTexture, this->laserSize, this->laserSpeed, this->laserDamage);
-    }
-
-    EnemyShip operator=(EnemyShip ship)
-    {
-        this->position = ship.position;
-        this->acceleration = ship.acceleration;
-        this->velocity = ship.velocity;
-        this->sprite = ship.sprite;
-        this->hp = 100;
-
-        this->movement = EnemyShip::MovementType::DEFAULT;
-
-        this->minx = ship.position.x - 200;
-        this->maxx = ship.position.x + 200;
-
-        this->firingPattern = new SingleLaser(globalTextures.enemyLaserTexture, this->laserSize, this->laserSpeed, this->laserDamage);
-    }
-
-    ~EnemyShip()
-    {
-        delete this->firingPattern;
-    }
-
-    void virtual update(float dt) override
-    {
-        if (this->movement == MovementType::DEFAULT)
-        {
-			this->GameEntity::update(dt);
-			if (this->position.x < this->minx || this->position.x > this->maxx)
-			{
-				this->velocity = { -this->velocity.x, this->speed };
-				this->acceleration.y = -this->speed;
-			}
-			if (this->velocity.y < 0)
-			{
-				this->velocity.y = 0.0f;
-				this->acceleration.y = 0.0f;
-			}
-        }
-        else
-        {
-            float totalTime = std::fabs((this->maxx - this->minx) / this->speed);
-            this->currentTime += dt;
-            this->changePosition(computeBezierPointDeCasteljau(path, this->currentTime / totalTime));
-            if (currentTime > totalTime)
-            {
-                this->movement = MovementType::DEFAULT;
-                this->acceleration = { 0 ,0 };
-                this->velocity = { this->speed, 0 };
-            }
-        }
-    }
-
-    void changeMovement(MovementType newMovementType)
-    {
-        std::vector<sf::Vector2f> path;
-        if (this->position.x - this->minx > this->maxx - this->position.x)
-        {
-            path.push_back(this->position);
-            path.push_back({ this->position.x, config.maxy / 2 });
-            path.push_back({ this->minx, config.maxy / 2 });
-            path.push_back({ this->minx, this->position.y });
-        }
-        else
-        {
-            path.push_back(this->position);
-            path.push_back({ this->position.x, config.maxy / 2 });
-            path.push_back({ this->maxx, config.maxy / 2 });
-            path.push_back({ this->maxx, this->position.y });
-        }
-        this->movement = newMovementType;
-        this->path = path;
-        this->currentTime = 0.0f;
-    }
-
-    int hit(int damage) {
-        this->hp -= damage;
-        return this->hp;
-    }
-
-    std::vector<Projectile*> fire()
-    {
-        return this->firingPattern->fire(this);
-    }
-};
-
-class BossShip : public EnemyShip
-{
-public:
-    BossShip(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Texture* texture, sf::Vector2f sizeInWorldSpace):
-        EnemyShip(position, acceleration, velocity, texture, sizeInWorldSpace)
-    {
-        this->hp = 2000;
-    }
-
-    BossShip operator=(BossShip ship)
-    {
-        this->position = ship.position;
-        this->acceleration = ship.acceleration;
-        this->velocity = ship.velocity;
-        this->sprite = ship.sprite;
-        this->hp = 2000;
-    }
-
-    void virtual update(float dt) override
-    {
-        this->EnemyShip::update(dt);
-    }
-
-    void hit(int damage)
-    {
-        this->hp -= damage;
-    }
-};
-
-class Animation : public GameEntity
-{
-public:
-    enum class State
-    {
-        STOPPED = 0,
-        PLAYING = 1,
-        PAUSED = 2
-    };
-    float duration;
-    float elapsed;
-    float looping;
-    float currentLoop;
-    sf::Vector2u frameSize;
-    State state;
-
-    Animation(sf::Vector2f position, sf::Vector2f acceleration, sf::Vector2f velocity, sf::Vector2f sizeInWorldSpace, float duration, sf::Vector2u frameSize, sf::Texture* texture, Animation::State initialState = Animation::State::PLAYING, float looping = 0):
-        GameEntity(position, acceleration, velocity, texture, sizeInWorldSpace)
-    {
-        this->looping = looping;
-        this->currentLoop = 0.0f;
-        this->duration = duration;
-        this->elapsed = 0.0f;
-        this->frameSize = frameSize;
-        this->state = initialState;
-
-        this->sprite.setTexture(*texture);
-        this->sprite.setOrigin({ frameSize.x / 2.0f, frameSize.y / 2.0f });
-        this->sprite.setScale(sizeInWorldSpace.x / frameSize.x, sizeInWorldSpace.y / frameSize.y);
-        this->sprite.setTextureRect({ 0, 0, (int)this->frameSize.x, (int)this->frameSize.y });
-    }
-
-    void update(float dt)
-    {
-        this->GameEntity::update(dt);
-
-        if (this->state == Animation::State::PLAYING)
-        {
-            this->elapsed += dt;
-            const sf::Texture* t = this->sprite.getTexture();
-            sf::Vector2u tSize = (*t).getSize();
-            int totalFrames = tSize.x / this->frameSize.x;
-            sf::IntRect tRect;
-            int currentFrame = (int)(this->elapsed / this->duration * totalFrames);
-            tRect.top = 0;
-            tRect.left = currentFrame * this->frameSize.x;
-            tRect.width = this->frameSize.x;
-            tRect.height = this->frameSize.y;
-            this->sprite.setTextureRect(tRect);
-        }
-
-        if (this->elapsed >= this->duration)
-        {
-            if (this->looping == 1)
-            {
-                this->elapsed = 0.0f;
-            }
-            else if (this->looping == 0)
-            {
-                this->state = Animation::State::STOPPED;
-            }
-            else if (this->currentLoop < this->looping)
-            {
-                this->currentLoop++;
-                this->elapsed = 0.0f;
-            }
-            else
-            {
-                this->state = Animation::State::STOPPED;
-            }
-        }
-    }
-
-};
-
-class MenuEntity
-{
-public:
-    bool keyPressed;
-    int currentMenu, menuOptions;
-    float menuOptionSelected, menuOptionSelectCooldown;
-
-    sf::Texture* startButtonTexture;
-    sf::Texture* startButtonSelectedTexture;
-    sf::Texture* exitButtonTexture;
-    sf::Texture* exitButtonSelectedTexture;
-    sf::Texture* menuBackgroundTexture;
-
-    sf::Texture* defeatTexture;
-    sf::Texture* victoryTexture;
-
-    sf::Vector2u startButtonTextureSize;
-    float startButtonSpriteSize;
-
-    sf::Vector2u exitButtonTextureSize;
-    float exitButtonSpriteSize;
-
-    sf::Vector2u menuBackgroundTextureSize;
-    float menuBackgroundSpriteSize;
-
-    GameEntity startButton, startButtonSelected, exitButton, exitButtonSelected, menuBackground;
-    GameEntity victory, defeat;
-
-
-
-    void menu_init()
-    {
-        this->keyPressed = false;
-        this->menuOptions = 2;
-        this->currentMenu = 0; // start button
-        this->menuOptionSelected = 0.0f;
-        this->menuOptionSelectCooldown = 0.25f;
-
-        // menu background texture
-        this->menuBackgroundTexture = new sf::Texture();
-        (*this->menuBackgroundTexture).loadFromFile("./assets/graphics/menu_background.png");
-
-        this->menuBackgroundTextureSize = this->menuBackgroundTexture->getSize();
-        this->menuBackgroundSpriteSize = 200.0f;
-
-        // start button texture
-        this->startButtonTexture = new sf::Texture();
-        (*this->startButtonTexture).loadFromFile("./assets/graphics/start_button.png");
-
-        this->startButtonSelectedTexture = new sf::Texture();
-        (*this->startButtonSelectedTexture).loadFromFile("./assets/graphics/start_button_selected.png");
-
-        this->startButtonTextureSize = this->startButtonTexture->getSize();
-        this->startButtonSpriteSize = 190.0f;
-
-        //exit button texture
-        this->exitButtonTexture = new sf::Texture();
-        (*this->exitButtonTexture).loadFromFile("./assets/graphics/exit_button.png");
-
-        this->exitButtonSelectedTexture = new sf::Texture();
-        (*this->exitButtonSelectedTexture).loadFromFile("./assets/graphics/exit_button_selected.png");
-
-        this->exitButtonTextureSize = this->exitButtonTexture->getSize();
-        this->exitButtonSpriteSize = 190.0f;
-
-        float menux = config.minx + (config.maxx - config.minx) / 3;
-        float menuy = config.miny + (config.maxy - config.miny) / 2;
-
-        // menu background sprite
-        this->menuBackground.sprite.setTexture(*this->menuBackgroundTexture);
-        this->menuBackground.sprite.setScale(this->menuBackgroundSpriteSize / this->menuBackgroundTextureSize.x, this->menuBackgroundSpriteSize * this->menuBackgroundTextureSize.y / this->menuBackgroundTextureSize.x / this->menuBackgroundTextureSize.y);
-        this->menuBackground.changePosition({ menux, menuy });
-
-        // start button sprite
-        this->startButton.sprite.setTexture(*this->startButtonTexture);
-        this->startButton.sprite.setScale(this->startButtonSpriteSize / this->startButtonTextureSize.x, this->startButtonSpriteSize * this->startButtonTextureSize.y / this->startButtonTextureSize.x / this->startButtonTextureSize.y);
-        this->startButton.changePosition({ menux + 5, menuy + 125 });
-
-        this->startButtonSelected.sprite.setTexture(*this->startButtonSelectedTexture);
-        this->startButtonSelected.sprite.setScale(this->startButtonSpriteSize / this->startButtonTextureSize.x, this->startButtonSpriteSize * this->startButtonTextureSize.y / this->startButtonTextureSize.x / this->startButtonTextureSize.y);
-        this->startButtonSelected.changePosition({ menux + 5, menuy + 125 });
-
-        // exit button sprite
-        this->exitButton.sprite.setTexture(*this->exitButtonTexture);
-        this->exitButton.sprite.setScale(this->exitButtonSpriteSize / this->exitButtonTextureSize.x, this->exitButtonSpriteSize * this->exitButtonTextureSize.y / this->exitButtonTextureSize.x / this->exitButtonTextureSize.y);
-        this->exitButton.changePosition({ menux + 5, menuy + 175 });
-
-        this->exitButtonSelected.sprite.setTexture(*this->exitButtonSelectedTexture);
-        this->exitButtonSelected.sprite.setScale(this->exitButtonSpriteSize / this->exitButtonTextureSize.x, this->exitButtonSpriteSize * this->exitButtonTextureSize.y / this->exitButtonTextureSize.x / this->exitButtonTextureSize.y);
-        this->exitButtonSelected.changePosition({ menux + 5, menuy + 175 });
-
-        // victory texture and sprite
-        this->victoryTexture = new sf::Texture();
-        (*this->victoryTexture).loadFromFile("./assets/graphics/victory.png");
-
-        this->victory.sprite.setTexture(*this->victoryTexture);
-        this->victory.changePosition({ menux, menuy });
-
-        // defeat texture and sprite
-        this->defeatTexture = new sf::Texture();
-        (*this->defeatTexture).loadFromFile("./assets/graphics/defeat.png");
-
-        this->defeat.sprite.setTexture(*this->defeatTexture);
-        this->defeat.changePosition({ menux , menuy });
-
-    }
-
-    void menu_loop(float dt, sf::RenderWindow& window)
-    {
-        if (this->menuOptionSelected != 0.0f)
-        {
-            this->menuOptionSelected -= dt;
-            if (this->menuOptionSelected < 0.0f)
-            {
-                this->menuOptionSelected = 0.0f;
-            }
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up) || sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
-        {
-            if (this->menuOptionSelected == 0.0f)
-            {
-                this->currentMenu = (this->currentMenu + 1) % this->menuOptions;
-                this->menuOptionSelected = this->menuOptionSelectCooldown;
-            }
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Enter))
-        {
-            if (this->currentMenu == 0 && navigation.currentState == Navigation::NavigationStates::MENU)
-            {
-                navigation.currentState = Navigation::NavigationStates::GAME;
-            }
-            else
-            {
-                window.close();
-            }
-        }
-
-        // draw
-        window.clear();
-        window.draw(this->menuBackground.sprite);
-        if (this->currentMenu == 0)
-        {
-            window.draw(this->startButtonSelected.sprite);
-        }
-        else
-        {
-            window.draw(this->startButton.sprite);
-        }
-
-        if (this->currentMenu == 1)
-        {
-            window.draw(this->exitButtonSelected.sprite);
-        }
-        else
-        {
-            window.draw(this->exitButton.sprite);
-        }
-    }
-
-    void game_over_loop(float dt, sf::RenderWindow& window)
-    {
-        if (navigation.cooldownTimer > 0.0f)
-        {
-            navigation.cooldownTimer -= dt;
-        }
-        else if (this->keyPressed == true)
-        {
-            window.clear();
-            this->menu_init();
-            navigation.currentState = Navigation::NavigationStates::MENU;
-            return;
-        }
-        window.draw(this->defeat.sprite);
-    }
-
-    void victory_loop(float dt, sf::RenderWindow& window)
-    {
-        if (navigation.cooldownTimer > 0.0f)
-        {
-            navigation.cooldownTimer -= dt;
-        }
-        else if (this->keyPressed == true)
-        {
-			window.clear();
-            navigation.currentState = Navigation::NavigationStates::MENU;
-            this->menu_init();
-            return;
-        }
-        window.draw(this->victory.sprite);
-    }
-
-};
-
-
-
-EnemyShip* randomEnemyFireImproved(std::vector<EnemyShip*> ships, int rows, int columns)
-{
-    std::vector<EnemyShip*> viable;
-
-    for (int i = 0; i < ships.size(); i++)
-    {
-        bool friendlyFire = false;
-        for (int j = 0; j < ships.size(); j++)
-        {
-            if (i != j)
-            {
-                if (
-                    ships[i]->position.x > ships[j]->sprite.getGlobalBounds().left
-                    && ships[i]->position.x < ships[j]->sprite.getGlobalBounds().left + ships[j]->sprite.getGlobalBounds().width
-                    && ships[i]->position.y < ships[j]->sprite.getGlobalBounds().top
-                    )
-                {
-                    friendlyFire = true;
-                    break;
-                }
-            }
-        }
-        if (!friendlyFire) viable.push_back(ships[i]);
-    }
-
-    int select = std::rand() % viable.size();
-    return viable[select];
-
-}
-
-class Game
-{
-public:
-
-    // text
-    sf::Font font;
-    sf::Text textEnemies;
-    sf::Text textScore;
-    int score, scorePerKill;
-    sf::Texture* scoreAnimationTexture;
-
-    // game area boundaries
-    float minx, maxx, miny, maxy;
-    std::vector<sf::Vector2f> boundaries;
-    sf::VertexArray box;
-
-    sf::Vector2i mousePos;
-    sf::Vector2f mousePosWorld;
-
-    bool lPressed, rPressed, uPressed;
-    float rateOfFire, laserCooldown;
-    float enemyRateOfFire, enemyLaserCooldown;
-    bool changeDirection;
-    bool debugEnabled;
-
-    // background
-    sf::Texture* backgroundTexture;
-    sf::Texture* backgroundTexture2;
-    sf::Vector2u backgroundSize;
-    float backgroundSpriteSize;
-    sf::Sprite backgroundSprite;
-    sf::Sprite backgroundSprite2;
-    sf::Vector2i backgroundVelocity;
-    sf::Vector2f backgroundDefaultPosition;
-    sf::Vector2i backgroundTextureSize;
-    sf::Vector2i backgroundTexturePosition;
-    sf::Vector2f backgroundTexturePositionFloat;
-    sf::Vector2i backgroundTexturePosition2;
-    sf::Vector2f backgroundTexturePositionFloat2;
-
-    std::vector<sf::Vector2f> backgroundStars;
-    float backgroundStarsSpeed;
-    float backgroundStarsAmount;
-
-    // player
-    sf::Texture* playerTexture;
-    PlayerShip playerShip;
-    sf::Vector2u playerSize;
-    float playerSpriteSize;
-    float playerSpeed;
-
-    // power ups
-    std::vector<int> powerupIndexes;
-    std::vector<Powerup> powerups;
-    sf::Texture* powerupShieldTexture;
-    sf::Texture* powerupFireTexture;
-
-    // enemy
-    sf::Texture* enemyTexture;
-    std::vector<EnemyShip*> enemyShips;
-    sf::Vector2f enemySize;
-    float enemySpriteSize;
-    float enemySpeed;
-    std::vector<int> enemyBonusIndexes;
-    int enemyBonusIndex;
-    sf::Texture* bossTexture;
-    bool bossActive;
-
-    // player laser
-    sf::Texture* playerLaserTexture;
-    std::vector<Projectile*> playerLasers;
-    std::vector<Missile> playerMissiles;
-    sf::Vector2f playerLaserSize;
-    float playerLaserSpriteSize;
-    float playerLaserSpeed;
-
-    // enemy laser
-    std::vector<int> enemyLaserIndexes;
-    sf::Texture* enemyLaserTexture;
-    std::vector<Projectile*> enemyLasers;
-    sf::Vector2f enemyLaserSize;
-    float enemyLaserSpriteSize;
-    float enemyLaserSpeed;
-
-    // explosion
-    sf::Texture* explosionTexture;
-
-    std::vector<sf::Texture*> explosionTextures;
-    std::vector<sf::Sprite> explosionSprites;
-    sf::Vector2u explosionTextureSize;
-    float explosionSpriteSize;
-
-    //std::vector<AnimationEntity> animations;
-    std::vector<Animation> animations;
-
-    // sounds
-    float masterVolume = 10.0f;
-    sf::SoundBuffer* playerLaserBuffer;
-    sf::Sound playerLaserSound;
-    sf::SoundBuffer* playerMissileBuffer;
-    sf::Sound playerMissileSound;
-    sf::SoundBuffer* enemyLaserBuffer;
-    sf::Sound enemyLaserSound;
-    sf::SoundBuffer* enemyExplosionBuffer;
-    sf::Sound enemyExplosionSound;
-
-    ~Game()
+    ~Game()
     {
         delete this->playerTexture;
         delete this->enemyTexture;
@@ -1236,35 +603,19 @@ public:
         delete this->backgroundTexture2;
         delete this->explosionTexture;
     }
+    // everything loaded once: font, sounds, level, effect settings, the star field.
+    // round_init starts the matches on top of it
     void game_init()
     {
         // text
 		this->font.loadFromFile("./Roboto-Bold.ttf");
-        this->textEnemies.setFont(this->font);
-        this->textEnemies.setCharacterSize(36);
-        this->textEnemies.setFillColor(sf::Color::Cyan);
-        this->textEnemies.setStyle(sf::Text::Bold);
-        this->textEnemies.setPosition({ 50, 100 });
-
-        this->textScore.setFont(this->font);
-        this->textScore.setCharacterSize(36);
-        this->textScore.setFillColor(sf::Color::Cyan);
-        this->textScore.setStyle(sf::Text::Bold);
-        this->textScore.setPosition({ 50, 50 });
-
-        this->score = 0;
-        this->scorePerKill = 100;
-
-        this->scoreAnimationTexture = new sf::Texture();
-        (*this->scoreAnimationTexture).loadFromFile("./assets/graphics/score_animation.png");
-
-        // clear vectors
-        this->enemyShips.clear();
-        this->playerLasers.clear();
-        this->playerMissiles.clear();
-        this->enemyLasers.clear();
-        this->animations.clear();
-        this->powerups.clear();
+
+        if (!this->sim.level)
+        {
+            this->sim.loadDefaultLevel();
+        }
+        this->sim.masks = globalTextures.collisionMasks;
+        this->particles.init(262144);
 
         // boundaries
         this->minx = config.minx;
@@ -1277,50 +628,26 @@ public:
         this->boundaries.push_back(sf::Vector2f(this->maxx, this->maxy));
         this->boundaries.push_back(sf::Vector2f(this->minx, this->maxy));
         this->boundaries.push_back(sf::Vector2f(this->minx, this->miny));
-        this->box = createVertexArray(this->boundaries, sf::Color::Cyan);
 
-        // utility vars and flags
         this->debugEnabled = false;
-        this->lPressed = false;
-        this->rPressed = false;
-        this->uPressed = false;
-        this->changeDirection = false;
-        this->rateOfFire = 0.25f;
-        this->laserCooldown = 0.0f;
-        this->enemyRateOfFire = 0.5f;
-        this->enemyLaserCooldown = 0.0f;
 
         // background
         this->backgroundDefaultPosition = { this->minx, this->miny };
         this->backgroundTextureSize = { (int)(this->maxx - this->minx), (int)(this->maxy - this->miny) };
-        this->backgroundTexturePosition = { 0 ,0 };
-        this->backgroundTexturePositionFloat = { 0.0f, 0.0f };
-        this->backgroundTexturePosition2 = { 64 ,0 };
-        this->backgroundTexturePositionFloat2 = { 64.0f, 0.0f };
         this->backgroundVelocity = { 0, 10 };
 
-        this->backgroundTexture = new sf::Texture();
-        (*this->backgroundTexture).loadFromFile("./assets/graphics/black2.png");
+        this->backgroundTexture = globalTextures.get(TextureId::BACKGROUND);
         this->backgroundSize = this->backgroundTexture->getSize();
-        this->backgroundTexture->setRepeated(true);
         this->backgroundSpriteSize = this->backgroundSize.y;
-        this->backgroundSprite.setTexture(*this->backgroundTexture);
-        this->backgroundSprite.setTextureRect(sf::IntRect(0, 0, this->maxx - this->minx, this->maxy - this->miny));
-        this->backgroundSprite.setPosition(this->backgroundDefaultPosition);
-
-        this->backgroundTexture2 = new sf::Texture();
-        (*this->backgroundTexture2).loadFromFile("./assets/graphics/background.png");
-        this->backgroundTexture2->setRepeated(true);
-        this->backgroundSprite2.setTexture(*this->backgroundTexture2);
-        this->backgroundSprite2.setTextureRect(sf::IntRect(0, 0, this->maxx - this->minx, this->maxy - this->miny));
-        this->backgroundSprite2.setPosition(this->backgroundDefaultPosition);
+        this->backgroundTexture2 = globalTextures.get(TextureId::BACKGROUND_STARS);
 
         this->backgroundStarsAmount = 50;
+        this->backgroundStars.clear();
         for (int i = 0; i < this->backgroundStarsAmount; i++)
         {
             sf::Vector2f v;
             v.x = this->minx + std::rand() % (int)(this->maxx - this->minx);
-            v.y = this->miny + std::rand() % (int)(this->maxx - this->miny);
+            v.y = this->miny + std::rand() % (int)(this->maxy - this->miny);
             this->backgroundStars.push_back(v);
         }
         backgroundStarsSpeed = 100;
@@ -1328,11 +655,9 @@ public:
         // player entity
         this->playerSpeed = 400.0f;
         this->playerTexture = globalTextures.playerTexture;
-        this->playerShip = PlayerShip(sf::Vector2f(this->minx + (this->maxx - this->minx) / 2.0f, this->maxy - 50.0f), { 0,0 }, { 0,0 }, this->playerTexture, { 50, 50 });
-        this->playerShip.changePosition(sf::Vector2f(this->minx + (this->maxx - this->minx) / 2.0f, this->maxy - 50.0f));
+
 
         // powerup
-        this->powerupIndexes = std::vector<int>({ 17, 9, 1 });
         this->powerupShieldTexture = globalTextures.powerupShieldTexture;
 
         this->powerupFireTexture = globalTextures.powerupFireTexture;
@@ -1341,21 +666,6 @@ public:
 
         this->enemyTexture = globalTextures.enemyTexture;
         this->bossTexture = globalTextures.bossTexture;
-        this->enemySize = { 50, 40 };
-        this->enemySpriteSize = 50.0f;
-        this->enemySpeed = 100.0f;
-        int totalEnemyShips{ 24 };
-        for (int i = 0; i < totalEnemyShips; i++)
-        {
-
-            EnemyShip* ship = new EnemyShip({ this->minx + 200 + (float)(i % 6) * this->enemySpriteSize * 2.0f + this->enemySpriteSize / 2, this->miny + (float)(i / 6) * 50 + 20 }, { 0,0 }, { this->enemySpeed, 0 }, this->enemyTexture, this->enemySize);
-
-            ship->index = i;
-            this->enemyShips.push_back(ship);
-        }
-        this->enemyBonusIndexes = std::vector<int>({ 19, 13, 7 });
-        this->enemyBonusIndex = -1;
-        this->bossActive = false;
 
         // player lasers
         this->playerLaserTexture = globalTextures.playerLaserTexture;
@@ -1371,376 +681,191 @@ public:
         // explosion animation
         this->explosionTexture = globalTextures.explosionTexture;
 
-        // sounds
-        this->playerLaserBuffer = new sf::SoundBuffer();
-        (*this->playerLaserBuffer).loadFromFile("./assets/sound/laserSmall_000.ogg");
-        this->playerLaserSound.setBuffer(*this->playerLaserBuffer);
-        this->playerLaserSound.setVolume(this->masterVolume);
-
-        this->playerMissileBuffer = new sf::SoundBuffer();
-        (*this->playerMissileBuffer).loadFromFile("./assets/sound/missiles.ogg");
-        this->playerMissileSound.setBuffer(*this->playerMissileBuffer);
-        this->playerMissileSound.setVolume(this->masterVolume);
-
-        this->enemyLaserBuffer = new sf::SoundBuffer();
-        (*this->enemyLaserBuffer).loadFromFile("./assets/sound/laserSmall_001.ogg");
-        this->enemyLaserSound.setBuffer(*this->enemyLaserBuffer);
-        this->enemyLaserSound.setVolume(this->masterVolume);
-
-        this->enemyExplosionBuffer = new sf::SoundBuffer();
-        (*this->enemyExplosionBuffer).loadFromFile("./assets/sound/explosionCrunch_000.ogg");
-        this->enemyExplosionSound.setBuffer(*this->enemyExplosionBuffer);
-        this->enemyExplosionSound.setVolume(this->masterVolume);
-    }
-
-    void game_loop(float dt, sf::RenderWindow& window)
-    {
-        // check inputs
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
-        {
-            this->lPressed = true;
-        }
-        else
-        {
-            this->lPressed = false;
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
-        {
-            this->rPressed = true;
-        }
-        else
-        {
-            this->rPressed = false;
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::F1))
-        {
-            this->debugEnabled = !this->debugEnabled;
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::F2))
-        {
-            this->playerShip.powerupShield = true;
-            this->playerShip.powerupFire = true;
-        }
-
-        // state change for ship is done in playerShipUpdate()
-
-        // collision with world boundary
-        if (this->playerShip.sprite.getGlobalBounds().left < this->minx)
-        {
-            this->playerShip.changePosition({ this->minx + this->playerShip.sprite.getGlobalBounds().width / 2, this->playerShip.position.y });
-        }
-        if (this->playerShip.sprite.getGlobalBounds().left + this->playerShip.sprite.getGlobalBounds().width > this->maxx)
-        {
-            this->playerShip.changePosition({ this->maxx - this->playerShip.sprite.getGlobalBounds().width / 2, this->playerShip.position.y });
-        }
-
-        // IMMA FIRING MAH LAZOR
-        if (this->laserCooldown != 0.0f)
-        {
-            this->laserCooldown -= dt;
-            if (this->laserCooldown < 0.0f)
-            {
-                this->laserCooldown = 0.0f;
-            }
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
-        {
-            if (this->laserCooldown == 0.0f)
-            {
-                this->laserCooldown = this->rateOfFire;
-
-                //std::vector<Projectile*> lasers = this->playerShip.fire();
-                //for (int i = 0; i < lasers.size(); i++)
-                //{
-                //    this->playerLasers.push_back(lasers[i]);
-                //}
-                this->playerShip.fire(this->playerLasers);
-
-                this->playerLaserSound.play();
-            }
-        }
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space))
-		{
-			if (this->laserCooldown == 0.0f)
-			{
-				this->laserCooldown = this->rateOfFire;
-				std::vector<Projectile*> missiles = this->playerShip.fire2();
-				for (int i = 0; i < missiles.size(); i++)
-				{
-					this->playerLasers.push_back(missiles[i]);
-				}
-				this->playerMissileSound.play();
-			}
-		}
-        
-        // checking player laser collision
-        std::vector<int> lasers;
-        for (int i = 0; i < this->playerLasers.size(); i++)
-        {
-            for (int j = 0; j < this->enemyShips.size(); j++)
-            {
-                if (this->enemyShips[j]->sprite.getGlobalBounds().contains(this->playerLasers[i]->position))
-                {
-                    this->enemyShips[j]->hit(this->playerLasers[i]->damage);
-                    this->playerLasers.erase(this->playerLasers.begin() + i);
-                    i--;
-                    break;
-                }
-            }
-        }
-        for (int i = 0; i < this->playerMissiles.size(); i++)
-        {
-            for (int j = 0; j < this->enemyShips.size(); j++)
-            {
-                if (this->enemyShips[j]->sprite.getGlobalBounds().contains(this->playerMissiles[i].position))
-                {
-                    this->enemyShips[j]->hit(this->playerMissiles[i].damage);
-                    this->playerMissiles.erase(this->playerMissiles.begin() + i);
-                    i--;
-                    break;
-                }
-            }
-        }
-        // checking dead enemy ships
-        for (int i = 0; i < this->enemyShips.size(); i++)
-        {
-            if (this->enemyShips[i]->hp <= 0)
-            {
-                Animation animExplosion(this->enemyShips[i]->position, { 0, 0 }, { 0, 0 }, { 50, 50 }, 0.2f, { 50, 50 }, this->explosionTexture);
-
-                Animation animScore((this->enemyShips[i]->position + sf::Vector2f({20, -20})), { 0,100 }, { 30,-100 }, { 40, 20 }, 0.5f, { 40, 20 }, this->scoreAnimationTexture, Animation::State::PLAYING, 5);
-
-                this->score += this->scorePerKill;
-
-                this->animations.push_back(animExplosion);
-                this->animations.push_back(animScore);
-
-                this->enemyExplosionSound.play();
-
-                this->enemyShips.erase(this->enemyShips.begin() + i);
-                i--;
-
-                // adding boss enemy
-                if (this->enemyShips.size() == 0 && !this->bossActive)
-                {
-                    BossShip* boss = new BossShip(sf::Vector2f({config.minx + (config.maxx - config.minx) / 2, config.miny + 100 }), { 0, 0 }, { 400, 0 }, this->bossTexture, { 150, 100 });
-                    this->enemyShips.push_back(boss);
-                    this->bossActive = true;
-                }
-            }
-        }
-        // out of bounds;
-        for (int i = 0; i < this->playerLasers.size(); i++)
-        {
-            if (this->playerLasers[i]->position.y + this->playerLasers[i]->velocity.y * dt - this->playerLaserSpriteSize * this->playerLaserSize.y / this->playerLaserSize.x / this->playerLaserSize.y < this->miny
-                || this->playerLasers[i]->position.x < config.minx
-                || this->playerLasers[i]->position.x > config.maxx)
-            {
-                this->playerLasers.erase(this->playerLasers.begin() + i);
-                i--;
-            }
-        }
-        for (int i = 0; i < this->playerMissiles.size(); i++)
-        {
-            if (this->playerMissiles[i].position.y + this->playerMissiles[i].velocity.y < this->miny
-                || this->playerMissiles[i].position.x < config.minx
-                || this->playerMissiles[i].position.x > config.maxx)
-            {
-                this->playerMissiles.erase(this->playerMissiles.begin() + i);
-                i--;
-            }
-        }
-
-        // powerups
-        for (int i = 0; i < this->powerups.size(); i++)
-        {
-            // out of bounds
-            if (this->powerups[i].position.y > this->maxy)
-            {
-                this->powerups.erase(this->powerups.begin() + i);
-                i--;
-            }
-        }
-        for (int i = 0; i < this->powerups.size(); i++)
-        {
-            if (this->playerShip.sprite.getGlobalBounds().contains(powerups[i].position))
-            {
-                if (this->playerShip.powerupShield)
-                {
-                    this->playerShip.powerupFire = true;
-                }
-                this->playerShip.powerupShield = true;
-                this->powerups.erase(this->powerups.begin() + i);
-                i--;
-            }
-        }
-
-        // enemy lasers
-        if (this->enemyLaserCooldown != 0.0f)
-        {
-            this->enemyLaserCooldown -= dt;
-            if (this->enemyLaserCooldown < 0.0f)
-            {
-                this->enemyLaserCooldown = 0.0f;
-            }
-        }
-        if (this->enemyLaserCooldown == 0.0f && this->enemyShips.size() > 0)
-        {
-            this->enemyLaserCooldown = this->enemyRateOfFire;
-            this->enemyLasers.push_back(randomEnemyFireImproved(this->enemyShips, 4, 6)->fire()[0]);
-
-            if (this->enemyBonusIndex != -1)
-            {
-				for (int i = 0; i < this->enemyShips.size(); i++)
-				{
-                    if (this->enemyShips[i]->index == this->enemyBonusIndex)
-                    {
-                        this->enemyLasers.push_back(this->enemyShips[i]->fire()[0]);
-                    }
-				}
-            }
+        // particles, the four blue explosion frames are particle textures 0-3
+        std::vector<sf::Vector2f> particleTextureSizes;
+        for (int i = 0; i < 4; i++)
+        {
+            particleTextureSizes.push_back(sf::Vector2f(globalTextures.explosionBlueTextures[i]->getSize()));
+        }
+        this->particles.setTextureSizes(particleTextureSizes);
+        this->particles.drag = 0.1f;
+        this->applyQuality();
+
+        this->deathEmitter.count = 80;
+        this->deathEmitter.minSpeed = 40.0f;
+        this->deathEmitter.maxSpeed = 260.0f;
+        this->deathEmitter.minLife = 0.3f;
+        this->deathEmitter.maxLife = 0.9f;
+        this->deathEmitter.minSize = 6.0f;
+        this->deathEmitter.maxSize = 16.0f;
+        this->deathEmitter.textureCount = 4;
+
+        this->hitEmitter.count = 12;
+        this->hitEmitter.minSpeed = 60.0f;
+        this->hitEmitter.maxSpeed = 180.0f;
+        this->hitEmitter.minLife = 0.1f;
+        this->hitEmitter.maxLife = 0.3f;
+        this->hitEmitter.minSize = 3.0f;
+        this->hitEmitter.maxSize = 6.0f;
+        this->hitEmitter.spread = pi / 2;
+        this->hitEmitter.color = sf::Color(255, 220, 160);
+        this->hitEmitter.firstTexture = 3;
+
+        this->thrustEmitter.count = 1;
+        this->thrustEmitter.minSpeed = 20.0f;
+        this->thrustEmitter.maxSpeed = 60.0f;
+        this->thrustEmitter.minLife = 0.2f;
+        this->thrustEmitter.maxLife = 0.4f;
+        this->thrustEmitter.minSize = 3.0f;
+        this->thrustEmitter.maxSize = 6.0f;
+        this->thrustEmitter.spread = pi / 3;
+        this->thrustEmitter.color = sf::Color(255, 180, 80);
+        this->thrustEmitter.firstTexture = 2;
+        this->thrustEmitter.textureCount = 2;
+
+        this->shieldEmitter.count = 60;
+        this->shieldEmitter.minSpeed = 150.0f;
+        this->shieldEmitter.maxSpeed = 200.0f;
+        this->shieldEmitter.minLife = 0.3f;
+        this->shieldEmitter.maxLife = 0.5f;
+        this->shieldEmitter.minSize = 4.0f;
+        this->shieldEmitter.maxSize = 8.0f;
+        this->shieldEmitter.color = sf::Color(120, 200, 255);
+        this->shieldEmitter.textureCount = 4;
 
-            this->enemyLaserSound.play();
-        }
-        // checking enemy laser collision
-        for (int i = 0; i < this->enemyLasers.size(); i++)
-        {
-            // out of bounds;
-            if ((*this->enemyLasers[i]).position.y + (*this->enemyLasers[i]).velocity.y * dt - this->enemyLaserSpriteSize * this->enemyLaserSize.y / this->enemyLaserSize.x / this->enemyLaserSize.y > this->maxy)
-            {
-                this->enemyLasers.erase(this->enemyLasers.begin() + i);
-                i--;
-            }
-        }
-        for (int i = 0; i < this->enemyLasers.size(); i++)
-        {
-            //if (this->playerShip.sprite.getGlobalBounds().intersects(this->enemyLasers[i].sprite.getGlobalBounds()))
-            if (this->playerShip.sprite.getGlobalBounds().contains(this->enemyLasers[i]->position))
-            {
-                this->playerShip.hit(this->enemyLasers[i]->damage);
-                this->enemyLasers.erase(this->enemyLasers.begin() + i);
-                i--;
-            }
-        }
+        // sounds
+        this->playerLaserBuffer.loadFromFile("./assets/sound/laserSmall_000.ogg");
+        this->playerLaserSound.setBuffer(this->playerLaserBuffer);
+        this->playerLaserSound.setVolume(this->masterVolume);
 
-        // movement
+        this->playerMissileBuffer.loadFromFile("./assets/sound/missiles.ogg");
+        this->playerMissileSound.setBuffer(this->playerMissileBuffer);
+        this->playerMissileSound.setVolume(this->masterVolume);
 
-        //GameEntity* pge = nullptr;
-        //if (rand() < 7)
-        //    pge = new PlayerShip;
-        //else
-        //    pge = new EnemyShip;
-        //pge->update(dt); //with virtual the correct method is called. not the pointer type
-        this->playerShip.update(dt);
+        this->enemyLaserBuffer.loadFromFile("./assets/sound/laserSmall_001.ogg");
+        this->enemyLaserSound.setBuffer(this->enemyLaserBuffer);
+        this->enemyLaserSound.setVolume(this->masterVolume);
 
-        for (int i = 0; i < this->enemyShips.size(); i++)
-        {
-            this->enemyShips[i]->update(dt);
-        }
+        this->enemyExplosionBuffer.loadFromFile("./assets/sound/explosionCrunch_000.ogg");
+        this->enemyExplosionSound.setBuffer(this->enemyExplosionBuffer);
+        this->enemyExplosionSound.setVolume(this->masterVolume);
 
-        for (int i = 0; i < this->playerLasers.size(); i++)
-        {
-            this->playerLasers[i]->update(dt);
-        }
+        this->round_init();
+    }
 
-        for (int i = 0; i < this->playerMissiles.size(); i++)
-        {
-            this->playerMissiles[i].update(dt);
-        }
+    // a new match on the storage of the last one: the world keeps its pools, the particle
+    // ring and the animation list are emptied, not freed
+    void round_init()
+    {
+        this->sim.arena = config;
+        this->sim.playerCount = this->host ? 2 : this->playerCount;
+        std::uint64_t seed = (std::uint64_t)std::rand();
+        this->sim.reset(seed);
+        flightRecorder.beginMatch(seed, this->sim);
+        this->animations.clear();
+        this->particles.clear();
 
-        for (int i = 0; i < this->enemyLasers.size(); i++)
-        {
-            this->enemyLasers[i]->update(dt);
-        }
-        for (int i = 0; i < this->powerups.size(); i++)
-        {
-            this->powerups[i].update(dt);
-        }
+        // utility vars and flags
+        this->lPressed = false;
+        this->rPressed = false;
+        this->uPressed = false;
+        this->changeDirection = false;
 
-        // animation
-        for (int i = 0; i < this->animations.size(); i++)
-        {
-            this->animations[i].update(dt);
-        }
-        for (int i = 0; i < this->animations.size(); i++)
-        {
-            if (this->animations[i].state == Animation::State::STOPPED)
-            {
-                this->animations.erase(this->animations.begin() + i);
-                i--;
-            }
-        }
+        this->backgroundTexturePosition = { 0 ,0 };
+        this->backgroundTexturePositionFloat = { 0.0f, 0.0f };
+        this->backgroundTexturePosition2 = { 64 ,0 };
+        this->backgroundTexturePositionFloat2 = { 64.0f, 0.0f };
+    }
 
-        // debug victory trigger
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::BackSpace))
-        {
-            this->enemyShips.clear();
-        }
+    // -------------------------------
+    // presentation
+    // -------------------------------
 
-        // check victory condition
-        if (this->enemyShips.size() == 0)
-        {
-            navigation.currentState = Navigation::NavigationStates::VICTORY;
-            navigation.cooldownTimer = navigation.cooldownTimerDuration;
-            navigation.gameOver = true;
-            this->bossActive = false;
-            return;
-        }
-        // check defeat condition
-        if (this->playerShip.hp <= 0)
-        {
-            navigation.currentState = Navigation::NavigationStates::GAME_OVER;
-            navigation.cooldownTimer = navigation.cooldownTimerDuration;
-            navigation.gameOver = true;
-            return;
-        }
-        for (int i = 0; i < this->enemyShips.size(); i++)
+    // sounds, particles and animations for what happened during the last step
+    void eventSystem()
+    {
+        for (int i = 0; i < this->sim.events.size(); i++)
         {
-            if (this->enemyShips[i]->position.y > config.maxy)
+            const SimEvent& event = this->sim.events[i];
+            switch (event.type)
             {
-                navigation.currentState = Navigation::NavigationStates::GAME_OVER;
-                navigation.cooldownTimer = navigation.cooldownTimerDuration;
-                navigation.gameOver = true;
-                return;
+            case SimEvent::PLAYER_LASER:
+                this->playerLaserSound.play();
+                telemetry.record(TelemetryEvent::SHOT);
+                break;
+            case SimEvent::PLAYER_MISSILES:
+                this->playerMissileSound.play();
+                telemetry.record(TelemetryEvent::SHOT);
+                break;
+            case SimEvent::ENEMY_LASER:
+                this->enemyLaserSound.play();
+                break;
+            case SimEvent::ENEMY_HIT:
+                this->particles.emit(this->hitEmitter, event.position, pi / 2, this->governor.quality().effects);
+                telemetry.record(TelemetryEvent::HIT);
+                break;
+            case SimEvent::ENEMY_KILLED:
+                telemetry.record(TelemetryEvent::KILL);
+                this->animations.spawn(AnimationClipId::EXPLOSION, event.position);
+                this->particles.emit(this->deathEmitter, event.position, 0.0f, this->governor.quality().effects);
+                this->animations.spawn(AnimationClipId::SCORE, event.position + sf::Vector2f({ 20, -20 }));
+                this->enemyExplosionSound.play();
+                break;
+            case SimEvent::SHIELD_BROKEN:
+                this->particles.emit(this->shieldEmitter, event.position, 0.0f, this->governor.quality().effects);
+                break;
+            case SimEvent::POWERUP_PICKUP:
+                telemetry.record(TelemetryEvent::POWERUP);
+                break;
             }
         }
-        // check powerup condition
-        if (this->powerupIndexes.size() != 0)
-        {
-            if (this->enemyShips.size() == this->powerupIndexes[0])
+    }
+
+    void animationSystem(float dt)
+    {
+        this->animations.update(dt);
+    }
+
+    void particleSystem(float dt)
+    {
+        float effects = this->governor.quality().effects;
+        this->sim.world.each<ParticleTrail, Transform>([this, dt, effects](Entity e, ParticleTrail& trail, Transform& transform)
             {
-                Powerup::PowerupTypes type{ Powerup::PowerupTypes::SHIELD };
-                sf::Texture* t = this->powerupShieldTexture;
-                if (this->playerShip.powerupShield)
+                trail.accumulator += trail.rate * effects * dt;
+                while (trail.accumulator >= 1.0f)
                 {
-                    type = Powerup::PowerupTypes::FIRE;
-                    t = this->powerupFireTexture;
+                    this->particles.emit(this->thrustEmitter, transform.position + sf::Vector2f(0.0f, transform.size.y / 2), pi / 2);
+                    trail.accumulator -= 1.0f;
                 }
-                EnemyShip* e = randomEnemyFireImproved(this->enemyShips, 6, 4);
-                Powerup p(e->position, sf::Vector2f({ 0, 100 }), sf::Vector2f({ 0, 100 }), t, sf::Vector2f({ 30, 30 }), type);
-                this->powerups.push_back(p);
-                this->powerupIndexes.erase(this->powerupIndexes.begin());
-            }
-        }
-        if (this->enemyBonusIndexes.size() != 0)
+            });
+        this->particles.update(dt);
+    }
+
+    // caps the particle ring and the animations at what the governor's level allows
+    void applyQuality()
+    {
+        const QualityLevel& quality = this->governor.quality();
+        this->particles.setLimit((std::size_t)(this->particles.capacity * quality.effects));
+        this->animations.limit = quality.animationLimit;
+    }
+
+    // game side effects drawn on top of the simulation's animation layer
+    void drawEffects(RenderBackend& backend, int layer)
+    {
+        if (layer == (int)RenderLayer::ANIMATIONS)
         {
-            if (this->enemyShips.size() == this->enemyBonusIndexes[0])
-            {
-                EnemyShip* e = randomEnemyFireImproved(this->enemyShips, 6, 4);
-                this->enemyBonusIndex = e->index;
-                for (int i = 0; i < this->enemyShips.size(); i++)
+            this->animations.draw(backend);
+            this->particles.draw([&](std::size_t texture, const sf::Vertex* vertices, std::size_t count)
                 {
-                    if (this->enemyShips[i]->index == e->index)
-                    {
-                        this->enemyShips[i]->changeMovement(EnemyShip::MovementType::BEZIER);
-                    }
-                }
-                this->enemyBonusIndexes.erase(this->enemyBonusIndexes.begin());
-            }
+                    backend.drawQuads((TextureId)((int)TextureId::EXPLOSION_BLUE_1 + texture), vertices, count);
+                });
         }
+    }
 
-        // display sprites
-        window.clear();
+    void renderBackground(RenderBackend& backend, float dt)
+    {
+        backend.clear(sf::Color::Black);
+        backend.setLayer((int)FrameLayer::BACKGROUND);
 
         // draw background;
         this->backgroundTexturePositionFloat.y += ((float)this->backgroundVelocity.y * dt);
@@ -1750,8 +875,8 @@ public:
             this->backgroundTexturePosition = { 0,0 };
             this->backgroundTexturePositionFloat = { 0.0f, 0.0f };
         }
-        this->backgroundSprite.setTextureRect(sf::IntRect(this->backgroundTexturePosition, this->backgroundTextureSize));
-        window.draw(this->backgroundSprite);
+        sf::Vector2f arenaCenter = this->backgroundDefaultPosition + sf::Vector2f(this->backgroundTextureSize) / 2.0f;
+        backend.drawSprite(TextureId::BACKGROUND, sf::IntRect(this->backgroundTexturePosition, this->backgroundTextureSize), arenaCenter, sf::Vector2f(this->backgroundTextureSize));
 
         this->backgroundTexturePositionFloat2.y += ((float)this->backgroundVelocity.y * dt * 3);
         this->backgroundTexturePosition2.y = (int)this->backgroundTexturePositionFloat2.y;
@@ -1760,10 +885,11 @@ public:
             this->backgroundTexturePosition2 = { 64,0 };
             this->backgroundTexturePositionFloat2 = { 64.0f, 0.0f };
         }
-        this->backgroundSprite2.setTextureRect(sf::IntRect(this->backgroundTexturePosition2, this->backgroundTextureSize));
-        window.draw(this->backgroundSprite2);
+        backend.drawSprite(TextureId::BACKGROUND_STARS, sf::IntRect(this->backgroundTexturePosition2, this->backgroundTextureSize), arenaCenter, sf::Vector2f(this->backgroundTextureSize));
 
-        for (int i = 0; i < this->backgroundStars.size(); i++)
+        // the governor thins the stars out by drawing only the first part of them
+        std::size_t stars = (std::size_t)(this->backgroundStars.size() * this->governor.quality().stars);
+        for (std::size_t i = 0; i < stars; i++)
         {
             this->backgroundStars[i].y -= dt * this->backgroundStarsSpeed;
             if (this->backgroundStars[i].y < this->miny)
@@ -1772,77 +898,236 @@ public:
                 this->backgroundStars[i].x = this->minx + std::rand() % (int)(this->maxx - this->minx);
             }
         }
-        sf::VertexArray stars = createVertexArray(this->backgroundStars, sf::Color::White);
-        stars.setPrimitiveType(sf::PrimitiveType::Points);
-        window.draw(stars);
-
+        backend.drawPoints(this->backgroundStars.data(), stars, sf::Color::White);
+    }
 
-        // draw game entities
+    void render(RenderBackend& backend, float dt)
+    {
+        this->renderBackground(backend, dt);
 
         // debug stuff
+        backend.setLayer((int)FrameLayer::HUD);
         if (this->debugEnabled)
         {
-            window.draw(this->box);
-            std::string s{ "Enemies: " };
-            s.append(std::to_string(this->enemyShips.size()));
-            this->textEnemies.setString(s);
-            window.draw(this->textEnemies);
+            backend.drawLineStrip(this->boundaries.data(), this->boundaries.size(), sf::Color::Cyan);
+            FrameString s("Enemies: ", &this->frameArena);
+            backend.drawText(appendNumber(s, this->sim.world.count<Enemy>()), { 50, 100 }, 36, sf::Color::Cyan);
+            if (allocationTracker.isTracking())
+            {
+                const AllocationStats& frame = allocationTracker.lastFrame;
+                s.assign("Allocations: ");
+                appendNumber(s, frame.count).append(" / ");
+                appendNumber(s, frame.bytes).append(" B");
+                backend.drawText(s, { 50, 150 }, 24, sf::Color::Cyan);
+                s.assign("sim ");
+                appendNumber(s, frame.tagCount[(int)AllocationTag::SIMULATION]).append(", effects ");
+                appendNumber(s, frame.tagCount[(int)AllocationTag::EFFECTS]).append(", render ");
+                appendNumber(s, frame.tagCount[(int)AllocationTag::RENDER]);
+                backend.drawText(s, { 50, 180 }, 24, sf::Color::Cyan);
+                s.assign("Heap: ");
+                appendNumber(s, allocationTracker.live.load() / 1024).append(" KB, peak ");
+                appendNumber(s, allocationTracker.peak.load() / 1024).append(" KB");
+                backend.drawText(s, { 50, 210 }, 24, sf::Color::Cyan);
+            }
+            s.assign("Frame arena: ");
+            appendNumber(s, this->frameArena.peak() / 1024).append(" / ");
+            appendNumber(s, this->frameArena.capacity() / 1024).append(" KB");
+            backend.drawText(s, { 50, 240 }, 24, sf::Color::Cyan);
+            const QualityLevel& quality = this->governor.quality();
+            s.assign("Quality ");
+            appendNumber(s, this->governor.currentLevel()).append(": resolution ");
+            appendNumber(s, (int)(quality.resolution * 100)).append("%, effects ");
+            appendNumber(s, (int)(quality.effects * 100)).append("%, stars ");
+            appendNumber(s, (int)(quality.stars * 100)).append("%");
+            backend.drawText(s, { 50, 270 }, 24, sf::Color::Cyan);
+            s.assign("Frame: ");
+            appendNumber(s, (int)(this->governor.averageSeconds() * 10000) / 10.0f).append(" ms, target ");
+            appendNumber(s, (int)(this->governor.targetSeconds * 10000) / 10.0f).append(" ms");
+            backend.drawText(s, { 50, 300 }, 24, sf::Color::Cyan);
+            if (this->pacer)
+            {
+                PacingStats pacing = this->pacer->stats();
+                s.assign("Pacing: ").append(pacingModeName(this->pacer->mode)).append(", ");
+                appendNumber(s, (int)(pacing.average * 10000) / 10.0f).append(" ms, jitter ");
+                appendNumber(s, (int)(pacing.deviation * 10000) / 10.0f).append(" ms, worst ");
+                appendNumber(s, (int)(pacing.worst * 10000) / 10.0f).append(" ms, missed ");
+                appendNumber(s, pacing.missed);
+                backend.drawText(s, { 50, 330 }, 24, sf::Color::Cyan);
+            }
         }
 
         // score
-        std::string s{ "Score: " };
-        this->textScore.setString(s.append(std::to_string(this->score)));
-        window.draw(this->textScore);
+        FrameString s("Score: ", &this->frameArena);
+        backend.drawText(appendNumber(s, this->sim.score), { 50, 50 }, 36, sf::Color::Cyan);
 
         // game assets
-        for (int i = 0; i < this->enemyShips.size(); i++)
+        drawSimulation(this->sim, backend, [&](int layer) { this->drawEffects(backend, layer); });
+    }
+
+    void game_loop(float dt, RenderBackend& frame)
+    {
+        // check inputs
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
+        {
+            this->lPressed = true;
+        }
+        else
+        {
+            this->lPressed = false;
+        }
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
         {
-            window.draw(*this->enemyShips[i]);
+            this->rPressed = true;
+        }
+        else
+        {
+            this->rPressed = false;
+        }
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::F1))
+        {
+            this->debugEnabled = !this->debugEnabled;
         }
-        for (int i = 0; i < this->animations.size(); i++)
+        // debug powerups and victory trigger
+        std::uint32_t cheats = 0;
+        cheats |= sf::Keyboard::isKeyPressed(sf::Keyboard::F2) ? CHEAT_POWERUPS : 0;
+        cheats |= sf::Keyboard::isKeyPressed(sf::Keyboard::BackSpace) ? CHEAT_CLEAR_WAVES : 0;
+        applyCheats(this->sim, cheats);
+        flightRecorder.cheat(cheats);
+
+        std::uint32_t actions[maxPlayers] = {};
+        actions[0] |= this->lPressed ? ACTION_LEFT : 0;
+        actions[0] |= this->rPressed ? ACTION_RIGHT : 0;
+        actions[0] |= sf::Keyboard::isKeyPressed(sf::Keyboard::Up) ? ACTION_FIRE_LASER : 0;
+        actions[0] |= sf::Keyboard::isKeyPressed(sf::Keyboard::Space) ? ACTION_FIRE_MISSILES : 0;
+        actions[0] |= sf::Keyboard::isKeyPressed(sf::Keyboard::Down) ? ACTION_FIRE_BEAM : 0;
+        if (this->sim.playerCount == 2 && !this->host)
         {
-            window.draw(this->animations[i]);
+            actions[1] = secondPlayerActions();
         }
-        for (int i = 0; i < this->playerLasers.size(); i++)
+        SimStatus status;
         {
-            window.draw(*this->playerLasers[i]);
+            Telemetry::Scope phase(telemetry, TelemetryEvent::PHASE_SIMULATION);
+            AllocationScope scope(AllocationTag::SIMULATION);
+            if (this->host)
+            {
+                status = this->hostedStep(actions, dt);
+            }
+            else
+            {
+                status = this->sim.stepPlayers(actions, dt);
+                flightRecorder.recordStep(actions, dt, this->sim);
+            }
         }
-        for (int i = 0; i < this->playerMissiles.size(); i++)
+        telemetry.record(TelemetryEvent::ENTITIES, (std::uint32_t)this->sim.world.aliveCount);
+
+        // animation
         {
-            window.draw(this->playerMissiles[i]);
+            Telemetry::Scope phase(telemetry, TelemetryEvent::PHASE_EFFECTS);
+            AllocationScope scope(AllocationTag::EFFECTS);
+            if (!this->host)
+            {
+                this->eventSystem();
+            }
+            this->animationSystem(dt);
+            this->particleSystem(dt);
         }
-        for (int i = 0; i < this->enemyLasers.size(); i++)
+
+        // check victory and defeat
+        if (status != SimStatus::RUNNING)
         {
-            window.draw(*this->enemyLasers[i]);
+            navigation.push(status == SimStatus::VICTORY ? Navigation::NavigationStates::VICTORY : Navigation::NavigationStates::GAME_OVER);
+            return;
         }
-        for (int i = 0; i < this->powerups.size(); i++)
+
+        // record the frame, main sorts and submits it
+        Telemetry::Scope phase(telemetry, TelemetryEvent::PHASE_RECORD);
+        AllocationScope scope(AllocationTag::RENDER);
+        this->render(frame, dt);
+    }
+
+    // paused: the match is drawn as it was left, main sleeps on window events in between
+    void pause_loop(RenderBackend& frame)
+    {
+        this->render(frame, 0.0f);
+        frame.setLayer((int)FrameLayer::HUD);
+        frame.drawText("Paused, P to resume", { 620, 380 }, 36, sf::Color::Cyan);
+    }
+
+    // local co-op keys
+    static std::uint32_t secondPlayerActions()
+    {
+        std::uint32_t actions = 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::A) ? ACTION_LEFT : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::D) ? ACTION_RIGHT : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::W) ? ACTION_FIRE_LASER : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) ? ACTION_FIRE_MISSILES : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::S) ? ACTION_FIRE_BEAM : 0;
+        return actions;
+    }
+
+    // hosting runs the match in fixed ticks, the remote inputs and snapshots are per tick
+    SimStatus hostedStep(std::uint32_t* actions, float dt)
+    {
+        this->netAccumulator = std::min(this->netAccumulator + dt, 0.25f);
+        while (this->netAccumulator >= netTickSeconds)
         {
-            window.draw(this->powerups[i]);
+            this->netAccumulator -= netTickSeconds;
+            this->netClock += netTickSeconds;
+            {
+                AllocationScope scope(AllocationTag::NETWORK);
+                this->host->receive(this->netClock);
+                actions[1] = this->host->nextInput();
+            }
+            this->sim.stepPlayers(actions, netTickSeconds);
+            flightRecorder.recordStep(actions, netTickSeconds, this->sim);
+            this->eventSystem();
+            AllocationScope scope(AllocationTag::NETWORK);
+            this->host->afterStep(this->sim, this->netClock);
+            if (this->sim.status != SimStatus::RUNNING)
+            {
+                break;
+            }
         }
+        return this->sim.status;
+    }
 
-        if (this->bossActive)
+    // joined to a host: no local simulation, only inputs going up and the host's view coming down
+    void client_loop(float dt, NetClient& client, RenderBackend& frame)
+    {
+        std::uint32_t actions = 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::Left) ? ACTION_LEFT : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::Right) ? ACTION_RIGHT : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::Up) ? ACTION_FIRE_LASER : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::Space) ? ACTION_FIRE_MISSILES : 0;
+        actions |= sf::Keyboard::isKeyPressed(sf::Keyboard::Down) ? ACTION_FIRE_BEAM : 0;
         {
-            sf::VertexArray healthBarOutlineVA;
-            healthBarOutlineVA.setPrimitiveType(sf::PrimitiveType::LinesStrip);
-            healthBarOutlineVA.append({{ this->minx, this->miny }, sf::Color::Green});
-            healthBarOutlineVA.append({{ this->maxx, this->miny }, sf::Color::Green});
-            healthBarOutlineVA.append({{ this->maxx, 5.0f }, sf::Color::Green});
-            healthBarOutlineVA.append({{ this->minx, 5.0f }, sf::Color::Green});
-            healthBarOutlineVA.append({{ this->minx, this->miny }, sf::Color::Green});
-
-            sf::VertexArray healthBarVA;
-            healthBarVA.setPrimitiveType(sf::PrimitiveType::TrianglesStrip);
-            healthBarVA.append({ { this->minx, this->miny }, sf::Color::Green });
-            healthBarVA.append({ { this->minx + (this->maxx - this->minx) * this->enemyShips[0]->hp / 2000, this->miny }, sf::Color::Green });
-            healthBarVA.append({ { this->minx + (this->maxx - this->minx) * this->enemyShips[0]->hp / 2000, 5.0f }, sf::Color::Green });
-            healthBarVA.append({ { this->minx, 5.0f }, sf::Color::Green });
-            healthBarVA.append({ { this->minx, this->miny }, sf::Color::Green });
-
-            window.draw(healthBarOutlineVA);
-            window.draw(healthBarVA);
+            AllocationScope scope(AllocationTag::NETWORK);
+            this->netAccumulator = std::min(this->netAccumulator + dt, 0.25f);
+            while (this->netAccumulator >= netTickSeconds)
+            {
+                this->netAccumulator -= netTickSeconds;
+                this->netClock += netTickSeconds;
+                client.update(actions, this->netClock);
+            }
+            client.receive(this->netClock);
         }
 
-        window.draw(this->playerShip);
+        AllocationScope scope(AllocationTag::RENDER);
+        this->renderBackground(frame, dt);
+        client.draw(frame);
+        frame.setLayer((int)FrameLayer::HUD);
+        const NetSnapshot* snapshot = client.latestSnapshot();
+        if (!snapshot)
+        {
+            frame.drawText("Waiting for host...", { 50, 50 }, 36, sf::Color::Cyan);
+            return;
+        }
+        FrameString s("Score: ", &this->frameArena);
+        frame.drawText(appendNumber(s, snapshot->score), { 50, 50 }, 36, sf::Color::Cyan);
+        if (snapshot->status != (int)SimStatus::RUNNING)
+        {
+            frame.drawText(snapshot->status == (int)SimStatus::VICTORY ? "Victory!" : "Game over", { 700, 380 }, 48, sf::Color::Cyan);
+        }
     }
 
 };
@@ -1851,16 +1136,167 @@ public:
 std::unique_ptr<Game> gameState;
 MenuEntity menuState;
 
-int main()
+int main(int argc, char* argv[])
 {
+    // offline tools
+    if (argc == 4 && std::string(argv[1]) == "--compile-level")
+    {
+        LevelCompiler compiler;
+        if (!compiler.compileFile(argv[2], argv[3]))
+        {
+            std::cout << argv[2] << ": " << compiler.error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--level-test")
+    {
+        return testLevelLoader() ? 0 : 1;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-particles")
+    {
+        benchmarkParticles(argc >= 3 ? std::atoi(argv[2]) : 200000, 300);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-sim")
+    {
+        benchmarkSimulation(argc >= 3 ? std::atoll(argv[2]) : 1000000);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-formation")
+    {
+        benchmarkFormation(argc >= 3 ? std::atoi(argv[2]) : 10000, 1000);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-patterns")
+    {
+        benchmarkFiringPatterns(argc >= 3 ? std::atoi(argv[2]) : 100000);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-bullets")
+    {
+        benchmarkBulletVM(argc >= 3 ? std::atoi(argv[2]) : 2000, 600);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-batch")
+    {
+        benchmarkBatch(argc >= 3 ? std::atoi(argv[2]) : 256, argc >= 4 ? std::atoi(argv[3]) : 0, 200);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-spatial")
+    {
+        benchmarkSpatial(argc >= 3 ? std::atoi(argv[2]) : 2000, 20000);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-timers")
+    {
+        benchmarkTimers(argc >= 3 ? std::atoi(argv[2]) : 10000, 6000);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-collision")
+    {
+        std::shared_ptr<const CollisionMasks> masks = loadCollisionMasks();
+        benchmarkCollision(masks->byTexture[(int)TextureId::ENEMY], argc >= 3 ? std::atoi(argv[2]) : 10000, 200);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-scenarios")
+    {
+        return runScenarios(argc >= 3 ? argv[2] : "scenarios.json", argc >= 4 ? argv[3] : "", argc >= 5 ? std::atof(argv[4]) : 10.0) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--replay-frame")
+    {
+        replayRenderCommands(argv[2], argc >= 4 ? std::atoi(argv[3]) : 1600, argc >= 5 ? std::atoi(argv[4]) : 800, 100);
+        return 0;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--telemetry")
+    {
+        return dumpTelemetry(argv[2], argc >= 4 ? argv[3] : "summary") ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--replay-flight")
+    {
+        return replayFlight(argv[2], argc >= 4 ? std::atoi(argv[3]) : 0) ? 0 : 1;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-telemetry")
+    {
+        benchmarkTelemetry(argc >= 3 ? std::atoi(argv[2]) : 200000);
+        return 0;
+    }
+    // --net-test [seconds [loss % [latency ms [jitter ms [scenario]]]]]: level1, or the level of
+    // one of the --bench-scenarios fights (storm, formation, ...) with ships that can't die
+    if (argc >= 2 && std::string(argv[1]) == "--net-test")
+    {
+        NetConditions conditions;
+        conditions.loss = argc >= 4 ? (float)std::atof(argv[3]) / 100.0f : 0.05f;
+        conditions.latency = argc >= 5 ? (float)std::atof(argv[4]) / 1000.0f : 0.05f;
+        conditions.jitter = argc >= 6 ? (float)std::atof(argv[5]) / 1000.0f : 0.01f;
+        const Scenario* scenario = argc >= 7 ? findScenario(argv[6]) : nullptr;
+        if (argc >= 7 && !scenario)
+        {
+            std::cout << "no scenario called " << argv[6] << std::endl;
+            return 1;
+        }
+        Simulation sim;
+        if (scenario ? !loadScenarioLevel(*scenario, sim) : !sim.loadDefaultLevel())
+        {
+            std::cout << "can't load level" << std::endl;
+            return 1;
+        }
+        testNetLoopback(sim, argc >= 3 ? std::atoi(argv[2]) : 60, conditions, scenario != nullptr);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--render-frames")
+    {
+        SoftwareRenderer::Sampling sampling = argc >= 6 && std::string(argv[5]) == "bilinear" ? SoftwareRenderer::Sampling::BILINEAR : SoftwareRenderer::Sampling::NEAREST;
+        benchmarkSoftwareRenderer(argc >= 3 ? std::atoi(argv[2]) : 600, argc >= 4 ? std::atoi(argv[3]) : 84, argc >= 5 ? std::atoi(argv[4]) : 84, sampling);
+        return 0;
+    }
+
+    // frame pacing: --fps <rate> (the default, 60), --vsync or --uncapped, anywhere on the line
+    FramePacer pacer;
+    argc = pacer.configure(argc, argv);
+    // frames longer than --spike-ms <ms> (100 by default) dump the flight recorder
+    argc = flightRecorder.configure(argc, argv);
+
+    // game modes: --coop (second player on A/D/W/left shift/S), --host [port], --join address [port]
+    std::unique_ptr<NetHost> host;
+    std::unique_ptr<NetClient> client;
+    int playerCount = 1;
+    if (argc >= 2 && std::string(argv[1]) == "--coop")
+    {
+        playerCount = 2;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--host")
+    {
+        host = std::make_unique<NetHost>();
+        if (!host->open(argc >= 3 ? (unsigned short)std::atoi(argv[2]) : netDefaultPort))
+        {
+            std::cout << "can't listen on that port" << std::endl;
+            return 1;
+        }
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--join")
+    {
+        client = std::make_unique<NetClient>();
+        client->arena = config;
+        if (!client->connect(sf::IpAddress(argv[2]), argc >= 4 ? (unsigned short)std::atoi(argv[3]) : netDefaultPort))
+        {
+            std::cout << "can't open a socket" << std::endl;
+            return 1;
+        }
+    }
+
     std::srand(std::time(nullptr));
     sf::RenderWindow window(sf::VideoMode(1600, 800), "Invaders! Oh noes!");// , sf::Style::Fullscreen);
     sf::View camera;
     camera.setCenter(800, 400);
     camera.setSize(1600, 800);
     window.setView(camera);
+    pacer.apply(window);
 
     gameState = std::make_unique<Game>();
+    gameState->playerCount = playerCount;
+    gameState->host = host.get();
+    gameState->pacer = &pacer;
     //std::unique_ptr<Game> gameState2;
     //gameState2 = gameState; // error
     // music
@@ -1871,9 +1307,24 @@ int main()
     menuMusic.setVolume(10.0f);
 
     globalTextures.init();
+    animationClips.init();
     gameState->game_init();
     menuState.menu_init();
 
+    // every state records its frame into one command list, submitted to the window once per frame
+    SfmlRenderer windowRenderer;
+    windowRenderer.init(window, globalTextures.byId, gameState->font);
+    RenderCommandList frame;
+    frame.setTextureSizes(windowRenderer);
+    // when the governor lowers the resolution the world layers go to the top left corner of
+    // this texture, only as many pixels as the scale asks for, and are stretched over the window
+    sf::RenderTexture sceneTexture;
+    sceneTexture.create(window.getSize().x, window.getSize().y);
+    sceneTexture.setSmooth(true);
+    SfmlRenderer sceneRenderer;
+    sceneRenderer.init(sceneTexture, globalTextures.byId, gameState->font);
+    sf::Sprite sceneSprite(sceneTexture.getTexture());
+
     // setting up utility vars
 
     sf::Vector2i mousePos = sf::Mouse::getPosition(window);
@@ -1882,14 +1333,28 @@ int main()
     sf::Clock frameClock;
     float dt;
 
+    // every run leaves a log of its frame costs and match events for --telemetry
+    telemetry.start("session.sitl");
+    // and keeps the last seconds of them for --replay-flight, dumped on a spike, F6 or a crash
+    flightRecorder.install();
+    Navigation::NavigationStates previousState = navigation.current();
+    telemetry.record(TelemetryEvent::STATE, (std::uint32_t)previousState);
+    bool heapGuarded = false;
+
     // game loop
 
     while (window.isOpen())
     {
+        std::uint64_t frameBegin = telemetry.now();
+        std::uint64_t inputBegin = frameBegin;
+        currentAllocationTag = AllocationTag::INPUT;
         bool shouldExit = false;
         sf::Event event;
-        while (window.pollEvent(event))
+        // paused, nothing on screen changes until something happens: sleep until it does
+        bool waiting = navigation.current() == Navigation::NavigationStates::PAUSE;
+        while (waiting ? window.waitEvent(event) : window.pollEvent(event))
         {
+            waiting = false;
             switch (event.type)
             {
             case sf::Event::Closed:
@@ -1897,11 +1362,66 @@ int main()
                 shouldExit = true;
                 break;
             }
+            // in the background the loop throttles down, and a local match pauses itself.
+            // a networked one can't stop, it keeps ticking at the throttled rate
+            case sf::Event::LostFocus:
+            {
+                pacer.throttled = true;
+                if (navigation.current() == Navigation::NavigationStates::GAME && !host && !client)
+                {
+                    navigation.push(Navigation::NavigationStates::PAUSE);
+                }
+                break;
+            }
+            case sf::Event::GainedFocus:
+            {
+                pacer.throttled = false;
+                break;
+            }
             case sf::Event::KeyPressed:
             {
-                if (navigation.currentState == Navigation::NavigationStates::GAME_OVER || navigation.currentState == Navigation::NavigationStates::VICTORY)
+                // P pauses and resumes a local match
+                if (event.key.code == sf::Keyboard::P && !host && !client)
+                {
+                    if (navigation.current() == Navigation::NavigationStates::GAME)
+                    {
+                        navigation.push(Navigation::NavigationStates::PAUSE);
+                    }
+                    else if (navigation.current() == Navigation::NavigationStates::PAUSE)
+                    {
+                        navigation.pop();
+                        // the time spent paused is not a frame
+                        frameClock.restart();
+                    }
+                }
+                if (navigation.current() == Navigation::NavigationStates::GAME_OVER || navigation.current() == Navigation::NavigationStates::VICTORY)
                 {
                     menuState.keyPressed = true;
+                    menuState.restartPressed = event.key.code == sf::Keyboard::R;
+                }
+                // F4 toggles allocation tracking, the report is written when it stops
+                if (event.key.code == sf::Keyboard::F4)
+                {
+                    if (allocationTracker.isTracking())
+                    {
+                        allocationTracker.writeReport("allocations.txt");
+                        allocationTracker.stop();
+                    }
+                    else
+                    {
+                        allocationTracker.start();
+                    }
+                }
+                // F5 guards the game frames: mid-wave they run on the frame arenas alone and
+                // debug builds assert on any heap allocation. a wave start can still grow
+                // the entity pools the first time it is played
+                if (event.key.code == sf::Keyboard::F5)
+                {
+                    heapGuarded = !heapGuarded;
+                }
+                if (event.key.code == sf::Keyboard::F6)
+                {
+                    flightRecorder.requestDump();
                 }
                 break;
             }
@@ -1915,43 +1435,126 @@ int main()
 
         if (shouldExit)
         {
+            if (allocationTracker.isTracking())
+            {
+                allocationTracker.writeReport("allocations.txt");
+            }
+            flightRecorder.uninstall();
             gameState = nullptr;
             window.close();
+            telemetry.stop();
             return 0;
         }
         dt = frameClock.restart().asSeconds();
         mousePos = sf::Mouse::getPosition(window);
         mousePosWorld = window.mapPixelToCoords(mousePos);
+        telemetry.recordDuration(TelemetryEvent::PHASE_INPUT, inputBegin);
+        currentAllocationTag = AllocationTag::OTHER;
 
-        switch (navigation.currentState)
+        // a joined client has no menus of its own, the host drives the match
+        if (client)
         {
-		case Navigation::NavigationStates::GAME:
-		{
-			if (navigation.gameOver)
+            gameState->client_loop(dt, *client, frame);
+        }
+        else
+        {
+            // a scene that was just pushed starts fresh, one uncovered by a pop goes on
+            if (navigation.takeEntered())
+            {
+                switch (navigation.current())
+                {
+                case Navigation::NavigationStates::GAME:
+                    gameState->round_init();
+                    break;
+                case Navigation::NavigationStates::GAME_OVER:
+                case Navigation::NavigationStates::VICTORY:
+                    menuState.results_init();
+                    break;
+                default:
+                    break;
+                }
+            }
+            switch (navigation.current())
+            {
+			case Navigation::NavigationStates::GAME:
+			{
+				HeapGuard guard(heapGuarded);
+				gameState->game_loop(dt, frame);
+				break;
+			}
+			case Navigation::NavigationStates::MENU:
+			{
+				menuState.menu_loop(dt, window, frame);
+				break;
+			}
+			case Navigation::NavigationStates::GAME_OVER:
+			{
+				menuState.results_loop(dt, frame, TextureId::DEFEAT);
+				break;
+			}
+			case Navigation::NavigationStates::VICTORY:
+			{
+				menuState.results_loop(dt, frame, TextureId::VICTORY);
+				break;
+			}
+			case Navigation::NavigationStates::PAUSE:
 			{
-				gameState->game_init();
-				navigation.gameOver = false;
+				gameState->pause_loop(frame);
+				break;
 			}
-			gameState->game_loop(dt, window);
-			break;
-		}
-		case Navigation::NavigationStates::MENU:
-		{
-			menuState.menu_loop(dt, window);
-			break;
-		}
-		case Navigation::NavigationStates::GAME_OVER:
-		{
-			menuState.game_over_loop(dt, window);
-			break;
-		}
-		case Navigation::NavigationStates::VICTORY:
-		{
-			menuState.victory_loop(dt, window);
-			break;
-		}
+            }
+        }
+        if (navigation.current() != previousState)
+        {
+            previousState = navigation.current();
+            telemetry.record(TelemetryEvent::STATE, (std::uint32_t)previousState);
+        }
+        // F3 saves the frame for --replay-frame
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::F3))
+        {
+            frame.saveToFile("capture.rcl");
+        }
+        std::uint64_t submitBegin = telemetry.now();
+        currentAllocationTag = AllocationTag::SUBMIT;
+        {
+            HeapGuard guard(heapGuarded && navigation.current() == Navigation::NavigationStates::GAME);
+            frame.sort(&gameState->frameArena);
+        }
+        float resolution = gameState->governor.quality().resolution;
+        if (resolution < 1.0f && navigation.current() == Navigation::NavigationStates::GAME)
+        {
+            sf::View scaled = camera;
+            scaled.setViewport(sf::FloatRect(0.0f, 0.0f, resolution, resolution));
+            sceneTexture.setView(scaled);
+            frame.submit(sceneRenderer, 0, (int)FrameLayer::HUD);
+            sceneTexture.display();
+            sf::Vector2u size = sceneTexture.getSize();
+            sceneSprite.setTextureRect(sf::IntRect(0, 0, (int)(size.x * resolution), (int)(size.y * resolution)));
+            sceneSprite.setScale(1.0f / resolution, 1.0f / resolution);
+            window.clear();
+            window.draw(sceneSprite);
+            // the hud stays sharp, drawn over the upscaled world
+            frame.submit(windowRenderer, (int)FrameLayer::HUD, (int)FrameLayer::COUNT, false);
+        }
+        else
+        {
+            frame.submit(windowRenderer);
         }
+        std::uint64_t presentBegin = telemetry.now();
         window.display();
+        currentAllocationTag = AllocationTag::OTHER;
+        telemetry.recordDuration(TelemetryEvent::PHASE_SUBMIT, submitBegin);
+        telemetry.recordDuration(TelemetryEvent::FRAME, frameBegin);
+        flightRecorder.endFrame((std::uint32_t)navigation.current(), navigation.current() == Navigation::NavigationStates::GAME);
+        // the governor wants the work a frame took; with vsync display() also waits for the monitor
+        std::uint64_t workEnd = pacer.mode == PacingMode::VSYNC ? presentBegin : telemetry.now();
+        if (navigation.current() == Navigation::NavigationStates::GAME && gameState->governor.update((workEnd - frameBegin) / 1e9f))
+        {
+            gameState->applyQuality();
+        }
+        gameState->frameArena.reset();
+        allocationTracker.endFrame();
+        pacer.wait();
 
     }
     return 0;
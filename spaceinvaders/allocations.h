@@ -0,0 +1,367 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+#if defined(_WIN32)
+extern "C" __declspec(dllimport) unsigned short __stdcall RtlCaptureStackBackTrace(unsigned long framesToSkip, unsigned long framesToCapture, void** backTrace, unsigned long* backTraceHash);
+extern "C" __declspec(dllimport) void* __stdcall GetModuleHandleA(const char* moduleName);
+#elif defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+
+// =================================
+// ALLOCATION TRACKING
+// =================================
+
+// the game replaces the global operator new / delete (Source.cpp) with allocate/release
+// below. every block carries a small header with its size, so the live heap and its peak
+// are always known; everything else only runs while tracking is switched on (F4):
+// allocations and bytes per frame, split by the subsystem scope that made them, and the
+// call stacks that allocate the most, written to allocations.txt when tracking stops.
+//
+// a scope tags what the current thread allocates until it ends:
+//   AllocationScope scope(AllocationTag::SIMULATION);
+//
+// the tracker is constant initialized (no constructor code runs), so static initializers
+// elsewhere can allocate before it and still be counted.
+//
+// code that must not touch the heap at all runs inside a HeapGuard. in debug builds an
+// allocation while a guard is open on the same thread asserts, with the culprit on the stack.
+
+enum class AllocationTag : std::uint8_t
+{
+    OTHER = 0,
+    INPUT = 1,
+    SIMULATION = 2,
+    EFFECTS = 3,
+    RENDER = 4,
+    SUBMIT = 5,
+    NETWORK = 6,
+    COUNT
+};
+
+inline const char* allocationTagName(AllocationTag tag)
+{
+    static const char* names[(int)AllocationTag::COUNT] = { "other", "input", "simulation", "effects", "render", "submit", "network" };
+    return names[(int)tag];
+}
+
+inline thread_local AllocationTag currentAllocationTag = AllocationTag::OTHER;
+
+struct AllocationScope
+{
+    AllocationTag previous;
+
+    explicit AllocationScope(AllocationTag tag) : previous(currentAllocationTag)
+    {
+        currentAllocationTag = tag;
+    }
+
+    ~AllocationScope()
+    {
+        currentAllocationTag = this->previous;
+    }
+};
+
+inline thread_local int heapGuardDepth = 0;
+
+struct HeapGuard
+{
+    bool armed;
+
+    explicit HeapGuard(bool armed = true) : armed(armed)
+    {
+        if (armed)
+        {
+            heapGuardDepth++;
+        }
+    }
+
+    ~HeapGuard()
+    {
+        if (this->armed)
+        {
+            heapGuardDepth--;
+        }
+    }
+};
+
+// counts of one frame, or of the whole tracked run
+struct AllocationStats
+{
+    std::uint64_t count{ 0 };
+    std::uint64_t bytes{ 0 };
+    std::uint64_t tagCount[(int)AllocationTag::COUNT]{};
+    std::uint64_t tagBytes[(int)AllocationTag::COUNT]{};
+};
+
+class AllocationTracker
+{
+public:
+    static const int stackDepth = 8;
+    static const int siteCapacity = 4096; // power of two
+    // keeps blocks aligned for any fundamental type
+    static const std::size_t headerSize = 16;
+
+    // one call stack and tag, and everything it allocated while tracking
+    struct Site
+    {
+        std::uint64_t hash{ 0 };
+        void* frames[stackDepth]{};
+        int frameCount{ 0 };
+        AllocationTag tag{ AllocationTag::OTHER };
+        std::uint64_t count{ 0 }, bytes{ 0 };
+    };
+
+    std::atomic<std::int64_t> live{ 0 }, peak{ 0 };
+    AllocationStats lastFrame, total;
+    std::uint64_t frames{ 0 }, worstFrameCount{ 0 }, worstFrameBytes{ 0 };
+
+    void* allocate(std::size_t size)
+    {
+        assert(heapGuardDepth == 0 && "heap allocation inside a HeapGuard");
+        char* block = static_cast<char*>(std::malloc(size + headerSize));
+        if (!block)
+        {
+            throw std::bad_alloc();
+        }
+        std::memcpy(block, &size, sizeof(size));
+        std::int64_t live = this->live.fetch_add((std::int64_t)size, std::memory_order_relaxed) + (std::int64_t)size;
+        std::int64_t peak = this->peak.load(std::memory_order_relaxed);
+        while (live > peak && !this->peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+        if (this->tracking.load(std::memory_order_relaxed))
+        {
+            this->count(size);
+        }
+        return block + headerSize;
+    }
+
+    void release(void* pointer)
+    {
+        if (!pointer)
+        {
+            return;
+        }
+        char* block = static_cast<char*>(pointer) - headerSize;
+        std::size_t size;
+        std::memcpy(&size, block, sizeof(size));
+        this->live.fetch_sub((std::int64_t)size, std::memory_order_relaxed);
+        std::free(block);
+    }
+
+    bool isTracking() const
+    {
+        return this->tracking.load(std::memory_order_relaxed);
+    }
+
+    void start()
+    {
+        this->lock();
+        std::fill(std::begin(this->sites), std::end(this->sites), Site());
+        this->siteCount = 0;
+        this->unrecorded = 0;
+        this->frame = AllocationStats();
+        this->unlock();
+        this->lastFrame = this->total = AllocationStats();
+        this->frames = this->worstFrameCount = this->worstFrameBytes = 0;
+#if defined(__GLIBC__)
+        // the first backtrace loads the unwinder, which allocates; get that out of the way
+        void* warmup[1];
+        backtrace(warmup, 1);
+#endif
+        this->tracking.store(true);
+    }
+
+    void stop()
+    {
+        this->tracking.store(false);
+    }
+
+    // closes the frame: its counts become lastFrame and go into the totals
+    void endFrame()
+    {
+        if (!this->isTracking())
+        {
+            return;
+        }
+        this->lock();
+        this->lastFrame = this->frame;
+        this->frame = AllocationStats();
+        this->unlock();
+        this->frames++;
+        this->total.count += this->lastFrame.count;
+        this->total.bytes += this->lastFrame.bytes;
+        for (int i = 0; i < (int)AllocationTag::COUNT; i++)
+        {
+            this->total.tagCount[i] += this->lastFrame.tagCount[i];
+            this->total.tagBytes[i] += this->lastFrame.tagBytes[i];
+        }
+        this->worstFrameCount = std::max(this->worstFrameCount, this->lastFrame.count);
+        this->worstFrameBytes = std::max(this->worstFrameBytes, this->lastFrame.bytes);
+    }
+
+    // totals, the split by tag and the top call sites. on windows the frames are offsets
+    // into the executable, resolve them against its .pdb
+    bool writeReport(const std::string& filename)
+    {
+        bool wasTracking = this->isTracking();
+        this->stop();
+        std::vector<Site> sites;
+        this->lock();
+        for (int i = 0; i < siteCapacity; i++)
+        {
+            if (this->sites[i].count)
+            {
+                sites.push_back(this->sites[i]);
+            }
+        }
+        std::uint64_t unrecorded = this->unrecorded;
+        this->unlock();
+        std::sort(sites.begin(), sites.end(), [](const Site& a, const Site& b) { return a.count > b.count; });
+
+        std::ofstream out(filename);
+        double frames = (double)std::max<std::uint64_t>(this->frames, 1);
+        out << "frames: " << this->frames << "\n";
+        out << "allocations: " << this->total.count << " (" << this->total.count / frames << " per frame, worst frame " << this->worstFrameCount << ")\n";
+        out << "bytes: " << this->total.bytes << " (" << this->total.bytes / frames << " per frame, worst frame " << this->worstFrameBytes << ")\n";
+        out << "live heap: " << this->live.load() << " bytes, peak " << this->peak.load() << " bytes\n\n";
+        out << "by scope:\n";
+        for (int i = 0; i < (int)AllocationTag::COUNT; i++)
+        {
+            out << "  " << allocationTagName((AllocationTag)i) << ": " << this->total.tagCount[i] << " allocations, " << this->total.tagBytes[i] << " bytes\n";
+        }
+        out << "\ntop call sites:" << (unrecorded ? " (" + std::to_string(unrecorded) + " allocations past the site table)" : std::string()) << "\n";
+        for (std::size_t i = 0; i < sites.size() && i < 20; i++)
+        {
+            const Site& site = sites[i];
+            out << "\n" << site.count << " allocations, " << site.bytes << " bytes, " << allocationTagName(site.tag) << "\n";
+#if defined(__GLIBC__)
+            char** symbols = backtrace_symbols(site.frames, site.frameCount);
+            for (int f = 0; f < site.frameCount; f++)
+            {
+                out << "    " << (symbols ? symbols[f] : "?") << "\n";
+            }
+            std::free(symbols);
+#else
+            for (int f = 0; f < site.frameCount; f++)
+            {
+                out << "    +0x" << std::hex << this->moduleOffset(site.frames[f]) << std::dec << "\n";
+            }
+#endif
+        }
+        if (wasTracking)
+        {
+            this->tracking.store(true);
+        }
+        return (bool)out;
+    }
+
+private:
+    std::atomic<bool> tracking{ false };
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    AllocationStats frame;
+    Site sites[siteCapacity];
+    int siteCount{ 0 };
+    std::uint64_t unrecorded{ 0 };
+
+    void lock()
+    {
+        while (this->busy.test_and_set(std::memory_order_acquire))
+        {
+        }
+    }
+
+    void unlock()
+    {
+        this->busy.clear(std::memory_order_release);
+    }
+
+    // called from operator new: must not allocate, and must not recurse when the unwinder does
+    void count(std::size_t size)
+    {
+        thread_local bool inside = false;
+        if (inside)
+        {
+            return;
+        }
+        inside = true;
+        AllocationTag tag = currentAllocationTag;
+        void* frames[stackDepth + 2];
+        int frameCount = this->captureStack(frames, stackDepth + 2);
+        // drop count() and allocate() themselves
+        int skip = std::min(frameCount, 2);
+        std::uint64_t hash = 1469598103934665603ull ^ (std::uint64_t)tag;
+        for (int i = skip; i < frameCount; i++)
+        {
+            hash = (hash ^ (std::uint64_t)(std::uintptr_t)frames[i]) * 1099511628211ull;
+        }
+        hash |= 1; // 0 marks an empty slot
+
+        this->lock();
+        this->frame.count++;
+        this->frame.bytes += size;
+        this->frame.tagCount[(int)tag]++;
+        this->frame.tagBytes[(int)tag] += size;
+        Site* site = nullptr;
+        for (int probe = 0; probe < 64; probe++)
+        {
+            Site& slot = this->sites[(hash + probe) & (siteCapacity - 1)];
+            if (slot.hash == hash || slot.hash == 0)
+            {
+                site = &slot;
+                break;
+            }
+        }
+        if (site && site->hash == 0 && this->siteCount < siteCapacity / 2)
+        {
+            site->hash = hash;
+            site->tag = tag;
+            site->frameCount = frameCount - skip;
+            std::memcpy(site->frames, frames + skip, site->frameCount * sizeof(void*));
+            this->siteCount++;
+        }
+        if (site && site->hash == hash)
+        {
+            site->count++;
+            site->bytes += size;
+        }
+        else
+        {
+            this->unrecorded++;
+        }
+        this->unlock();
+        inside = false;
+    }
+
+    int captureStack(void** frames, int depth)
+    {
+#if defined(_WIN32)
+        return RtlCaptureStackBackTrace(0, (unsigned long)depth, frames, nullptr);
+#elif defined(__GLIBC__)
+        return backtrace(frames, depth);
+#else
+        return 0;
+#endif
+    }
+
+    std::uintptr_t moduleOffset(void* address)
+    {
+#if defined(_WIN32)
+        return (std::uintptr_t)address - (std::uintptr_t)GetModuleHandleA(nullptr);
+#else
+        return (std::uintptr_t)address;
+#endif
+    }
+};
+
+inline AllocationTracker allocationTracker;
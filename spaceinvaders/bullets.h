@@ -0,0 +1,536 @@
+#pragma once
+#include <SFML/System/Vector2.hpp>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include "ecs.h"
+
+// =================================
+// BULLET SCRIPTS
+// =================================
+
+// boss attacks are small scripts instead of C++ classes, in the spirit of BulletML. a level
+// ships its scripts as text next to the compiled level (assets/levels/<name>.bullets); they
+// are compiled to bytecode when the level loads and boss phases start them by name.
+//
+// text format, one statement per line, '#' starts a comment:
+//
+//   emitter <name>             opens a routine, closed by 'end'
+//     fire [angle] [speed]     one bullet, 'angle' degrees off the current direction,
+//                              at 'speed' or the current speed
+//     wait <seconds>           the emitter sleeps, the rest of the tick goes to other emitters
+//     repeat <n>|forever       runs the statements up to the matching 'end' n times
+//     aim [angle]              points the direction at the nearest player, plus 'angle'
+//     direction <angle>        absolute direction. 0 points straight down, 90 to the right
+//     rotate <angle>           turns the direction
+//     speed <value>            speed of the bullets fired from now on
+//     accelerate <value>       their acceleration along the direction they were fired in
+//     spawn <name> [speed]     starts a child emitter running <name> here, moving along the
+//                              current direction. it inherits direction, speed and acceleration.
+//                              without a speed it rides the same ship as its parent
+//   end
+//
+// an emitter is a register file (direction, speed, acceleration, wait timer, loop counters)
+// that the instructions read and write in place, there is no operand stack. emitters live in
+// an array reserved up front, so running them never allocates.
+
+enum class BulletOp : std::uint8_t
+{
+    FIRE = 0,
+    WAIT = 1,
+    REPEAT = 2,
+    LOOP = 3,       // end of a repeat, jumps back to 'target'
+    AIM = 4,
+    DIRECTION = 5,
+    ROTATE = 6,
+    SPEED = 7,
+    ACCELERATE = 8,
+    SPAWN = 9,
+    END = 10
+};
+
+struct BulletInstruction
+{
+    BulletOp op;
+    // FIRE: 1 if 'b' holds a speed
+    std::uint8_t flags{ 0 };
+    // REPEAT: count, 0 is forever. LOOP: first instruction of the body. SPAWN: routine
+    std::uint32_t target{ 0 };
+    float a{ 0.0f }, b{ 0.0f };
+};
+
+// stable routine id used by the level's phase records. never 0, that means no script
+inline std::uint32_t bulletRoutineId(const std::string& name)
+{
+    std::uint32_t hash = 2166136261u;
+    for (char c : name)
+    {
+        hash = (hash ^ (std::uint8_t)c) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+class BulletScript
+{
+public:
+    static const int maxDepth = 4;
+
+    std::vector<BulletInstruction> code;
+    std::vector<std::uint32_t> routineIds;
+    std::vector<std::uint32_t> routineEntries;
+    std::string error;
+
+    // routine index for an id, -1 if the script has none
+    int find(std::uint32_t id) const
+    {
+        std::vector<std::uint32_t>::const_iterator it = std::find(this->routineIds.begin(), this->routineIds.end(), id);
+        return it == this->routineIds.end() ? -1 : (int)(it - this->routineIds.begin());
+    }
+
+    bool compile(std::istream& input)
+    {
+        this->code.clear();
+        this->routineIds.clear();
+        this->routineEntries.clear();
+        this->error.clear();
+
+        // spawns can name routines further down, they're patched at the end
+        struct PendingSpawn
+        {
+            std::size_t instruction;
+            std::string name;
+            int line;
+        };
+        std::vector<PendingSpawn> spawns;
+        // open repeats, the index of their REPEAT instruction
+        std::vector<std::uint32_t> open;
+        bool inRoutine = false;
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(input, line))
+        {
+            lineNumber++;
+            std::size_t comment = line.find('#');
+            if (comment != std::string::npos)
+            {
+                line.erase(comment);
+            }
+            std::istringstream tokens(line);
+            std::string keyword;
+            if (!(tokens >> keyword))
+            {
+                continue;
+            }
+
+            if (keyword == "emitter")
+            {
+                std::string name;
+                if (inRoutine)
+                {
+                    return this->fail(lineNumber, "emitter inside emitter");
+                }
+                if (!(tokens >> name))
+                {
+                    return this->fail(lineNumber, "emitter needs a name");
+                }
+                if (this->find(bulletRoutineId(name)) >= 0)
+                {
+                    return this->fail(lineNumber, "emitter " + name + " defined twice");
+                }
+                this->routineIds.push_back(bulletRoutineId(name));
+                this->routineEntries.push_back((std::uint32_t)this->code.size());
+                inRoutine = true;
+                continue;
+            }
+            if (!inRoutine)
+            {
+                return this->fail(lineNumber, "'" + keyword + "' outside of an emitter");
+            }
+
+            BulletInstruction instruction{};
+            if (keyword == "fire")
+            {
+                instruction.op = BulletOp::FIRE;
+                if (tokens >> instruction.a && tokens >> instruction.b)
+                {
+                    instruction.flags = 1;
+                }
+            }
+            else if (keyword == "wait")
+            {
+                instruction.op = BulletOp::WAIT;
+                if (!(tokens >> instruction.a) || instruction.a < 0.0f)
+                {
+                    return this->fail(lineNumber, "wait needs a time in seconds");
+                }
+            }
+            else if (keyword == "repeat")
+            {
+                std::string count;
+                tokens >> count;
+                instruction.op = BulletOp::REPEAT;
+                if (count != "forever")
+                {
+                    int n = std::atoi(count.c_str());
+                    if (n <= 0)
+                    {
+                        return this->fail(lineNumber, "repeat needs a count or 'forever'");
+                    }
+                    instruction.target = (std::uint32_t)n;
+                }
+                if ((int)open.size() >= maxDepth)
+                {
+                    return this->fail(lineNumber, "repeats nested more than " + std::to_string(maxDepth) + " deep");
+                }
+                open.push_back((std::uint32_t)this->code.size());
+            }
+            else if (keyword == "end")
+            {
+                if (open.empty())
+                {
+                    instruction.op = BulletOp::END;
+                    inRoutine = false;
+                }
+                else
+                {
+                    instruction.op = BulletOp::LOOP;
+                    instruction.target = open.back() + 1;
+                    open.pop_back();
+                }
+            }
+            else if (keyword == "aim")
+            {
+                instruction.op = BulletOp::AIM;
+                tokens >> instruction.a;
+            }
+            else if (keyword == "direction" || keyword == "rotate" || keyword == "speed" || keyword == "accelerate")
+            {
+                instruction.op = keyword == "direction" ? BulletOp::DIRECTION
+                    : keyword == "rotate" ? BulletOp::ROTATE
+                    : keyword == "speed" ? BulletOp::SPEED
+                    : BulletOp::ACCELERATE;
+                if (!(tokens >> instruction.a))
+                {
+                    return this->fail(lineNumber, keyword + " needs a value");
+                }
+            }
+            else if (keyword == "spawn")
+            {
+                std::string name;
+                if (!(tokens >> name))
+                {
+                    return this->fail(lineNumber, "spawn needs an emitter name");
+                }
+                instruction.op = BulletOp::SPAWN;
+                tokens >> instruction.a;
+                spawns.push_back({ this->code.size(), name, lineNumber });
+            }
+            else
+            {
+                return this->fail(lineNumber, "unknown keyword " + keyword);
+            }
+            this->code.push_back(instruction);
+        }
+        if (inRoutine)
+        {
+            return this->fail(lineNumber, "missing 'end'");
+        }
+        for (const PendingSpawn& spawn : spawns)
+        {
+            int routine = this->find(bulletRoutineId(spawn.name));
+            if (routine < 0)
+            {
+                return this->fail(spawn.line, "unknown emitter " + spawn.name);
+            }
+            this->code[spawn.instruction].target = (std::uint32_t)routine;
+        }
+        return true;
+    }
+
+private:
+    bool fail(int line, const std::string& message)
+    {
+        this->error = "line " + std::to_string(line) + ": " + message;
+        return false;
+    }
+};
+
+// one running routine. 'owner' pins it to an entity, otherwise it moves on its own
+struct BulletEmitter
+{
+    Entity owner;
+    bool owned{ false };
+    sf::Vector2f position, velocity;
+    std::uint32_t pc{ 0 };
+    float wait{ 0.0f };
+    // registers
+    float direction{ 0.0f }, speed{ 200.0f }, acceleration{ 0.0f };
+    int depth{ 0 };
+    std::uint32_t counters[BulletScript::maxDepth]{};
+};
+
+// runs every emitter of a match. the host is whatever owns the bullets (the Simulation),
+// passed at compile time so the calls inline:
+//   bool ownerPosition(Entity owner, sf::Vector2f& position)   false once the owner is gone
+//   sf::Vector2f aimTarget(sf::Vector2f from)
+//   bool inside(sf::Vector2f position)                          free emitters die outside
+//   void fire(sf::Vector2f position, sf::Vector2f velocity, sf::Vector2f acceleration)
+class BulletVM
+{
+public:
+    static const std::size_t maxEmitters = 4096;
+    // an emitter that loops without waiting yields after this many instructions
+    static const int instructionBudget = 64;
+
+    const BulletScript* script{ nullptr };
+    std::vector<BulletEmitter> emitters;
+
+    void clear()
+    {
+        this->emitters.clear();
+    }
+
+    bool start(int routine, Entity owner, sf::Vector2f position)
+    {
+        if (!this->script || routine < 0 || this->emitters.size() >= maxEmitters)
+        {
+            return false;
+        }
+        // reserved once, by the first boss that gets scripted. spawns never reallocate
+        this->emitters.reserve(maxEmitters);
+        BulletEmitter emitter;
+        emitter.owner = owner;
+        emitter.owned = true;
+        emitter.position = position;
+        emitter.pc = this->script->routineEntries[routine];
+        this->emitters.push_back(emitter);
+        return true;
+    }
+
+    void stopOwnedBy(Entity owner)
+    {
+        this->emitters.erase(std::remove_if(this->emitters.begin(), this->emitters.end(), [owner](const BulletEmitter& emitter)
+            {
+                return emitter.owned && emitter.owner == owner;
+            }), this->emitters.end());
+    }
+
+    // returns the number of bullets fired
+    template <typename Host>
+    std::size_t update(float dt, Host& host)
+    {
+        std::size_t fired = 0;
+        // children spawned this tick are appended and start running next tick
+        std::size_t count = this->emitters.size();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            fired += this->run(i, dt, host);
+        }
+        // drop the finished ones, keeping the order so runs stay deterministic
+        this->emitters.erase(std::remove_if(this->emitters.begin(), this->emitters.end(), [](const BulletEmitter& emitter)
+            {
+                return emitter.pc == deadPc;
+            }), this->emitters.end());
+        return fired;
+    }
+
+private:
+    static const std::uint32_t deadPc = 0xFFFFFFFF;
+
+    static sf::Vector2f heading(float degrees)
+    {
+        float radians = degrees * 0.017453292f;
+        return { std::sin(radians), std::cos(radians) };
+    }
+
+    template <typename Host>
+    std::size_t run(std::size_t index, float dt, Host& host)
+    {
+        BulletEmitter& emitter = this->emitters[index];
+        if (emitter.owned)
+        {
+            if (!host.ownerPosition(emitter.owner, emitter.position))
+            {
+                emitter.pc = deadPc;
+                return 0;
+            }
+        }
+        else
+        {
+            emitter.position += emitter.velocity * dt;
+            if (!host.inside(emitter.position))
+            {
+                emitter.pc = deadPc;
+                return 0;
+            }
+        }
+        emitter.wait -= dt;
+        if (emitter.wait > 0.0f)
+        {
+            return 0;
+        }
+
+        std::size_t fired = 0;
+        const BulletInstruction* code = this->script->code.data();
+        for (int budget = 0; budget < instructionBudget; budget++)
+        {
+            const BulletInstruction& instruction = code[emitter.pc];
+            switch (instruction.op)
+            {
+            case BulletOp::FIRE:
+            {
+                sf::Vector2f direction = heading(emitter.direction + instruction.a);
+                float speed = instruction.flags ? instruction.b : emitter.speed;
+                host.fire(emitter.position, direction * speed, direction * emitter.acceleration);
+                fired++;
+                emitter.pc++;
+                break;
+            }
+            case BulletOp::WAIT:
+                emitter.pc++;
+                // keep the remainder, so waits don't drift with the tick length
+                emitter.wait += instruction.a;
+                if (emitter.wait > 0.0f)
+                {
+                    return fired;
+                }
+                break;
+            case BulletOp::REPEAT:
+                emitter.counters[emitter.depth++] = instruction.target;
+                emitter.pc++;
+                break;
+            case BulletOp::LOOP:
+            {
+                std::uint32_t& counter = emitter.counters[emitter.depth - 1];
+                if (counter == 0 || --counter > 0)
+                {
+                    emitter.pc = instruction.target;
+                }
+                else
+                {
+                    emitter.depth--;
+                    emitter.pc++;
+                }
+                break;
+            }
+            case BulletOp::AIM:
+            {
+                sf::Vector2f to = host.aimTarget(emitter.position) - emitter.position;
+                emitter.direction = std::atan2(to.x, to.y) * 57.29578f + instruction.a;
+                emitter.pc++;
+                break;
+            }
+            case BulletOp::DIRECTION:
+                emitter.direction = instruction.a;
+                emitter.pc++;
+                break;
+            case BulletOp::ROTATE:
+                emitter.direction = std::fmod(emitter.direction + instruction.a, 360.0f);
+                emitter.pc++;
+                break;
+            case BulletOp::SPEED:
+                emitter.speed = instruction.a;
+                emitter.pc++;
+                break;
+            case BulletOp::ACCELERATE:
+                emitter.acceleration = instruction.a;
+                emitter.pc++;
+                break;
+            case BulletOp::SPAWN:
+            {
+                emitter.pc++;
+                if (this->emitters.size() < maxEmitters)
+                {
+                    BulletEmitter child;
+                    child.owner = emitter.owner;
+                    child.owned = emitter.owned && instruction.a == 0.0f;
+                    child.position = emitter.position;
+                    child.velocity = heading(emitter.direction) * instruction.a;
+                    child.direction = emitter.direction;
+                    child.speed = emitter.speed;
+                    child.acceleration = emitter.acceleration;
+                    child.pc = this->script->routineEntries[instruction.target];
+                    // capacity is reserved, the reference stays valid
+                    this->emitters.push_back(child);
+                }
+                break;
+            }
+            case BulletOp::END:
+                emitter.pc = deadPc;
+                return fired;
+            }
+        }
+        // out of budget without waiting: pick up next tick, with no time banked
+        emitter.wait = 0.0f;
+        return fired;
+    }
+};
+
+// --bench-bullets: 'emitters' emitters running a spiral with a ring spawning child every
+// second, against a host that only counts bullets. measures the interpreter alone
+inline void benchmarkBulletVM(int emitters, int ticks)
+{
+    std::istringstream text(
+        "emitter spiral\n"
+        "  speed 200\n"
+        "  repeat forever\n"
+        "    repeat 4\n"
+        "      fire\n"
+        "      rotate 90\n"
+        "    end\n"
+        "    rotate 7\n"
+        "    wait 0.05\n"
+        "  end\n"
+        "end\n"
+        "emitter parent\n"
+        "  repeat forever\n"
+        "    spawn ring 100\n"
+        "    wait 1\n"
+        "  end\n"
+        "end\n"
+        "emitter ring\n"
+        "  wait 0.5\n"
+        "  repeat 12\n"
+        "    fire\n"
+        "    rotate 30\n"
+        "  end\n"
+        "end\n");
+    BulletScript script;
+    if (!script.compile(text))
+    {
+        std::cout << "bullet script: " << script.error << std::endl;
+        return;
+    }
+    struct CountingHost
+    {
+        std::size_t bullets{ 0 };
+        bool ownerPosition(Entity owner, sf::Vector2f& position) { return true; }
+        sf::Vector2f aimTarget(sf::Vector2f from) { return { 800.0f, 750.0f }; }
+        bool inside(sf::Vector2f position) { return position.y < 800.0f; }
+        void fire(sf::Vector2f position, sf::Vector2f velocity, sf::Vector2f acceleration) { this->bullets++; }
+    } host;
+
+    BulletVM vm;
+    vm.script = &script;
+    int spiral = script.find(bulletRoutineId("spiral")), parent = script.find(bulletRoutineId("parent"));
+    for (int i = 0; i < emitters; i++)
+    {
+        vm.start(i % 8 == 0 ? parent : spiral, Entity{ (std::uint32_t)i, 0 }, { 100.0f + i % 1400, 100.0f });
+    }
+    std::size_t updates = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ticks; i++)
+    {
+        updates += vm.emitters.size();
+        vm.update(1.0f / 60.0f, host);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "emitters: " << emitters << " (" << vm.emitters.size() << " with children), ticks: " << ticks << ", " << ms / ticks << " ms per tick" << std::endl;
+    std::cout << updates / ms << " emitter updates per ms, " << host.bullets / ms << " bullets per ms" << std::endl;
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <SFML/System/Vector2.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// =================================
+// COLLISION MASKS
+// =================================
+
+// one bit per texel, set where the texture is opaque, packed into 64 bit words row by row.
+// projectiles first pass the rectangle test against the ship bounds; only then their swept
+// segment is walked through the mask one texel row at a time, widened to the projectile's
+// width. each row costs a couple of word ANDs, so the precise test is a small constant
+// factor on top of the rectangle test.
+
+struct CollisionMask
+{
+    int width{ 0 };
+    int height{ 0 };
+    int words{ 0 }; // words per row
+    std::vector<std::uint64_t> bits;
+
+    bool empty() const
+    {
+        return this->width == 0 || this->height == 0;
+    }
+
+    // rgba: width * height pixels, 4 bytes each, alpha last (sf::Image layout)
+    static CollisionMask fromAlpha(const std::uint8_t* rgba, int width, int height, std::uint8_t threshold = 128)
+    {
+        CollisionMask mask;
+        mask.width = width;
+        mask.height = height;
+        mask.words = (width + 63) / 64;
+        mask.bits.assign((std::size_t)mask.words * height, 0);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                if (rgba[((std::size_t)y * width + x) * 4 + 3] >= threshold)
+                {
+                    mask.bits[(std::size_t)y * mask.words + x / 64] |= 1ull << (x % 64);
+                }
+            }
+        }
+        return mask;
+    }
+
+    bool test(int x, int y) const
+    {
+        return x >= 0 && x < this->width && y >= 0 && y < this->height
+            && (this->bits[(std::size_t)y * this->words + x / 64] >> (x % 64)) & 1;
+    }
+
+    // any set bit in columns [c0, c1] of row y
+    bool testSpan(int y, int c0, int c1) const
+    {
+        const std::uint64_t* row = &this->bits[(std::size_t)y * this->words];
+        for (int w = c0 / 64; w <= c1 / 64; w++)
+        {
+            int lo = std::max(c0 - w * 64, 0);
+            int hi = std::min(c1 - w * 64, 63);
+            std::uint64_t span = (~0ull >> (63 - (hi - lo))) << lo;
+            if (row[w] & span)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the segment a->b in texel coordinates, 'halfWidth' texels wide on each side of it.
+    // rows are visited in the direction of travel; on a hit 't' is where the segment
+    // enters the first row with an overlap
+    bool sweep(sf::Vector2f a, sf::Vector2f b, float halfWidth, float& t) const
+    {
+        float dy = b.y - a.y;
+        float top = std::min(a.y, b.y), bottom = std::max(a.y, b.y);
+        int first = std::max(0, (int)std::floor(top));
+        int last = std::min(this->height - 1, (int)std::floor(bottom));
+        if (first > last)
+        {
+            return false;
+        }
+        // x moves by dxdy per texel row; horizontal segments stay in their one row
+        float dxdy = std::fabs(dy) > 1e-6f ? (b.x - a.x) / dy : 0.0f;
+        int step = dy < 0.0f ? -1 : 1;
+        int y = step > 0 ? first : last;
+        for (int rows = last - first + 1; rows > 0; rows--, y += step)
+        {
+            // part of the segment inside this row
+            float enter = std::max((float)y, top), leave = std::min((float)(y + 1), bottom);
+            float x0 = a.x + (enter - a.y) * dxdy, x1 = a.x + (leave - a.y) * dxdy;
+            if (dxdy == 0.0f)
+            {
+                x0 = std::min(a.x, b.x);
+                x1 = std::max(a.x, b.x);
+            }
+            int c0 = std::max(0, (int)std::floor(std::min(x0, x1) - halfWidth));
+            int c1 = std::min(this->width - 1, (int)std::floor(std::max(x0, x1) + halfWidth));
+            if (c0 <= c1 && this->testSpan(y, c0, c1))
+            {
+                t = std::fabs(dy) > 1e-6f ? ((step > 0 ? enter : leave) - a.y) / dy : 0.0f;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // same sweep with world coordinates; the mask is stretched over 'bounds'
+    bool sweep(const sf::FloatRect& bounds, sf::Vector2f a, sf::Vector2f b, float halfWidth, float& t) const
+    {
+        sf::Vector2f scale(this->width / bounds.width, this->height / bounds.height);
+        sf::Vector2f origin(bounds.left, bounds.top);
+        sf::Vector2f ta((a.x - origin.x) * scale.x, (a.y - origin.y) * scale.y);
+        sf::Vector2f tb((b.x - origin.x) * scale.x, (b.y - origin.y) * scale.y);
+        return this->sweep(ta, tb, halfWidth * scale.x, t);
+    }
+};
+
+// masks by TextureId; textures without a mask collide with their whole rectangle
+struct CollisionMasks
+{
+    std::vector<CollisionMask> byTexture;
+
+    const CollisionMask* get(int texture) const
+    {
+        if (texture < 0 || texture >= (int)this->byTexture.size() || this->byTexture[texture].empty())
+        {
+            return nullptr;
+        }
+        return &this->byTexture[texture];
+    }
+};
+
+// --bench-collision: shots against a formation of ships, rectangle test alone and then
+// with the mask behind it. only shots that pass the rectangle pay for the mask
+inline void benchmarkCollision(const CollisionMask& mask, int projectiles, int rounds)
+{
+    std::vector<sf::FloatRect> ships;
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 10; column++)
+        {
+            ships.push_back({ 300.0f + column * 100.0f, 100.0f + row * 80.0f, 50.0f, 50.0f });
+        }
+    }
+    std::vector<sf::Vector2f> from(projectiles), to(projectiles);
+    std::uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto random = [&state]()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (float)((state * 0x2545F4914F6CDD1Dull) >> 40) / (float)(1 << 24);
+    };
+    for (int i = 0; i < projectiles; i++)
+    {
+        from[i] = { 300.0f + random() * 1000.0f, 100.0f + random() * 400.0f };
+        to[i] = from[i] + sf::Vector2f(0.0f, -12.0f);
+    }
+
+    // the simulation's slab test, inlined for the straight up shots used here
+    auto rectangleHit = [](const sf::FloatRect& box, sf::Vector2f a, sf::Vector2f b)
+    {
+        return a.x >= box.left && a.x <= box.left + box.width && b.y <= box.top + box.height && a.y >= box.top;
+    };
+
+    for (int precise = 0; precise < 2; precise++)
+    {
+        std::size_t hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (int i = 0; i < projectiles; i++)
+            {
+                for (std::size_t j = 0; j < ships.size(); j++)
+                {
+                    float t;
+                    if (rectangleHit(ships[j], from[i], to[i]) && (!precise || mask.sweep(ships[j], from[i], to[i], 1.0f, t)))
+                    {
+                        hits++;
+                        break;
+                    }
+                }
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << (precise ? "mask: " : "rectangle: ") << seconds / ((double)projectiles * rounds) * 1e9 << " ns/shot against " << ships.size() << " ships, " << hits / rounds << " hits" << std::endl;
+    }
+}
@@ -0,0 +1,289 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+
+// =================================
+// ENTITY COMPONENT SYSTEM
+// =================================
+
+// an entity is just a handle: a slot index plus the generation of that slot.
+// destroying an entity bumps the generation, so stale handles stop matching.
+struct Entity
+{
+    std::uint32_t index{ 0xFFFFFFFF };
+    std::uint32_t generation{ 0 };
+
+    bool operator==(const Entity& e) const
+    {
+        return this->index == e.index && this->generation == e.generation;
+    }
+
+    bool operator!=(const Entity& e) const
+    {
+        return !(*this == e);
+    }
+};
+const Entity nullEntity;
+
+// every component type gets a small sequential id, used to index the pool list.
+// atomic because worlds on different threads can meet a type for the first time together
+inline std::size_t nextComponentTypeId()
+{
+    static std::atomic<std::size_t> counter{ 0 };
+    return counter++;
+}
+
+template <typename T>
+std::size_t componentTypeId()
+{
+    static const std::size_t id = nextComponentTypeId();
+    return id;
+}
+
+class IComponentPool
+{
+public:
+    virtual void remove(Entity e) = 0;
+    virtual void clear() = 0;
+    virtual ~IComponentPool() = default;
+};
+
+// sparse set: 'sparse' maps an entity index to a slot in the packed arrays,
+// 'entities' and 'components' are the packed arrays systems iterate over
+template <typename T>
+class ComponentPool : public IComponentPool
+{
+public:
+    static constexpr std::uint32_t npos = 0xFFFFFFFF;
+
+    std::vector<std::uint32_t> sparse;
+    std::vector<Entity> entities;
+    std::vector<T> components;
+
+    std::size_t size() const
+    {
+        return this->components.size();
+    }
+
+    bool has(Entity e) const
+    {
+        return e.index < this->sparse.size()
+            && this->sparse[e.index] != npos
+            && this->entities[this->sparse[e.index]] == e;
+    }
+
+    T& add(Entity e, const T& component)
+    {
+        if (this->has(e))
+        {
+            T& existing = this->components[this->sparse[e.index]];
+            existing = component;
+            return existing;
+        }
+        if (e.index >= this->sparse.size())
+        {
+            this->sparse.resize(e.index + 1, npos);
+        }
+        this->sparse[e.index] = (std::uint32_t)this->components.size();
+        this->entities.push_back(e);
+        this->components.push_back(component);
+        return this->components.back();
+    }
+
+    T& get(Entity e)
+    {
+        return this->components[this->sparse[e.index]];
+    }
+
+    T* tryGet(Entity e)
+    {
+        if (!this->has(e))
+        {
+            return nullptr;
+        }
+        return &this->components[this->sparse[e.index]];
+    }
+
+    // swap the last element into the hole so the arrays stay packed
+    void remove(Entity e) override
+    {
+        if (!this->has(e))
+        {
+            return;
+        }
+        std::uint32_t slot = this->sparse[e.index];
+        std::uint32_t last = (std::uint32_t)this->components.size() - 1;
+        if (slot != last)
+        {
+            this->components[slot] = std::move(this->components[last]);
+            this->entities[slot] = this->entities[last];
+            this->sparse[this->entities[slot].index] = slot;
+        }
+        this->components.pop_back();
+        this->entities.pop_back();
+        this->sparse[e.index] = npos;
+    }
+
+    void clear() override
+    {
+        this->sparse.clear();
+        this->entities.clear();
+        this->components.clear();
+    }
+};
+
+class World
+{
+public:
+    std::vector<std::uint32_t> generations;
+    std::vector<std::uint32_t> freeIndexes;
+    std::vector<std::unique_ptr<IComponentPool>> pools;
+    std::vector<Entity> pendingDestroy;
+    std::size_t aliveCount{ 0 };
+
+    Entity create()
+    {
+        Entity e;
+        if (!this->freeIndexes.empty())
+        {
+            e.index = this->freeIndexes.back();
+            this->freeIndexes.pop_back();
+        }
+        else
+        {
+            e.index = (std::uint32_t)this->generations.size();
+            this->generations.push_back(0);
+        }
+        e.generation = this->generations[e.index];
+        this->aliveCount++;
+        return e;
+    }
+
+    bool alive(Entity e) const
+    {
+        return e.index < this->generations.size() && this->generations[e.index] == e.generation;
+    }
+
+    void destroy(Entity e)
+    {
+        if (!this->alive(e))
+        {
+            return;
+        }
+        for (int i = 0; i < this->pools.size(); i++)
+        {
+            if (this->pools[i])
+            {
+                this->pools[i]->remove(e);
+            }
+        }
+        this->generations[e.index]++;
+        this->freeIndexes.push_back(e.index);
+        this->aliveCount--;
+    }
+
+    // removing from a pool while a system walks it would skip elements,
+    // so systems queue their kills and the game loop flushes between systems
+    void destroyLater(Entity e)
+    {
+        this->pendingDestroy.push_back(e);
+    }
+
+    void flush()
+    {
+        for (int i = 0; i < this->pendingDestroy.size(); i++)
+        {
+            this->destroy(this->pendingDestroy[i]);
+        }
+        this->pendingDestroy.clear();
+    }
+
+    // drops every entity but keeps the pools (and their capacity) around
+    void clear()
+    {
+        for (int i = 0; i < this->pools.size(); i++)
+        {
+            if (this->pools[i])
+            {
+                this->pools[i]->clear();
+            }
+        }
+        this->freeIndexes.clear();
+        for (std::uint32_t i = 0; i < this->generations.size(); i++)
+        {
+            this->generations[i]++;
+            this->freeIndexes.push_back((std::uint32_t)this->generations.size() - 1 - i);
+        }
+        this->pendingDestroy.clear();
+        this->aliveCount = 0;
+    }
+
+    template <typename T>
+    ComponentPool<T>& pool()
+    {
+        std::size_t id = componentTypeId<T>();
+        if (id >= this->pools.size())
+        {
+            this->pools.resize(id + 1);
+        }
+        if (!this->pools[id])
+        {
+            this->pools[id] = std::make_unique<ComponentPool<T>>();
+        }
+        return *static_cast<ComponentPool<T>*>(this->pools[id].get());
+    }
+
+    template <typename T>
+    T& add(Entity e, const T& component)
+    {
+        return this->pool<T>().add(e, component);
+    }
+
+    template <typename T>
+    T& get(Entity e)
+    {
+        return this->pool<T>().get(e);
+    }
+
+    template <typename T>
+    T* tryGet(Entity e)
+    {
+        return this->pool<T>().tryGet(e);
+    }
+
+    template <typename T>
+    bool has(Entity e)
+    {
+        return this->pool<T>().has(e);
+    }
+
+    template <typename T>
+    void remove(Entity e)
+    {
+        this->pool<T>().remove(e);
+    }
+
+    template <typename T>
+    std::size_t count()
+    {
+        return this->pool<T>().size();
+    }
+
+    // walks the packed array of the first component type and hands the callback
+    // every entity that also has all the other types. put the rarest type first.
+    template <typename T, typename... Others, typename F>
+    void each(F&& f)
+    {
+        ComponentPool<T>& first = this->pool<T>();
+        for (std::size_t i = 0; i < first.size(); i++)
+        {
+            Entity e = first.entities[i];
+            if ((this->pool<Others>().has(e) && ...))
+            {
+                f(e, first.components[i], this->pool<Others>().get(e)...);
+            }
+        }
+    }
+};
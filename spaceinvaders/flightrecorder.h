@@ -0,0 +1,596 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <cstdio>
+#include <exception>
+#include <utility>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include "simulation.h"
+#include "render.h"
+#include "telemetry.h"
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// =================================
+// FLIGHT RECORDER
+// =================================
+
+// always on, for the hitches nobody can reproduce. the last few seconds of frames sit in a
+// ring: their phase times and entity counts (taken from the telemetry records as they are
+// made), the inputs of their last step and, every checksumTicks ticks, a checksum of the
+// match. when a frame runs over the threshold, when F6 is pressed or when the game crashes,
+// the ring goes to a file together with the match it belongs to.
+//
+// the match can't be copied mid flight (its level script is a suspended coroutine), but it
+// is deterministic, so its snapshot is the seed it started from and every step since: a few
+// bytes a tick, kept in storage reserved when the first match starts. replaying the steps
+// rebuilds the world exactly as it was at any frame of the window, and the checksums say
+// whether it did:
+//   spaceinvaders --replay-flight flight_1700000000_spike.sifr [repeat]
+// steps through the window headless and prints what each frame cost then and costs now;
+// 'repeat' runs the window that many more times for a profiler to sample.
+//
+// a crash can come from inside malloc or with the allocation tracker's lock held, so the
+// crash dump touches no heap, iostreams or locks: its file is opened when the recorder is
+// installed (and removed again if nothing crashed) and the handler only write()s the ring
+// and the step storage that are already there.
+
+const char flightMagic[4] = { 'S', 'I', 'F', 'R' };
+const std::uint32_t flightVersion = 1;
+
+enum class FlightDumpReason : std::uint32_t
+{
+    SPIKE = 0,
+    HOTKEY = 1,
+    CRASH = 2
+};
+
+inline const char* flightDumpReasonName(FlightDumpReason reason)
+{
+    static const char* names[] = { "spike", "hotkey", "crash" };
+    return names[(int)reason];
+}
+
+struct FlightFrame
+{
+    std::uint64_t time;                 // telemetry clock at the end of the frame
+    std::uint32_t phases[6];            // FRAME..PHASE_SUBMIT, nanoseconds
+    std::uint32_t entities;
+    std::uint32_t state;                // navigation state the frame ended in
+    std::uint32_t match;                // which match its steps belong to
+    std::uint32_t steps;                // steps of that match taken by the end of the frame
+    std::uint32_t actions[maxPlayers];  // inputs of the frame's last step
+    std::uint16_t counters[4];          // shots, hits, kills, powerups
+    std::uint32_t checksumStep;         // the step the checksum was taken after, 0 for none
+    std::uint64_t checksum;
+};
+
+struct FlightStep
+{
+    std::uint32_t actions[maxPlayers];
+    float dt;
+    std::uint32_t cheats; // applied before the step
+};
+
+// the debug keys change the match behind the inputs' back, so the steps carry them too
+enum FlightCheat : std::uint32_t
+{
+    CHEAT_POWERUPS = 1,   // F2, shield and fire for the first player
+    CHEAT_CLEAR_WAVES = 2 // backspace, straight to victory
+};
+
+inline void applyCheats(Simulation& sim, std::uint32_t cheats)
+{
+    if (cheats & CHEAT_POWERUPS)
+    {
+        sim.world.get<Player>(sim.players[0]).powerupShield = true;
+        sim.world.get<Player>(sim.players[0]).powerupFire = true;
+    }
+    if (cheats & CHEAT_CLEAR_WAVES)
+    {
+        sim.clearAllWaves();
+    }
+}
+
+struct FlightHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t frameSize, stepSize;
+    std::uint32_t frameCount, stepCount;
+    std::uint32_t reason;
+    std::uint32_t thresholdNs;
+    // the match the steps replay
+    std::uint64_t seed;
+    std::uint32_t match;
+    std::uint32_t playerCount;
+    float minx, maxx, miny, maxy;
+    std::uint32_t masks;     // the match hit ships by their texels
+    std::uint32_t truncated; // ran out of step storage, the steps stop early
+    std::uint64_t startTime; // system clock when the match started, nanoseconds since the epoch
+};
+
+class FlightRecorder
+{
+public:
+    // frames kept, about ten seconds at 60 fps
+    static constexpr std::size_t frameCapacity = 600;
+    // steps kept for one match, half an hour at 60 ticks per second
+    static constexpr std::size_t stepCapacity = 60 * 60 * 30;
+
+    // frames that take longer than this are dumped, 0 turns the automatic dumps off
+    float thresholdSeconds{ 0.1f };
+    // automatic dumps wait this long after the last one, a slow patch makes one file
+    float cooldownSeconds{ 5.0f };
+    int maxDumps{ 10 };
+    std::uint32_t checksumTicks{ 30 };
+
+    // takes --spike-ms <milliseconds> from anywhere on the command line, like the pacer's
+    // options. returns the new argc
+    int configure(int argc, char** argv)
+    {
+        int kept = 1;
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--spike-ms" && i + 1 < argc)
+            {
+                this->thresholdSeconds = (float)std::atof(argv[++i]) / 1000.0f;
+            }
+            else
+            {
+                argv[kept++] = argv[i];
+            }
+        }
+        return kept;
+    }
+
+    ~FlightRecorder()
+    {
+        this->discardCrashFile();
+    }
+
+    // starts listening to the telemetry records of this thread and dumps on a crash
+    void install()
+    {
+        this->frames.assign(frameCapacity, FlightFrame());
+        telemetry.setTap(&FlightRecorder::tap, this);
+        this->openCrashFile();
+        crashRecorder() = this;
+        for (int signal : { SIGSEGV, SIGABRT, SIGFPE, SIGILL })
+        {
+            std::signal(signal, &FlightRecorder::onSignal);
+        }
+        std::set_terminate(&FlightRecorder::onTerminate);
+    }
+
+    void uninstall()
+    {
+        telemetry.setTap(nullptr, nullptr);
+        crashRecorder() = nullptr;
+        this->discardCrashFile();
+    }
+
+    // a new match: from here on its steps are the snapshot
+    void beginMatch(std::uint64_t seed, const Simulation& sim)
+    {
+        if (this->steps.capacity() < stepCapacity)
+        {
+            this->steps.reserve(stepCapacity);
+        }
+        this->steps.clear();
+        this->truncated = false;
+        this->cheats = 0;
+        this->seed = seed;
+        this->match++;
+        this->playerCount = sim.playerCount;
+        this->arena = sim.arena;
+        this->masks = sim.masks != nullptr;
+        this->matchStart = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // cheats applied to the match, they go with the next step
+    void cheat(std::uint32_t cheats)
+    {
+        this->cheats |= cheats;
+    }
+
+    // after every simulation step
+    void recordStep(const std::uint32_t* actions, float dt, Simulation& sim)
+    {
+        FlightStep step{};
+        std::copy(actions, actions + sim.playerCount, step.actions);
+        step.dt = dt;
+        step.cheats = std::exchange(this->cheats, 0u);
+        std::copy(std::begin(step.actions), std::end(step.actions), this->current.actions);
+        if (this->steps.size() == stepCapacity)
+        {
+            this->truncated = true;
+            return;
+        }
+        this->steps.push_back(step);
+        if (sim.tick % this->checksumTicks == 0)
+        {
+            this->current.checksumStep = (std::uint32_t)this->steps.size();
+            this->current.checksum = sim.checksum();
+        }
+    }
+
+    void requestDump()
+    {
+        this->dumpRequested = true;
+    }
+
+    // once per frame, after its FRAME duration went to telemetry. 'playing' is a frame of
+    // the running game; a spike only counts between two of those, a paused frame that slept
+    // on the event queue is not one
+    void endFrame(std::uint32_t state, bool playing)
+    {
+        if (this->frames.empty())
+        {
+            return;
+        }
+        this->current.time = telemetry.now();
+        this->current.state = state;
+        this->current.match = this->match;
+        this->current.steps = (std::uint32_t)this->steps.size();
+        this->frames[this->next] = this->current;
+        this->next = (this->next + 1) % frameCapacity;
+        this->count = std::min(this->count + 1, frameCapacity);
+
+        double frameSeconds = this->current.phases[0] / 1e9;
+        double sinceDump = (this->current.time - this->lastDump) / 1e9;
+        bool spike = this->thresholdSeconds > 0.0f && playing && this->lastPlaying
+            && frameSeconds > this->thresholdSeconds && (this->dumps == 0 || sinceDump > this->cooldownSeconds) && this->dumps < this->maxDumps;
+        this->lastPlaying = playing;
+        this->current = FlightFrame();
+        if (spike || this->dumpRequested)
+        {
+            this->dumpRequested = false;
+            this->dump(spike ? FlightDumpReason::SPIKE : FlightDumpReason::HOTKEY);
+        }
+    }
+
+    // writes the ring, oldest frame first, and the match steps. returns the file name.
+    // spikes and the hotkey only, crashes go through dumpCrash
+    std::string dump(FlightDumpReason reason)
+    {
+        std::string filename = "flight_" + std::to_string(this->matchStart / 1000000000ull) + "_" + std::to_string(this->dumps) + "_" + flightDumpReasonName(reason) + ".sifr";
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return std::string();
+        }
+        FlightHeader header;
+        this->fillHeader(header, reason);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::size_t first = (this->next + frameCapacity - this->count) % frameCapacity;
+        for (std::size_t i = 0; i < this->count; i++)
+        {
+            file.write(reinterpret_cast<const char*>(&this->frames[(first + i) % frameCapacity]), sizeof(FlightFrame));
+        }
+        file.write(reinterpret_cast<const char*>(this->steps.data()), this->steps.size() * sizeof(FlightStep));
+        this->dumps++;
+        this->lastDump = telemetry.now();
+        std::cout << "flight recorder: " << filename << std::endl;
+        return filename;
+    }
+
+private:
+    std::vector<FlightFrame> frames;
+    std::size_t next{ 0 }, count{ 0 };
+    FlightFrame current{};
+    bool lastPlaying{ false };
+    bool dumpRequested{ false };
+    std::uint32_t cheats{ 0 };
+    int dumps{ 0 };
+    std::uint64_t lastDump{ 0 };
+
+    std::vector<FlightStep> steps;
+    bool truncated{ false };
+    std::uint64_t seed{ 0 };
+    std::uint32_t match{ 0 };
+    int playerCount{ 1 };
+    Config arena;
+    bool masks{ false };
+    std::uint64_t matchStart{ 0 };
+
+    // the crash dump's file, open from install() on, and the line it prints
+    int crashFile{ -1 };
+    char crashFilename[64]{};
+    char crashMessage[96]{};
+    std::size_t crashMessageLength{ 0 };
+
+    void fillHeader(FlightHeader& header, FlightDumpReason reason) const
+    {
+        header = FlightHeader();
+        std::memcpy(header.magic, flightMagic, 4);
+        header.version = flightVersion;
+        header.frameSize = sizeof(FlightFrame);
+        header.stepSize = sizeof(FlightStep);
+        header.frameCount = (std::uint32_t)this->count;
+        header.stepCount = (std::uint32_t)this->steps.size();
+        header.reason = (std::uint32_t)reason;
+        header.thresholdNs = (std::uint32_t)(this->thresholdSeconds * 1e9f);
+        header.seed = this->seed;
+        header.match = this->match;
+        header.playerCount = (std::uint32_t)this->playerCount;
+        header.minx = this->arena.minx;
+        header.maxx = this->arena.maxx;
+        header.miny = this->arena.miny;
+        header.maxy = this->arena.maxy;
+        header.masks = this->masks ? 1 : 0;
+        header.truncated = this->truncated ? 1 : 0;
+        header.startTime = this->matchStart;
+    }
+
+    void openCrashFile()
+    {
+        this->discardCrashFile();
+        std::uint64_t now = (std::uint64_t)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        std::snprintf(this->crashFilename, sizeof(this->crashFilename), "flight_%llu_crash.sifr", (unsigned long long)now);
+        int length = std::snprintf(this->crashMessage, sizeof(this->crashMessage), "flight recorder: %s\n", this->crashFilename);
+        this->crashMessageLength = (std::size_t)std::max(length, 0);
+#if defined(_WIN32)
+        this->crashFile = _open(this->crashFilename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        this->crashFile = ::open(this->crashFilename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    }
+
+    // nothing crashed, the empty file goes
+    void discardCrashFile()
+    {
+        if (this->crashFile < 0)
+        {
+            return;
+        }
+        closeFile(this->crashFile);
+        this->crashFile = -1;
+        std::remove(this->crashFilename);
+    }
+
+    static void closeFile(int file)
+    {
+#if defined(_WIN32)
+        _close(file);
+#else
+        ::close(file);
+#endif
+    }
+
+    static bool writeFile(int file, const void* data, std::size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0)
+        {
+#if defined(_WIN32)
+            int written = _write(file, bytes, (unsigned int)std::min<std::size_t>(size, 1u << 30));
+#else
+            ssize_t written = ::write(file, bytes, size);
+#endif
+            if (written <= 0)
+            {
+                return false;
+            }
+            bytes += written;
+            size -= (std::size_t)written;
+        }
+        return true;
+    }
+
+    // the signal safe dump: the header is filled on the stack, the ring goes out in at most
+    // two pieces and the steps in one, straight from the buffers they live in
+    void dumpCrash()
+    {
+        int file = std::exchange(this->crashFile, -1);
+        if (file < 0)
+        {
+            return;
+        }
+        FlightHeader header;
+        this->fillHeader(header, FlightDumpReason::CRASH);
+        std::size_t first = (this->next + frameCapacity - this->count) % frameCapacity;
+        std::size_t before = std::min(this->count, frameCapacity - first);
+        bool written = writeFile(file, &header, sizeof(header))
+            && writeFile(file, this->frames.data() + first, before * sizeof(FlightFrame))
+            && writeFile(file, this->frames.data(), (this->count - before) * sizeof(FlightFrame))
+            && writeFile(file, this->steps.data(), this->steps.size() * sizeof(FlightStep));
+        closeFile(file);
+        if (written)
+        {
+            writeFile(1, this->crashMessage, this->crashMessageLength);
+        }
+    }
+
+    static void tap(void* context, TelemetryEvent event, std::uint32_t value)
+    {
+        FlightFrame& frame = static_cast<FlightRecorder*>(context)->current;
+        if (telemetryIsDuration(event))
+        {
+            frame.phases[(int)event] += value;
+        }
+        else if (event == TelemetryEvent::ENTITIES)
+        {
+            frame.entities = value;
+        }
+        else if (event >= TelemetryEvent::SHOT && event <= TelemetryEvent::POWERUP)
+        {
+            frame.counters[(int)event - (int)TelemetryEvent::SHOT]++;
+        }
+    }
+
+    static FlightRecorder*& crashRecorder()
+    {
+        static FlightRecorder* recorder = nullptr;
+        return recorder;
+    }
+
+    // best effort: the process is going down and the dump may not finish, but when it does
+    // it holds the frames up to the crash
+    static void onSignal(int signal)
+    {
+        FlightRecorder* recorder = std::exchange(crashRecorder(), nullptr);
+        if (recorder)
+        {
+            recorder->dumpCrash();
+        }
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+
+    static void onTerminate()
+    {
+        FlightRecorder* recorder = std::exchange(crashRecorder(), nullptr);
+        if (recorder)
+        {
+            recorder->dumpCrash();
+        }
+        std::abort();
+    }
+};
+
+// one per process, like telemetry
+inline FlightRecorder flightRecorder;
+
+// -------------------------------
+// offline tool
+// -------------------------------
+
+// --replay-flight file [repeat]
+inline bool replayFlight(const std::string& filename, int repeat)
+{
+    std::ifstream file(filename, std::ios::binary);
+    FlightHeader header;
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, flightMagic, 4) != 0 || header.version != flightVersion
+        || header.frameSize != sizeof(FlightFrame) || header.stepSize != sizeof(FlightStep))
+    {
+        std::cout << "not a flight recording: " << filename << std::endl;
+        return false;
+    }
+    std::vector<FlightFrame> frames(header.frameCount);
+    std::vector<FlightStep> steps(header.stepCount);
+    file.read(reinterpret_cast<char*>(frames.data()), frames.size() * sizeof(FlightFrame));
+    file.read(reinterpret_cast<char*>(steps.data()), steps.size() * sizeof(FlightStep));
+    if (!file)
+    {
+        std::cout << "recording is cut short" << std::endl;
+        return false;
+    }
+    std::cout << flightDumpReasonName((FlightDumpReason)header.reason) << " dump, " << frames.size() << " frames, "
+        << steps.size() << " steps of match " << header.match << " (seed " << header.seed << ", " << header.playerCount << " players)"
+        << (header.truncated ? ", steps truncated" : "") << std::endl;
+
+    // the window is the frames of the recorded match. when it started inside the window
+    // everything replays from the seed, otherwise the first frame is where the replay starts
+    std::size_t firstFrame = 0;
+    while (firstFrame < frames.size() && frames[firstFrame].match != header.match)
+    {
+        firstFrame++;
+    }
+    if (firstFrame == frames.size() || steps.empty())
+    {
+        std::cout << "no match steps in the window, nothing to replay" << std::endl;
+        return true;
+    }
+    std::uint32_t windowStart = 0;
+    if (firstFrame == 0)
+    {
+        windowStart = std::min<std::uint32_t>(frames[0].steps, (std::uint32_t)steps.size());
+        firstFrame = 1;
+    }
+
+    Simulation sim;
+    if (!sim.loadDefaultLevel())
+    {
+        std::cout << "can't load the level" << std::endl;
+        return false;
+    }
+    sim.arena.minx = header.minx;
+    sim.arena.maxx = header.maxx;
+    sim.arena.miny = header.miny;
+    sim.arena.maxy = header.maxy;
+    sim.playerCount = (int)header.playerCount;
+    if (header.masks)
+    {
+        sim.masks = loadCollisionMasks();
+    }
+
+    typedef std::chrono::high_resolution_clock Clock;
+    auto fastForward = [&]()
+        {
+            sim.reset(header.seed);
+            for (std::uint32_t i = 0; i < windowStart; i++)
+            {
+                applyCheats(sim, steps[i].cheats);
+                sim.stepPlayers(steps[i].actions, steps[i].dt);
+            }
+        };
+    Clock::time_point start = Clock::now();
+    fastForward();
+    double forwardMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "fast forward over " << windowStart << " steps: " << forwardMs << " ms" << std::endl;
+
+    std::cout << "frame   recorded ms  sim ms then  sim ms now  entities  steps  checksum" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    int matched = 0, differed = 0;
+    std::uint32_t step = windowStart;
+    for (std::size_t i = firstFrame; i < frames.size(); i++)
+    {
+        const FlightFrame& frame = frames[i];
+        std::uint32_t end = std::min<std::uint32_t>(frame.steps, (std::uint32_t)steps.size());
+        std::uint32_t taken = end > step ? end - step : 0;
+        Clock::time_point before = Clock::now();
+        const char* check = "";
+        for (; step < end; step++)
+        {
+            applyCheats(sim, steps[step].cheats);
+            sim.stepPlayers(steps[step].actions, steps[step].dt);
+            if (frame.checksumStep == step + 1)
+            {
+                bool same = sim.checksum() == frame.checksum;
+                matched += same ? 1 : 0;
+                differed += same ? 0 : 1;
+                check = same ? "same" : "DIFFERS";
+            }
+        }
+        double now = std::chrono::duration<double, std::milli>(Clock::now() - before).count();
+        bool spike = header.thresholdNs > 0 && frame.phases[0] > header.thresholdNs;
+        std::cout << std::setw(5) << i << std::setw(14) << frame.phases[0] / 1e6 << std::setw(13) << frame.phases[2] / 1e6
+            << std::setw(12) << now << std::setw(10) << frame.entities << std::setw(7) << taken << "  " << check << (spike ? "  <- spike" : "") << std::endl;
+    }
+    std::cout << "checksums: " << matched << " same, " << differed << " differ" << std::endl;
+
+    // the same window again and again, for a profiler
+    if (repeat > 0)
+    {
+        double windowMs = 0.0;
+        for (int r = 0; r < repeat; r++)
+        {
+            fastForward();
+            Clock::time_point before = Clock::now();
+            for (std::uint32_t s = windowStart; s < step; s++)
+            {
+                applyCheats(sim, steps[s].cheats);
+                sim.stepPlayers(steps[s].actions, steps[s].dt);
+            }
+            windowMs += std::chrono::duration<double, std::milli>(Clock::now() - before).count();
+        }
+        std::cout << "window replayed " << repeat << " times: " << windowMs / repeat << " ms each" << std::endl;
+    }
+    return differed == 0;
+}
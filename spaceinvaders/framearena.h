@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include <charconv>
+#include <algorithm>
+
+// =================================
+// FRAME ARENA
+// =================================
+
+// data that lives for a single tick (the enemies that may shoot, dive paths before they
+// are copied into the ship, scratch space for sorting the render commands, hud strings) is
+// bump allocated from a FrameArena and dropped all at once by reset() at the end of the tick.
+// deallocating a single block does nothing.
+//
+// the arena is a std::pmr::memory_resource, so the pmr containers run on it:
+//   FrameVector<Entity> fired(&arena);
+//   FrameString label(&arena);
+// nothing allocated from it may be used after reset().
+//
+// when a tick needs more than the arena holds, the rest comes from the heap and reset()
+// grows the arena past what that tick used. after a few ticks it stops touching the heap.
+
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+    explicit FrameArena(std::size_t capacity = 64 * 1024)
+    {
+        this->grow(capacity);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    ~FrameArena()
+    {
+        this->releaseOverflow();
+    }
+
+    std::size_t capacity() const
+    {
+        return this->size;
+    }
+
+    // bytes handed out since the last reset, including what spilled to the heap
+    std::size_t used() const
+    {
+        return this->offset + this->overflowBytes;
+    }
+
+    // most bytes a single tick has used
+    std::size_t peak() const
+    {
+        return std::max(this->peakBytes, this->used());
+    }
+
+    // ticks that did not fit and went to the heap
+    std::uint64_t overflows() const
+    {
+        return this->overflowTicks;
+    }
+
+    void reset()
+    {
+        std::size_t used = this->used();
+        this->peakBytes = std::max(this->peakBytes, used);
+        if (this->overflowBytes > 0)
+        {
+            this->overflowTicks++;
+            this->releaseOverflow();
+            this->grow(used + used / 2);
+        }
+        this->offset = 0;
+    }
+
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        void* pointer = this->buffer.get() + this->offset;
+        std::size_t space = this->size - this->offset;
+        if (std::align(alignment, bytes, pointer, space))
+        {
+            this->offset = this->size - space + bytes;
+            return pointer;
+        }
+        pointer = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        this->overflow.push_back({ pointer, bytes, alignment });
+        this->overflowBytes += bytes;
+        return pointer;
+    }
+
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override
+    {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    struct Block
+    {
+        void* pointer;
+        std::size_t bytes, alignment;
+    };
+
+    std::unique_ptr<std::byte[]> buffer;
+    std::size_t size{ 0 };
+    std::size_t offset{ 0 };
+    std::vector<Block> overflow;
+    std::size_t overflowBytes{ 0 };
+    std::size_t peakBytes{ 0 };
+    std::uint64_t overflowTicks{ 0 };
+
+    void grow(std::size_t capacity)
+    {
+        this->buffer.reset(new std::byte[capacity]);
+        this->size = capacity;
+        this->offset = 0;
+    }
+
+    void releaseOverflow()
+    {
+        for (const Block& block : this->overflow)
+        {
+            std::pmr::new_delete_resource()->deallocate(block.pointer, block.bytes, block.alignment);
+        }
+        this->overflow.clear();
+        this->overflowBytes = 0;
+    }
+};
+
+template <typename T>
+using FrameVector = std::pmr::vector<T>;
+
+using FrameString = std::pmr::string;
+
+// std::to_string builds a std::string; this appends the digits in place
+template <typename T>
+FrameString& appendNumber(FrameString& text, T value)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+    return text;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <algorithm>
+
+// =================================
+// FRAME BUDGET GOVERNOR
+// =================================
+
+// watches how long frames take against a target and trades picture quality for time when
+// they run long: the world is drawn at a lower resolution and stretched to the window,
+// fewer particles and animations are kept, and the background stars thin out.
+//
+// quality moves one step at a time along a fixed ladder. it drops as soon as the averaged
+// frame time has been over budget for a short while, and only climbs back after a much
+// longer stretch well under it, so a level that barely fits doesn't flip back and forth.
+
+struct QualityLevel
+{
+    float resolution;           // fraction of the window size the world is drawn at
+    float effects;              // particles emitted and kept, as a fraction of the full amount
+    std::size_t animationLimit; // live animations, 0 for no limit
+    float stars;                // fraction of the background stars drawn
+};
+
+class FrameGovernor
+{
+public:
+    static const int levelCount = 4;
+    static constexpr QualityLevel levels[levelCount] = {
+        { 1.0f, 1.0f, 0, 1.0f },
+        { 0.85f, 0.6f, 128, 0.6f },
+        { 0.7f, 0.35f, 64, 0.35f },
+        { 0.5f, 0.15f, 32, 0.15f },
+    };
+
+    bool enabled{ true };
+    float targetSeconds{ 1.0f / 60.0f };
+    // over budget means averaging above target * overBudget, headroom below target * underBudget
+    float overBudget{ 1.1f };
+    float underBudget{ 0.7f };
+    // frames the average has to stay over budget / under it before the level changes
+    int dropFrames{ 20 };
+    int raiseFrames{ 180 };
+
+    const QualityLevel& quality() const
+    {
+        return levels[this->enabled ? this->level : 0];
+    }
+
+    int currentLevel() const
+    {
+        return this->enabled ? this->level : 0;
+    }
+
+    // smoothed frame time, seconds
+    float averageSeconds() const
+    {
+        return this->average;
+    }
+
+    // feed the time the last frame took to produce; returns true when the level changed
+    bool update(float frameSeconds)
+    {
+        // huge frames (a breakpoint, the window being dragged) say nothing about the load
+        frameSeconds = std::min(frameSeconds, this->targetSeconds * 4);
+        this->average = this->average == 0.0f ? frameSeconds : this->average + (frameSeconds - this->average) * 0.1f;
+        if (!this->enabled)
+        {
+            return false;
+        }
+
+        this->overFrames = this->average > this->targetSeconds * this->overBudget ? this->overFrames + 1 : 0;
+        this->underFrames = this->average < this->targetSeconds * this->underBudget ? this->underFrames + 1 : 0;
+        if (this->overFrames >= this->dropFrames && this->level < levelCount - 1)
+        {
+            this->setLevel(this->level + 1);
+            return true;
+        }
+        if (this->underFrames >= this->raiseFrames && this->level > 0)
+        {
+            this->setLevel(this->level - 1);
+            return true;
+        }
+        return false;
+    }
+
+    void setLevel(int level)
+    {
+        this->level = std::clamp(level, 0, levelCount - 1);
+        this->overFrames = 0;
+        this->underFrames = 0;
+    }
+
+private:
+    int level{ 0 };
+    float average{ 0.0f };
+    int overFrames{ 0 };
+    int underFrames{ 0 };
+};
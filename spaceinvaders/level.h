@@ -0,0 +1,641 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include "bullets.h"
+
+// =================================
+// LEVELS
+// =================================
+
+// levels are written as text (assets/levels/*.txt) and compiled offline into a flat
+// binary (*.lvl): a header followed by arrays of fixed-size records. loading is a single
+// read into one buffer; nothing is parsed or allocated when a wave starts, the game just
+// walks the records. all fields are 32 bit little endian.
+//
+// rebuild a level after editing it with:
+//   spaceinvaders --compile-level assets/levels/level1.txt assets/levels/level1.lvl
+//
+// text format, one statement per line, '#' starts a comment:
+//
+//   path <id> <x y> <x y> ...          dive path of up to 8 points, offsets from the ship, mirrored on the right side
+//   wave                               opens a wave of grid enemies
+//     ship enemy|boss                  boss waves spawn a single boss per slot and use the phases
+//     size <w h>                       ship size in world units
+//     hp <n>
+//     speed <n>                        horizontal speed of the formation
+//     descend <n>                      how fast ships step down when they bounce, defaults to speed
+//     bounce <n>                       how far ships travel left/right of their slot
+//     fire_rate <seconds>
+//     origin <x y>                     formation origin, relative to the arena top left
+//     grid <columns rows dx dy>        expands to columns * rows slots
+//     slot <x y>                       single extra slot, relative to the origin
+//     dive <path id>|default
+//     drop powerup|bonus <remaining>   triggers when this many ships are left in the wave
+//     phase <hp fraction> <fire rate> <speed> [emitter]   boss phase, entered when hp drops below
+//                                      the fraction. the boss runs the named bullet script emitter
+//   end
+//
+// bullet scripts (bullets.h) aren't compiled into the .lvl, they are text next to it
+// (<name>.bullets) compiled when the level loads. phases refer to emitters by bulletRoutineId.
+
+const char levelMagic[4] = { 'S', 'I', 'L', 'V' };
+const std::uint32_t levelVersion = 2;
+
+struct LevelHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t waveCount;
+    std::uint32_t slotCount;
+    std::uint32_t dropCount;
+    std::uint32_t phaseCount;
+    std::uint32_t pathCount;
+    std::uint32_t pointCount;
+};
+
+struct WaveRecord
+{
+    enum Ship
+    {
+        ENEMY = 0,
+        BOSS = 1
+    };
+    std::uint32_t ship;
+    float sizeX, sizeY;
+    std::int32_t hp;
+    float speed;
+    float descend;
+    float bounce;
+    float fireRate;
+    std::int32_t divePath; // -1 is the built in dive
+    std::uint32_t firstSlot, slotCount;
+    std::uint32_t firstDrop, dropCount;
+    std::uint32_t firstPhase, phaseCount;
+};
+
+struct SlotRecord
+{
+    float x, y;
+};
+
+struct DropRecord
+{
+    enum Kind
+    {
+        POWERUP = 0,
+        BONUS = 1
+    };
+    std::uint32_t kind;
+    std::uint32_t remaining;
+};
+
+struct PhaseRecord
+{
+    float hpFraction;
+    float fireRate;
+    float speed;
+    std::uint32_t script; // bulletRoutineId of the boss emitter, 0 for none
+};
+
+struct PathRecord
+{
+    std::uint32_t firstPoint, pointCount;
+};
+
+struct PointRecord
+{
+    float x, y;
+};
+
+// a diving ship copies its path into a fixed array (PathFollower), so paths are short
+const std::uint32_t maxPathPoints = 8;
+
+// the compiled level. the record pointers point straight into 'data'.
+class Level
+{
+public:
+    std::vector<char> data;
+    const LevelHeader* header{ nullptr };
+    const WaveRecord* waves{ nullptr };
+    const SlotRecord* slots{ nullptr };
+    const DropRecord* drops{ nullptr };
+    const PhaseRecord* phases{ nullptr };
+    const PathRecord* paths{ nullptr };
+    const PointRecord* points{ nullptr };
+    // boss attacks, compiled from text when the level loads
+    BulletScript bullets;
+
+    std::uint32_t waveCount() const
+    {
+        return this->header ? this->header->waveCount : 0;
+    }
+
+    bool loadFromMemory(std::vector<char>&& buffer)
+    {
+        this->data = std::move(buffer);
+        this->header = nullptr;
+        if (this->data.size() < sizeof(LevelHeader))
+        {
+            return false;
+        }
+        const LevelHeader* h = reinterpret_cast<const LevelHeader*>(this->data.data());
+        if (std::memcmp(h->magic, levelMagic, 4) != 0 || h->version != levelVersion)
+        {
+            return false;
+        }
+        std::size_t expected = sizeof(LevelHeader)
+            + h->waveCount * sizeof(WaveRecord)
+            + h->slotCount * sizeof(SlotRecord)
+            + h->dropCount * sizeof(DropRecord)
+            + h->phaseCount * sizeof(PhaseRecord)
+            + h->pathCount * sizeof(PathRecord)
+            + h->pointCount * sizeof(PointRecord);
+        if (this->data.size() != expected)
+        {
+            return false;
+        }
+
+        const char* cursor = this->data.data() + sizeof(LevelHeader);
+        this->waves = reinterpret_cast<const WaveRecord*>(cursor);
+        cursor += h->waveCount * sizeof(WaveRecord);
+        this->slots = reinterpret_cast<const SlotRecord*>(cursor);
+        cursor += h->slotCount * sizeof(SlotRecord);
+        this->drops = reinterpret_cast<const DropRecord*>(cursor);
+        cursor += h->dropCount * sizeof(DropRecord);
+        this->phases = reinterpret_cast<const PhaseRecord*>(cursor);
+        cursor += h->phaseCount * sizeof(PhaseRecord);
+        this->paths = reinterpret_cast<const PathRecord*>(cursor);
+        cursor += h->pathCount * sizeof(PathRecord);
+        this->points = reinterpret_cast<const PointRecord*>(cursor);
+        if (!this->validRecords(*h))
+        {
+            return false;
+        }
+        this->header = h;
+        return true;
+    }
+
+    // every index a record holds lands inside the arrays it points into, so nothing that
+    // walks the level later has to check. a .lvl can come from anywhere (si_create)
+    bool validRecords(const LevelHeader& h) const
+    {
+        auto inside = [](std::uint32_t first, std::uint32_t count, std::uint32_t total)
+            {
+                return (std::uint64_t)first + count <= total;
+            };
+        for (std::uint32_t i = 0; i < h.waveCount; i++)
+        {
+            const WaveRecord& wave = this->waves[i];
+            if ((wave.ship != WaveRecord::ENEMY && wave.ship != WaveRecord::BOSS)
+                || wave.slotCount == 0 || !inside(wave.firstSlot, wave.slotCount, h.slotCount)
+                || !inside(wave.firstDrop, wave.dropCount, h.dropCount)
+                || !inside(wave.firstPhase, wave.phaseCount, h.phaseCount)
+                || wave.divePath < -1 || (wave.divePath >= 0 && (std::uint32_t)wave.divePath >= h.pathCount))
+            {
+                return false;
+            }
+        }
+        for (std::uint32_t i = 0; i < h.dropCount; i++)
+        {
+            if (this->drops[i].kind != DropRecord::POWERUP && this->drops[i].kind != DropRecord::BONUS)
+            {
+                return false;
+            }
+        }
+        for (std::uint32_t i = 0; i < h.pathCount; i++)
+        {
+            const PathRecord& path = this->paths[i];
+            if (path.pointCount < 2 || path.pointCount > maxPathPoints || !inside(path.firstPoint, path.pointCount, h.pointCount))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool loadFromFile(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            return false;
+        }
+        std::vector<char> buffer((std::size_t)file.tellg());
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+        if (!file)
+        {
+            return false;
+        }
+        return this->loadFromMemory(std::move(buffer));
+    }
+};
+
+// text -> binary. only used offline (--compile-level) and as a fallback when the .lvl is missing.
+class LevelCompiler
+{
+public:
+    std::vector<WaveRecord> waves;
+    std::vector<SlotRecord> slots;
+    std::vector<DropRecord> drops;
+    std::vector<PhaseRecord> phases;
+    std::vector<PathRecord> paths;
+    std::vector<PointRecord> points;
+    std::vector<int> pathIds;
+    std::string error;
+
+    bool fail(int line, const std::string& message)
+    {
+        this->error = "line " + std::to_string(line) + ": " + message;
+        return false;
+    }
+
+    bool compile(std::istream& input)
+    {
+        std::string line;
+        int lineNumber = 0;
+        bool inWave = false;
+        WaveRecord wave{};
+        float originX = 0.0f, originY = 0.0f;
+        std::vector<SlotRecord> waveSlots;
+        std::vector<DropRecord> waveDrops;
+        std::vector<PhaseRecord> wavePhases;
+
+        while (std::getline(input, line))
+        {
+            lineNumber++;
+            std::size_t comment = line.find('#');
+            if (comment != std::string::npos)
+            {
+                line.erase(comment);
+            }
+            std::istringstream tokens(line);
+            std::string keyword;
+            if (!(tokens >> keyword))
+            {
+                continue;
+            }
+
+            if (keyword == "path")
+            {
+                int id;
+                if (!(tokens >> id))
+                {
+                    return this->fail(lineNumber, "path needs an id");
+                }
+                PathRecord path{ (std::uint32_t)this->points.size(), 0 };
+                PointRecord p;
+                while (tokens >> p.x >> p.y)
+                {
+                    this->points.push_back(p);
+                    path.pointCount++;
+                }
+                if (path.pointCount < 2)
+                {
+                    return this->fail(lineNumber, "path needs at least two points");
+                }
+                if (path.pointCount > maxPathPoints)
+                {
+                    return this->fail(lineNumber, "path has more than " + std::to_string(maxPathPoints) + " points");
+                }
+                this->pathIds.push_back(id);
+                this->paths.push_back(path);
+            }
+            else if (keyword == "wave")
+            {
+                if (inWave)
+                {
+                    return this->fail(lineNumber, "wave inside wave");
+                }
+                inWave = true;
+                wave = WaveRecord{};
+                wave.ship = WaveRecord::ENEMY;
+                wave.sizeX = 50.0f;
+                wave.sizeY = 40.0f;
+                wave.hp = 100;
+                wave.speed = 100.0f;
+                wave.descend = -1.0f;
+                wave.bounce = 200.0f;
+                wave.fireRate = 0.5f;
+                wave.divePath = -1;
+                originX = originY = 0.0f;
+                waveSlots.clear();
+                waveDrops.clear();
+                wavePhases.clear();
+            }
+            else if (!inWave)
+            {
+                return this->fail(lineNumber, "'" + keyword + "' outside of a wave");
+            }
+            else if (keyword == "ship")
+            {
+                std::string name;
+                tokens >> name;
+                if (name == "enemy")
+                {
+                    wave.ship = WaveRecord::ENEMY;
+                }
+                else if (name == "boss")
+                {
+                    wave.ship = WaveRecord::BOSS;
+                }
+                else
+                {
+                    return this->fail(lineNumber, "unknown ship " + name);
+                }
+            }
+            else if (keyword == "size")
+            {
+                tokens >> wave.sizeX >> wave.sizeY;
+            }
+            else if (keyword == "hp")
+            {
+                tokens >> wave.hp;
+            }
+            else if (keyword == "speed")
+            {
+                tokens >> wave.speed;
+            }
+            else if (keyword == "descend")
+            {
+                tokens >> wave.descend;
+            }
+            else if (keyword == "bounce")
+            {
+                tokens >> wave.bounce;
+            }
+            else if (keyword == "fire_rate")
+            {
+                tokens >> wave.fireRate;
+            }
+            else if (keyword == "origin")
+            {
+                tokens >> originX >> originY;
+            }
+            else if (keyword == "grid")
+            {
+                int columns, rows;
+                float dx, dy;
+                if (!(tokens >> columns >> rows >> dx >> dy))
+                {
+                    return this->fail(lineNumber, "grid needs columns rows dx dy");
+                }
+                for (int i = 0; i < columns * rows; i++)
+                {
+                    waveSlots.push_back({ originX + (float)(i % columns) * dx, originY + (float)(i / columns) * dy });
+                }
+            }
+            else if (keyword == "slot")
+            {
+                SlotRecord slot;
+                if (!(tokens >> slot.x >> slot.y))
+                {
+                    return this->fail(lineNumber, "slot needs x y");
+                }
+                waveSlots.push_back({ originX + slot.x, originY + slot.y });
+            }
+            else if (keyword == "dive")
+            {
+                std::string name;
+                tokens >> name;
+                if (name == "default")
+                {
+                    wave.divePath = -1;
+                }
+                else
+                {
+                    std::vector<int>::iterator it = std::find(this->pathIds.begin(), this->pathIds.end(), std::atoi(name.c_str()));
+                    if (it == this->pathIds.end())
+                    {
+                        return this->fail(lineNumber, "unknown path " + name);
+                    }
+                    wave.divePath = (std::int32_t)(it - this->pathIds.begin());
+                }
+            }
+            else if (keyword == "drop")
+            {
+                std::string kind;
+                DropRecord drop;
+                if (!(tokens >> kind >> drop.remaining))
+                {
+                    return this->fail(lineNumber, "drop needs a kind and a count");
+                }
+                if (kind == "powerup")
+                {
+                    drop.kind = DropRecord::POWERUP;
+                }
+                else if (kind == "bonus")
+                {
+                    drop.kind = DropRecord::BONUS;
+                }
+                else
+                {
+                    return this->fail(lineNumber, "unknown drop " + kind);
+                }
+                waveDrops.push_back(drop);
+            }
+            else if (keyword == "phase")
+            {
+                PhaseRecord phase;
+                if (!(tokens >> phase.hpFraction >> phase.fireRate >> phase.speed))
+                {
+                    return this->fail(lineNumber, "phase needs hp fraction, fire rate and speed");
+                }
+                std::string script;
+                phase.script = tokens >> script ? bulletRoutineId(script) : 0;
+                wavePhases.push_back(phase);
+            }
+            else if (keyword == "end")
+            {
+                if (waveSlots.empty())
+                {
+                    return this->fail(lineNumber, "wave has no ships");
+                }
+                if (wave.descend < 0.0f)
+                {
+                    wave.descend = wave.speed;
+                }
+                // the game consumes drops and phases front to back, so sort them now
+                std::stable_sort(waveDrops.begin(), waveDrops.end(), [](const DropRecord& a, const DropRecord& b) { return a.remaining > b.remaining; });
+                std::stable_sort(wavePhases.begin(), wavePhases.end(), [](const PhaseRecord& a, const PhaseRecord& b) { return a.hpFraction > b.hpFraction; });
+
+                wave.firstSlot = (std::uint32_t)this->slots.size();
+                wave.slotCount = (std::uint32_t)waveSlots.size();
+                wave.firstDrop = (std::uint32_t)this->drops.size();
+                wave.dropCount = (std::uint32_t)waveDrops.size();
+                wave.firstPhase = (std::uint32_t)this->phases.size();
+                wave.phaseCount = (std::uint32_t)wavePhases.size();
+                this->slots.insert(this->slots.end(), waveSlots.begin(), waveSlots.end());
+                this->drops.insert(this->drops.end(), waveDrops.begin(), waveDrops.end());
+                this->phases.insert(this->phases.end(), wavePhases.begin(), wavePhases.end());
+                this->waves.push_back(wave);
+                inWave = false;
+            }
+            else
+            {
+                return this->fail(lineNumber, "unknown keyword " + keyword);
+            }
+        }
+        if (inWave)
+        {
+            return this->fail(lineNumber, "missing 'end'");
+        }
+        if (this->waves.empty())
+        {
+            return this->fail(lineNumber, "level has no waves");
+        }
+        return true;
+    }
+
+    template <typename T>
+    static void append(std::vector<char>& out, const std::vector<T>& records)
+    {
+        const char* bytes = reinterpret_cast<const char*>(records.data());
+        out.insert(out.end(), bytes, bytes + records.size() * sizeof(T));
+    }
+
+    std::vector<char> serialize() const
+    {
+        LevelHeader header;
+        std::memcpy(header.magic, levelMagic, 4);
+        header.version = levelVersion;
+        header.waveCount = (std::uint32_t)this->waves.size();
+        header.slotCount = (std::uint32_t)this->slots.size();
+        header.dropCount = (std::uint32_t)this->drops.size();
+        header.phaseCount = (std::uint32_t)this->phases.size();
+        header.pathCount = (std::uint32_t)this->paths.size();
+        header.pointCount = (std::uint32_t)this->points.size();
+
+        std::vector<char> out(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header));
+        append(out, this->waves);
+        append(out, this->slots);
+        append(out, this->drops);
+        append(out, this->phases);
+        append(out, this->paths);
+        append(out, this->points);
+        return out;
+    }
+
+    bool compileFile(const std::string& source, const std::string& destination)
+    {
+        std::ifstream input(source);
+        if (!input)
+        {
+            this->error = "can't open " + source;
+            return false;
+        }
+        if (!this->compile(input))
+        {
+            return false;
+        }
+        std::vector<char> bytes = this->serialize();
+        std::ofstream output(destination, std::ios::binary);
+        output.write(bytes.data(), bytes.size());
+        if (!output)
+        {
+            this->error = "can't write " + destination;
+            return false;
+        }
+        return true;
+    }
+};
+
+// compiles the level's bullet scripts and checks every boss phase names an emitter they define
+inline bool loadBulletScripts(Level& level, const std::string& filename)
+{
+    std::ifstream input(filename);
+    if (input && !level.bullets.compile(input))
+    {
+        std::cout << filename << ": " << level.bullets.error << std::endl;
+        return false;
+    }
+    for (std::uint32_t i = 0; i < (level.header ? level.header->phaseCount : 0); i++)
+    {
+        if (level.phases[i].script != 0 && level.bullets.find(level.phases[i].script) < 0)
+        {
+            std::cout << filename << ": a boss phase runs an emitter that isn't defined" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// loads the compiled level, or compiles the text version in memory if the binary is missing or stale
+inline bool loadLevel(Level& level, const std::string& name)
+{
+    if (!level.loadFromFile("./assets/levels/" + name + ".lvl"))
+    {
+        LevelCompiler compiler;
+        std::ifstream input("./assets/levels/" + name + ".txt");
+        if (!input || !compiler.compile(input))
+        {
+            std::cout << "level " << name << ": " << (input ? compiler.error : "not found") << std::endl;
+            return false;
+        }
+        if (!level.loadFromMemory(compiler.serialize()))
+        {
+            return false;
+        }
+    }
+    return loadBulletScripts(level, "./assets/levels/" + name + ".bullets");
+}
+
+// --level-test: hand built records the text compiler would never write. each one must be
+// refused by the loader, the well formed one next to them must load
+inline bool testLevelLoader()
+{
+    LevelCompiler base;
+    WaveRecord boss{};
+    boss.ship = WaveRecord::BOSS;
+    boss.sizeX = boss.sizeY = 100.0f;
+    boss.hp = 1000;
+    boss.divePath = -1;
+    boss.firstSlot = 0;
+    boss.slotCount = 1;
+    boss.firstPhase = 0;
+    boss.phaseCount = 1;
+    base.waves.push_back(boss);
+    base.slots.push_back({ 100.0f, 100.0f });
+    base.phases.push_back({ 0.5f, 1.0f, 100.0f, 0 });
+    base.paths.push_back({ 0, 2 });
+    base.points.push_back({ 0.0f, 0.0f });
+    base.points.push_back({ 0.0f, 100.0f });
+
+    struct Case
+    {
+        const char* name;
+        void (*corrupt)(LevelCompiler&);
+        bool loads;
+    };
+    const Case cases[] = {
+        { "well formed", [](LevelCompiler& c) {}, true },
+        { "boss wave without slots", [](LevelCompiler& c) { c.waves[0].slotCount = 0; }, false },
+        { "slot range past the end", [](LevelCompiler& c) { c.waves[0].firstSlot = 1; }, false },
+        { "phase range past the end", [](LevelCompiler& c) { c.waves[0].phaseCount = 2; }, false },
+        { "missing dive path", [](LevelCompiler& c) { c.waves[0].divePath = 1; }, false },
+        { "unknown ship", [](LevelCompiler& c) { c.waves[0].ship = 2; }, false },
+        { "path with one point", [](LevelCompiler& c) { c.paths[0].pointCount = 1; }, false },
+        { "point range past the end", [](LevelCompiler& c) { c.paths[0].firstPoint = 1; }, false }
+    };
+    bool passed = true;
+    for (const Case& test : cases)
+    {
+        LevelCompiler records = base;
+        test.corrupt(records);
+        Level level;
+        bool loads = level.loadFromMemory(records.serialize());
+        if (loads != test.loads)
+        {
+            std::cout << test.name << ": " << (loads ? "loaded" : "refused") << std::endl;
+            passed = false;
+        }
+    }
+    std::cout << (passed ? "level loader ok" : "level loader failed") << std::endl;
+    return passed;
+}
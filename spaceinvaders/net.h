@@ -0,0 +1,1274 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include "render.h"
+
+// =================================
+// NETWORK CO-OP
+// =================================
+
+// the host runs the only Simulation. the second player runs a NetClient, which sends its
+// inputs every tick and draws whatever the host reports back, so there is nothing to keep
+// in sync beyond the inputs going up and the snapshots coming down.
+//
+// - inputs: one packet per client tick carrying the last few ticks of actions, so a lost
+//   packet is covered by the next one. the host buffers them a couple of ticks deep to
+//   absorb jitter and applies one per tick.
+// - snapshots: 20 times a second, positions quantized to 1/8 unit and delta encoded against
+//   the newest snapshot the client acknowledged (full when there is none). formation
+//   members are sent relative to the formation, so a marching grid costs nothing, and a new
+//   entity is coded against the one written before it, so a grid arrives a few bytes a ship.
+//   whatever flies in a straight line goes with its velocity: both ends extrapolate it the
+//   same way, and it is sent again only when it strays more than netPositionTolerance from
+//   that line, so a bullet costs its spawn and its removal.
+// - a snapshot is at most netSnapshotBudget bytes. when more changed than fits, the players
+//   go first, then whatever waited longest, sooner near the remote ship; the rest waits for
+//   a later packet. the host keeps what it actually sent as the next baseline, so what was
+//   left out is just behind on the client until its turn. a bullet storm that spawns more
+//   than the budget carries is thinned out on the client rather than slowed down.
+// - the client predicts its own ship by replaying its unacknowledged inputs on top of
+//   every snapshot, and draws everything else ~100 ms in the past, interpolated between
+//   the two snapshots around that time.
+//
+// NetLink wraps the UDP socket and can drop and delay outgoing packets, which is how
+// --net-test exercises the protocol over loopback.
+
+const float netTickSeconds = 1.0f / 60.0f;
+const int netSnapshotInterval = 3;
+const int netInputRedundancy = 8;
+const int netInputDelay = 2;
+const int netInputMaxLag = 8;
+const int netInterpolationTicks = 6;
+const float netPositionScale = 8.0f;
+// velocities are in 1/netVelocitySteps position steps per tick
+const int netVelocitySteps = 32;
+// how far (in position steps) a moving entity may be from where its velocity took it before
+// it is worth sending again
+const std::int32_t netPositionTolerance = 8;
+// bytes of one snapshot packet: 20 a second with their udp headers are ~62 kbit/s, which
+// keeps a client under 64 kbit/s however busy the match gets
+const std::size_t netSnapshotBudget = 360;
+const unsigned short netDefaultPort = 52000;
+// udp + ipv4 headers, counted when reporting bandwidth
+const int netPacketOverhead = 28;
+
+enum NetPacketType : std::uint8_t
+{
+    NET_INPUT = 1,
+    NET_SNAPSHOT = 2
+};
+
+// -------------------------------
+// byte streams
+// -------------------------------
+
+// unsigned values as base 128 varints, signed ones zigzagged first so small negatives stay small
+struct NetWriter
+{
+    std::vector<std::uint8_t> bytes;
+
+    void u8(std::uint32_t value)
+    {
+        this->bytes.push_back((std::uint8_t)value);
+    }
+
+    void varint(std::uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            this->bytes.push_back((std::uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        this->bytes.push_back((std::uint8_t)value);
+    }
+
+    void svarint(std::int32_t value)
+    {
+        this->varint(((std::uint32_t)value << 1) ^ (std::uint32_t)(value >> 31));
+    }
+};
+
+// reads past the end or overlong varints set 'failed' and return 0
+struct NetReader
+{
+    const std::uint8_t* data{ nullptr };
+    std::size_t size{ 0 };
+    std::size_t at{ 0 };
+    bool failed{ false };
+
+    std::uint32_t u8()
+    {
+        if (this->at >= this->size)
+        {
+            this->failed = true;
+            return 0;
+        }
+        return this->data[this->at++];
+    }
+
+    std::uint32_t varint()
+    {
+        std::uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            std::uint32_t byte = this->u8();
+            value |= (byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        this->failed = true;
+        return 0;
+    }
+
+    std::int32_t svarint()
+    {
+        std::uint32_t value = this->varint();
+        return (std::int32_t)(value >> 1) ^ -(std::int32_t)(value & 1);
+    }
+};
+
+// -------------------------------
+// snapshots
+// -------------------------------
+
+// one drawable entity as the client sees it
+struct NetEntity
+{
+    enum Flags : std::uint8_t
+    {
+        FORMATION = 1, // x, y are relative to the formation offset
+        PLAYER = 2,
+        SECOND_PLAYER = 4,
+        LEFT_ENGINE = 8,
+        RIGHT_ENGINE = 16,
+        SHIELD = 32
+    };
+    std::uint32_t id{ 0 }; // entity slot on the host
+    std::uint8_t visual{ 0 }; // TextureId | RenderLayer << 5
+    std::uint8_t flags{ 0 };
+    std::int32_t x{ 0 }, y{ 0 }; // center, 1/8 units
+    std::int32_t vx{ 0 }, vy{ 0 }; // per tick, see netVelocitySteps
+    std::uint32_t w{ 0 }, h{ 0 }; // 1/2 units
+    std::uint32_t updated{ 0 }; // host tick x and y are from, not sent: both ends know it
+
+    TextureId texture() const
+    {
+        return (TextureId)(this->visual & 31);
+    }
+
+    RenderLayer layer() const
+    {
+        return (RenderLayer)(this->visual >> 5);
+    }
+};
+static_assert((int)TextureId::COUNT <= 32 && (int)RenderLayer::COUNT <= 8, "NetEntity::visual packs both into a byte");
+
+struct NetSnapshot
+{
+    std::uint32_t tick{ 0 }; // host tick, 0 means an empty slot
+    std::uint32_t inputAck{ 0 }; // newest client input tick the host has applied
+    std::uint8_t match{ 0 }; // bumped when the host restarts the match, ships teleport then
+    std::int32_t score{ 0 };
+    std::uint8_t wave{ 0 };
+    std::uint8_t status{ 0 };
+    std::uint8_t bossHealth{ 0 }; // 0 hides the bar, 255 is full health
+    std::int32_t formationX{ 0 }, formationY{ 0 };
+    std::uint8_t playerCount{ 0 };
+    std::int32_t playerHp[maxPlayers]{};
+    std::vector<NetEntity> entities; // sorted by id
+};
+
+inline std::int32_t netQuantize(float value, float scale)
+{
+    return (std::int32_t)std::lround(value * scale);
+}
+
+// moved along its velocity to 'tick'. integer math, so host and client land on the same step
+inline NetEntity netExtrapolate(const NetEntity& entity, std::uint32_t tick)
+{
+    NetEntity moved = entity;
+    std::int64_t ticks = (std::int64_t)tick - entity.updated;
+    moved.x += (std::int32_t)(entity.vx * ticks / netVelocitySteps);
+    moved.y += (std::int32_t)(entity.vy * ticks / netVelocitySteps);
+    moved.updated = tick;
+    return moved;
+}
+
+inline void captureSnapshot(Simulation& sim, std::uint32_t tick, NetSnapshot& snapshot)
+{
+    snapshot.tick = tick;
+    snapshot.score = sim.score;
+    snapshot.wave = (std::uint8_t)std::max(sim.currentWave, 0);
+    snapshot.status = (std::uint8_t)sim.status;
+    snapshot.bossHealth = 0;
+    if (sim.bossActive && sim.world.count<Boss>() > 0)
+    {
+        ComponentPool<Boss>& bosses = sim.world.pool<Boss>();
+        float health = (float)sim.world.get<Enemy>(bosses.entities[0]).hp / bosses.components[0].maxHp;
+        snapshot.bossHealth = (std::uint8_t)std::clamp((int)std::ceil(health * 255.0f), 1, 255);
+    }
+    snapshot.formationX = netQuantize(sim.formation.offset.x, netPositionScale);
+    snapshot.formationY = netQuantize(sim.formation.offset.y, netPositionScale);
+    snapshot.playerCount = (std::uint8_t)sim.playerCount;
+    for (int i = 0; i < sim.playerCount; i++)
+    {
+        snapshot.playerHp[i] = std::max(sim.world.get<Player>(sim.players[i]).hp, 0);
+    }
+
+    snapshot.entities.clear();
+    ComponentPool<Renderable>& renderables = sim.world.pool<Renderable>();
+    for (std::size_t i = 0; i < renderables.size(); i++)
+    {
+        Entity e = renderables.entities[i];
+        const Renderable& renderable = renderables.components[i];
+        const Transform& transform = sim.world.get<Transform>(e);
+        NetEntity entity;
+        entity.id = e.index;
+        entity.visual = (std::uint8_t)((int)renderable.texture | (int)renderable.layer << 5);
+        sf::Vector2f position = transform.position;
+        if (FormationSlot* slot = sim.world.tryGet<FormationSlot>(e))
+        {
+            entity.flags |= NetEntity::FORMATION;
+            position = slot->home;
+        }
+        if (Player* player = sim.world.tryGet<Player>(e))
+        {
+            entity.flags |= NetEntity::PLAYER;
+            entity.flags |= player->slot == 1 ? NetEntity::SECOND_PLAYER : 0;
+            entity.flags |= player->leftEngineActive ? NetEntity::LEFT_ENGINE : 0;
+            entity.flags |= player->rightEngineActive ? NetEntity::RIGHT_ENGINE : 0;
+            entity.flags |= player->powerupShield ? NetEntity::SHIELD : 0;
+        }
+        entity.x = netQuantize(position.x, netPositionScale);
+        entity.y = netQuantize(position.y, netPositionScale);
+        entity.w = (std::uint32_t)netQuantize(transform.size.x, 2.0f);
+        entity.h = (std::uint32_t)netQuantize(transform.size.y, 2.0f);
+        entity.updated = tick;
+        // players go exact, the client reconciles its own ship against them
+        Motion* motion = sim.world.tryGet<Motion>(e);
+        if (motion && !(entity.flags & (NetEntity::FORMATION | NetEntity::PLAYER)))
+        {
+            entity.vx = netQuantize(motion->velocity.x, netTickSeconds * netPositionScale * netVelocitySteps);
+            entity.vy = netQuantize(motion->velocity.y, netTickSeconds * netPositionScale * netVelocitySteps);
+        }
+        snapshot.entities.push_back(entity);
+    }
+    std::sort(snapshot.entities.begin(), snapshot.entities.end(), [](const NetEntity& a, const NetEntity& b) { return a.id < b.id; });
+}
+
+// the last few snapshots by tick, as baselines on the host and for interpolation on the client
+struct NetSnapshotRing
+{
+    static const int size = 32;
+    NetSnapshot slots[size];
+
+    NetSnapshot* find(std::uint32_t tick)
+    {
+        NetSnapshot& slot = this->slots[tick % size];
+        return tick != 0 && slot.tick == tick ? &slot : nullptr;
+    }
+
+    NetSnapshot& store(std::uint32_t tick)
+    {
+        NetSnapshot& slot = this->slots[tick % size];
+        slot.tick = tick;
+        return slot;
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < size; i++)
+        {
+            this->slots[i].tick = 0;
+        }
+    }
+};
+
+// changed fields of one entity against the baseline
+enum NetEntityChange : std::uint8_t
+{
+    CHANGE_REMOVED = 1,
+    CHANGE_X = 2,
+    CHANGE_Y = 4,
+    CHANGE_VISUAL = 8,
+    CHANGE_SIZE = 16,
+    CHANGE_VELOCITY = 32
+};
+
+// 'then' is already extrapolated to the tick of 'now'
+inline std::uint8_t netEntityChanges(const NetEntity& now, const NetEntity& then)
+{
+    std::uint8_t changes = 0;
+    changes |= now.x != then.x ? CHANGE_X : 0;
+    changes |= now.y != then.y ? CHANGE_Y : 0;
+    changes |= now.visual != then.visual || now.flags != then.flags ? CHANGE_VISUAL : 0;
+    changes |= now.w != then.w || now.h != then.h ? CHANGE_SIZE : 0;
+    changes |= now.vx != then.vx || now.vy != then.vy ? CHANGE_VELOCITY : 0;
+    return changes;
+}
+
+// whether the client's copy is off enough to spend bytes on: anything about how it looks or
+// moves, or a position off by more than netPositionTolerance. players only count exact
+inline bool netEntityStale(const NetEntity& now, const NetEntity& then)
+{
+    std::uint8_t changes = netEntityChanges(now, then);
+    std::int32_t tolerance = now.flags & NetEntity::PLAYER ? 0 : netPositionTolerance;
+    return (changes & (CHANGE_VISUAL | CHANGE_SIZE | CHANGE_VELOCITY)) != 0
+        || std::abs(now.x - then.x) > tolerance || std::abs(now.y - then.y) > tolerance;
+}
+
+inline void encodeEntityChange(NetWriter& out, std::uint32_t& previousId, const NetEntity& entity, const NetEntity& base, std::uint8_t changes)
+{
+    out.varint(entity.id - previousId);
+    previousId = entity.id;
+    out.u8(changes);
+    if (changes & CHANGE_X)
+    {
+        out.svarint(entity.x - base.x);
+    }
+    if (changes & CHANGE_Y)
+    {
+        out.svarint(entity.y - base.y);
+    }
+    if (changes & CHANGE_VISUAL)
+    {
+        out.u8(entity.visual);
+        out.u8(entity.flags);
+    }
+    if (changes & CHANGE_SIZE)
+    {
+        out.varint(entity.w);
+        out.varint(entity.h);
+    }
+    if (changes & CHANGE_VELOCITY)
+    {
+        out.svarint(entity.vx - base.vx);
+        out.svarint(entity.vy - base.vy);
+    }
+}
+
+// writes one client's snapshots within netSnapshotBudget. encode() turns the snapshot into
+// what the client holds once it decodes the packet: the baseline with the changes that made
+// it in. that is what later snapshots are delta encoded against
+class NetSnapshotEncoder
+{
+public:
+    // priority a change gains for every snapshot it waits: moves, then ships and shots that
+    // appear or go away, and up to nearWeight more close to the remote ship
+    static constexpr float movedWeight = 1.0f;
+    static constexpr float spawnWeight = 2.0f;
+    static constexpr float nearWeight = 16.0f;
+    static constexpr float nearDistance = 300.0f;
+
+    // changes left for a later packet, over every snapshot so far
+    std::uint64_t deferred{ 0 };
+
+    // 'base' is the snapshot the client acknowledged, null starts from nothing
+    void encode(NetSnapshot& snapshot, const NetSnapshot* base, NetWriter& out)
+    {
+        out.u8(NET_SNAPSHOT);
+        out.varint(snapshot.tick);
+        out.varint(base ? base->tick : 0);
+        out.varint(snapshot.inputAck);
+        out.u8(snapshot.match);
+        out.svarint(snapshot.score);
+        out.u8(snapshot.wave);
+        out.u8(snapshot.status);
+        out.u8(snapshot.bossHealth);
+        out.svarint(snapshot.formationX);
+        out.svarint(snapshot.formationY);
+        out.u8(snapshot.playerCount);
+        for (int i = 0; i < snapshot.playerCount; i++)
+        {
+            out.varint((std::uint32_t)snapshot.playerHp[i]);
+        }
+
+        static const std::vector<NetEntity> none;
+        const std::vector<NetEntity>& before = base ? base->entities : none;
+        // the change count is below the budget, two varint bytes at most
+        std::size_t budget = netSnapshotBudget - std::min(netSnapshotBudget, out.bytes.size() + 2);
+        this->collect(snapshot, before, base ? base->tick : 0);
+        this->choose(budget);
+
+        // both lists are sorted by id, walk them together with the changes. the change count
+        // goes in front, so the entries are written to a scratch stream first
+        NetWriter& entries = this->entries;
+        entries.bytes.clear();
+        this->view.clear();
+        std::uint32_t count = 0, previousId = 0;
+        NetEntity reference;
+        std::size_t i = 0, j = 0, k = 0;
+        while (i < snapshot.entities.size() || j < before.size())
+        {
+            bool inNow = i < snapshot.entities.size() && (j == before.size() || snapshot.entities[i].id <= before[j].id);
+            bool inBefore = j < before.size() && (i == snapshot.entities.size() || before[j].id <= snapshot.entities[i].id);
+            const NetEntity* now = inNow ? &snapshot.entities[i++] : nullptr;
+            const NetEntity* then = inBefore ? &before[j++] : nullptr;
+            std::uint32_t id = now ? now->id : then->id;
+            if (k == this->changes.size() || this->changes[k].id != id)
+            {
+                // close enough, the client keeps its copy
+                this->view.push_back(*then);
+                continue;
+            }
+            const Change& change = this->changes[k++];
+            if (change.chosen)
+            {
+                // the estimate can be a byte or two short, an entry that doesn't fit waits
+                std::size_t mark = entries.bytes.size();
+                std::uint32_t markId = previousId;
+                NetEntity markReference = reference;
+                this->writeChange(entries, previousId, reference, now, then, snapshot.tick);
+                if (entries.bytes.size() <= budget)
+                {
+                    count++;
+                    this->waiting[id].priority = 0.0f;
+                    this->waiting[id].sent = snapshot.tick;
+                    if (now)
+                    {
+                        this->view.push_back(*now);
+                    }
+                    continue;
+                }
+                entries.bytes.resize(mark);
+                previousId = markId;
+                reference = markReference;
+            }
+            this->deferred++;
+            if (then)
+            {
+                this->view.push_back(*then);
+            }
+        }
+        out.varint(count);
+        out.bytes.insert(out.bytes.end(), entries.bytes.begin(), entries.bytes.end());
+        std::swap(snapshot.entities, this->view);
+    }
+
+private:
+    // an entity that differs from the baseline
+    struct Change
+    {
+        std::uint32_t id;
+        std::uint32_t bytes; // its entry, about
+        float priority;
+        bool chosen;
+    };
+
+    struct Waiting
+    {
+        float priority{ 0.0f };
+        std::uint32_t sent{ 0 }; // the last snapshot it went out in
+    };
+
+    std::vector<Change> changes;
+    std::vector<std::uint32_t> order;
+    // by entity id
+    std::vector<Waiting> waiting;
+    std::vector<NetEntity> view;
+    NetWriter entries, sizing;
+
+    // removed, changed, or new and coded against the new entity written before it
+    static void writeChange(NetWriter& out, std::uint32_t& previousId, NetEntity& reference, const NetEntity* now, const NetEntity* then, std::uint32_t tick)
+    {
+        if (!now)
+        {
+            encodeEntityChange(out, previousId, *then, *then, CHANGE_REMOVED);
+            return;
+        }
+        NetEntity from = netExtrapolate(then ? *then : reference, tick);
+        encodeEntityChange(out, previousId, *now, from, netEntityChanges(*now, from));
+        if (!then)
+        {
+            reference = *now;
+        }
+    }
+
+    // every change against the baseline with its priority and size, in id order
+    void collect(const NetSnapshot& snapshot, const std::vector<NetEntity>& before, std::uint32_t baseTick)
+    {
+        sf::Vector2f focus;
+        bool focused = false;
+        for (const NetEntity& entity : snapshot.entities)
+        {
+            if ((entity.flags & NetEntity::PLAYER) && (entity.flags & NetEntity::SECOND_PLAYER))
+            {
+                focus = { entity.x / netPositionScale, entity.y / netPositionScale };
+                focused = true;
+            }
+        }
+
+        this->changes.clear();
+        this->sizing.bytes.clear();
+        std::uint32_t previousId = 0;
+        NetEntity reference;
+        std::size_t i = 0, j = 0;
+        while (i < snapshot.entities.size() || j < before.size())
+        {
+            bool inNow = i < snapshot.entities.size() && (j == before.size() || snapshot.entities[i].id <= before[j].id);
+            bool inBefore = j < before.size() && (i == snapshot.entities.size() || before[j].id <= snapshot.entities[i].id);
+            const NetEntity* now = inNow ? &snapshot.entities[i++] : nullptr;
+            const NetEntity* then = inBefore ? &before[j++] : nullptr;
+            if (now && then && !netEntityStale(*now, netExtrapolate(*then, snapshot.tick)))
+            {
+                continue;
+            }
+            const NetEntity& entity = now ? *now : *then;
+            if (entity.id >= this->waiting.size())
+            {
+                this->waiting.resize(entity.id + 1);
+            }
+            Waiting& waiting = this->waiting[entity.id];
+            Change change{ entity.id, 0, 0.0f, false };
+            if (entity.flags & NetEntity::PLAYER)
+            {
+                change.priority = std::numeric_limits<float>::infinity();
+            }
+            else if ((!now || !then) && waiting.sent > baseTick)
+            {
+                // already went out in a packet the client hasn't acknowledged yet. left out
+                // now it would blink in or out again for a snapshot
+                change.priority = std::numeric_limits<float>::infinity();
+            }
+            else
+            {
+                float weight = now && then ? movedWeight : spawnWeight;
+                if (focused)
+                {
+                    // where it is, or where the client draws it, whichever is closer
+                    float distance = std::numeric_limits<float>::infinity();
+                    for (const NetEntity* copy : { now, then })
+                    {
+                        if (!copy)
+                        {
+                            continue;
+                        }
+                        NetEntity at = netExtrapolate(*copy, snapshot.tick);
+                        sf::Vector2f position(at.x / netPositionScale, at.y / netPositionScale);
+                        if (at.flags & NetEntity::FORMATION)
+                        {
+                            position += sf::Vector2f(snapshot.formationX / netPositionScale, snapshot.formationY / netPositionScale);
+                        }
+                        distance = std::min(distance, std::hypot(position.x - focus.x, position.y - focus.y));
+                    }
+                    weight += nearWeight * std::max(0.0f, 1.0f - distance / nearDistance);
+                }
+                waiting.priority += weight;
+                change.priority = waiting.priority;
+            }
+            std::size_t mark = this->sizing.bytes.size();
+            writeChange(this->sizing, previousId, reference, now, then, snapshot.tick);
+            change.bytes = (std::uint32_t)(this->sizing.bytes.size() - mark);
+            this->changes.push_back(change);
+        }
+    }
+
+    // everything when it fits, otherwise the highest priorities that do
+    void choose(std::size_t budget)
+    {
+        if (this->sizing.bytes.size() <= budget)
+        {
+            for (Change& change : this->changes)
+            {
+                change.chosen = true;
+            }
+            return;
+        }
+        this->order.resize(this->changes.size());
+        for (std::size_t i = 0; i < this->order.size(); i++)
+        {
+            this->order[i] = (std::uint32_t)i;
+        }
+        std::sort(this->order.begin(), this->order.end(), [this](std::uint32_t a, std::uint32_t b)
+            {
+                const Change& first = this->changes[a];
+                const Change& second = this->changes[b];
+                return first.priority != second.priority ? first.priority > second.priority : first.id < second.id;
+            });
+        std::size_t used = 0;
+        for (std::uint32_t index : this->order)
+        {
+            Change& change = this->changes[index];
+            if (used + change.bytes <= budget)
+            {
+                change.chosen = true;
+                used += change.bytes;
+            }
+        }
+    }
+};
+
+// the packet type byte is already consumed. fails when the baseline is gone from the ring
+// or the packet is malformed
+inline bool decodeSnapshot(NetReader& in, NetSnapshotRing& ring, NetSnapshot& snapshot)
+{
+    snapshot.tick = in.varint();
+    std::uint32_t baseTick = in.varint();
+    snapshot.inputAck = in.varint();
+    snapshot.match = (std::uint8_t)in.u8();
+    snapshot.score = in.svarint();
+    snapshot.wave = (std::uint8_t)in.u8();
+    snapshot.status = (std::uint8_t)in.u8();
+    snapshot.bossHealth = (std::uint8_t)in.u8();
+    snapshot.formationX = in.svarint();
+    snapshot.formationY = in.svarint();
+    snapshot.playerCount = (std::uint8_t)std::min<std::uint32_t>(in.u8(), maxPlayers);
+    for (int i = 0; i < snapshot.playerCount; i++)
+    {
+        snapshot.playerHp[i] = (std::int32_t)in.varint();
+    }
+    const NetSnapshot* base = nullptr;
+    if (baseTick != 0)
+    {
+        base = ring.find(baseTick);
+        if (!base)
+        {
+            return false;
+        }
+    }
+
+    static const std::vector<NetEntity> none;
+    const std::vector<NetEntity>& before = base ? base->entities : none;
+    snapshot.entities.clear();
+    std::uint32_t count = in.varint(), id = 0;
+    std::size_t j = 0;
+    // new entities are coded against the previous new one
+    NetEntity reference;
+    for (std::uint32_t c = 0; c < count && !in.failed; c++)
+    {
+        id += in.varint();
+        std::uint8_t changes = (std::uint8_t)in.u8();
+        // unchanged entities in between carry over from the baseline
+        while (j < before.size() && before[j].id < id)
+        {
+            snapshot.entities.push_back(before[j++]);
+        }
+        bool known = j < before.size() && before[j].id == id;
+        NetEntity entity = netExtrapolate(known ? before[j++] : reference, snapshot.tick);
+        entity.id = id;
+        if (changes & CHANGE_REMOVED)
+        {
+            continue;
+        }
+        if (changes & CHANGE_X)
+        {
+            entity.x += in.svarint();
+        }
+        if (changes & CHANGE_Y)
+        {
+            entity.y += in.svarint();
+        }
+        if (changes & CHANGE_VISUAL)
+        {
+            entity.visual = (std::uint8_t)in.u8();
+            entity.flags = (std::uint8_t)in.u8();
+            if ((entity.visual & 31) >= (int)TextureId::COUNT || (entity.visual >> 5) >= (int)RenderLayer::COUNT)
+            {
+                return false;
+            }
+        }
+        if (changes & CHANGE_SIZE)
+        {
+            entity.w = in.varint();
+            entity.h = in.varint();
+        }
+        if (changes & CHANGE_VELOCITY)
+        {
+            entity.vx += in.svarint();
+            entity.vy += in.svarint();
+        }
+        if (!known)
+        {
+            reference = entity;
+        }
+        snapshot.entities.push_back(entity);
+    }
+    while (j < before.size())
+    {
+        snapshot.entities.push_back(before[j++]);
+    }
+    return !in.failed;
+}
+
+// -------------------------------
+// transport
+// -------------------------------
+
+// bad network on demand, applied to outgoing packets
+struct NetConditions
+{
+    float loss{ 0.0f }; // 0-1
+    float latency{ 0.0f }; // seconds, one way
+    float jitter{ 0.0f }; // up to this much extra delay, so packets also arrive out of order
+};
+
+class NetLink
+{
+public:
+    sf::UdpSocket socket;
+    NetConditions conditions;
+    std::uint64_t bytesSent{ 0 }, packetsSent{ 0 }, packetsDropped{ 0 };
+    // over the datagram limit, and the ones the socket didn't take
+    std::uint64_t packetsRefused{ 0 }, sendFailures{ 0 };
+
+    bool open(unsigned short port)
+    {
+        this->socket.setBlocking(false);
+        this->rng.seed(port);
+        return this->socket.bind(port) == sf::Socket::Done;
+    }
+
+    // false when the packet can't go out. a packet lost to 'conditions' did go out
+    bool send(const NetWriter& packet, const sf::IpAddress& address, unsigned short port, float now)
+    {
+        if (packet.bytes.size() > sf::UdpSocket::MaxDatagramSize)
+        {
+            this->packetsRefused++;
+            return false;
+        }
+        this->bytesSent += packet.bytes.size() + netPacketOverhead;
+        this->packetsSent++;
+        if (this->random() < this->conditions.loss)
+        {
+            this->packetsDropped++;
+            return true;
+        }
+        float delay = this->conditions.latency + this->conditions.jitter * this->random();
+        if (delay <= 0.0f)
+        {
+            return this->transmit(packet.bytes, address, port);
+        }
+        this->delayed.push_back({ now + delay, packet.bytes, address, port });
+        return true;
+    }
+
+    // sends the delayed packets that are due
+    void flush(float now)
+    {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < this->delayed.size(); i++)
+        {
+            Delayed& packet = this->delayed[i];
+            if (packet.due <= now)
+            {
+                this->transmit(packet.bytes, packet.address, packet.port);
+            }
+            else
+            {
+                if (kept != i)
+                {
+                    this->delayed[kept] = std::move(packet);
+                }
+                kept++;
+            }
+        }
+        this->delayed.resize(kept);
+    }
+
+    bool receive(std::vector<std::uint8_t>& buffer, sf::IpAddress& address, unsigned short& port)
+    {
+        buffer.resize(sf::UdpSocket::MaxDatagramSize);
+        std::size_t received = 0;
+        if (this->socket.receive(buffer.data(), buffer.size(), received, address, port) != sf::Socket::Done)
+        {
+            return false;
+        }
+        buffer.resize(received);
+        return true;
+    }
+
+private:
+    struct Delayed
+    {
+        float due;
+        std::vector<std::uint8_t> bytes;
+        sf::IpAddress address;
+        unsigned short port;
+    };
+    std::vector<Delayed> delayed;
+    Rng rng;
+
+    bool transmit(const std::vector<std::uint8_t>& bytes, const sf::IpAddress& address, unsigned short port)
+    {
+        if (this->socket.send(bytes.data(), bytes.size(), address, port) != sf::Socket::Done)
+        {
+            this->sendFailures++;
+            return false;
+        }
+        return true;
+    }
+
+    float random()
+    {
+        return (float)(this->rng.next() >> 8) / (float)(1 << 24);
+    }
+};
+
+// -------------------------------
+// host
+// -------------------------------
+
+// steps nothing itself: the game asks it for the remote player's actions before every
+// fixed tick and hands the simulation back after it
+class NetHost
+{
+public:
+    NetLink link;
+    std::uint32_t tick{ 0 };
+    NetSnapshotRing history;
+    std::uint8_t match{ 0 };
+    NetSnapshotEncoder encoder;
+    std::uint64_t snapshotBytes{ 0 }, snapshotsSent{ 0 }, fullSnapshotsSent{ 0 };
+    std::size_t largestSnapshot{ 0 };
+
+    // the one remote player, slot 1
+    bool connected{ false };
+    sf::IpAddress address;
+    unsigned short port{ 0 };
+    std::uint32_t ackedSnapshot{ 0 };
+    std::uint32_t newestInput{ 0 }, appliedInput{ 0 };
+    std::uint32_t actions{ 0 };
+
+    bool open(unsigned short port)
+    {
+        return this->link.open(port);
+    }
+
+    void receive(float now)
+    {
+        this->link.flush(now);
+        sf::IpAddress address;
+        unsigned short port;
+        while (this->link.receive(this->buffer, address, port))
+        {
+            NetReader in{ this->buffer.data(), this->buffer.size() };
+            if (in.u8() != NET_INPUT)
+            {
+                continue;
+            }
+            std::uint32_t newest = in.varint();
+            std::uint32_t count = std::min<std::uint32_t>(in.u8(), netInputRedundancy);
+            std::uint8_t actions[netInputRedundancy];
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                actions[i] = (std::uint8_t)in.u8();
+            }
+            std::uint32_t ack = in.varint();
+            if (in.failed || newest == 0)
+            {
+                continue;
+            }
+            // first packet claims the slot; a client that restarts its ticks takes it over
+            if (!this->connected || address != this->address || port != this->port || newest + inputBufferSize < this->newestInput)
+            {
+                this->connected = true;
+                this->address = address;
+                this->port = port;
+                this->ackedSnapshot = 0;
+                this->newestInput = this->appliedInput = 0;
+            }
+            // newest first; ticks that were applied already or are too old for the buffer are skipped
+            for (std::uint32_t i = 0; i < count && i < newest; i++)
+            {
+                std::uint32_t t = newest - i;
+                if (t > this->appliedInput && t + inputBufferSize > newest)
+                {
+                    this->inputs[t % inputBufferSize] = actions[i];
+                    this->inputTicks[t % inputBufferSize] = t;
+                }
+            }
+            this->newestInput = std::max(this->newestInput, newest);
+            this->ackedSnapshot = std::max(this->ackedSnapshot, ack);
+        }
+    }
+
+    // the remote player's actions for the coming tick. the host stays netInputDelay ticks
+    // behind the newest input; a missing tick holds the previous actions, and a client that
+    // got too far ahead (a stall on either side) is skipped forward
+    std::uint32_t nextInput()
+    {
+        if (!this->connected || this->newestInput == 0)
+        {
+            return 0;
+        }
+        if (this->appliedInput == 0 || this->newestInput > this->appliedInput + netInputMaxLag)
+        {
+            this->appliedInput = this->newestInput > netInputDelay ? this->newestInput - netInputDelay : 0;
+        }
+        std::uint32_t next = this->appliedInput + 1;
+        if (this->inputTicks[next % inputBufferSize] == next)
+        {
+            this->actions = this->inputs[next % inputBufferSize];
+            this->appliedInput = next;
+        }
+        return this->actions;
+    }
+
+    // after every fixed tick: records a snapshot every netSnapshotInterval ticks and sends it
+    void afterStep(Simulation& sim, float now)
+    {
+        this->tick++;
+        if (sim.tick < this->simTick)
+        {
+            this->match++;
+        }
+        this->simTick = sim.tick;
+        if (this->tick % netSnapshotInterval != 0 && sim.status == SimStatus::RUNNING)
+        {
+            this->link.flush(now);
+            return;
+        }
+        sim.syncFormation();
+        NetSnapshot& snapshot = this->history.store(this->tick);
+        captureSnapshot(sim, this->tick, snapshot);
+        snapshot.inputAck = this->appliedInput;
+        snapshot.match = this->match;
+        if (this->connected)
+        {
+            // from here on the history holds what the client gets, not what the host has
+            const NetSnapshot* base = this->history.find(this->ackedSnapshot);
+            NetWriter packet;
+            this->encoder.encode(snapshot, base, packet);
+            if (this->link.send(packet, this->address, this->port, now))
+            {
+                this->snapshotBytes += packet.bytes.size();
+                this->snapshotsSent++;
+                this->fullSnapshotsSent += base ? 0 : 1;
+                this->largestSnapshot = std::max(this->largestSnapshot, packet.bytes.size());
+            }
+        }
+        this->link.flush(now);
+    }
+
+private:
+    static const std::uint32_t inputBufferSize = 64;
+    std::uint64_t simTick{ 0 };
+    std::uint8_t inputs[inputBufferSize]{};
+    std::uint32_t inputTicks[inputBufferSize]{};
+    std::vector<std::uint8_t> buffer;
+};
+
+// -------------------------------
+// client
+// -------------------------------
+
+class NetClient
+{
+public:
+    NetLink link;
+    sf::IpAddress host;
+    unsigned short port{ netDefaultPort };
+    Config arena;
+    int slot{ 1 };
+
+    std::uint32_t tick{ 0 };
+    NetSnapshotRing snapshots;
+    std::uint32_t latest{ 0 };
+    // where the host is now, in ticks; the view is drawn netInterpolationTicks behind it
+    float hostTime{ 0.0f };
+    sf::Vector2f predicted;
+    // half the own ship's width from the last snapshot, keeps the prediction inside the arena
+    float predictedHalfWidth{ 0.0f };
+    bool predicting{ false };
+
+    // how far the predicted ship was from where the host put it, in units
+    double predictionError{ 0.0 }, maxPredictionError{ 0.0 };
+    std::uint64_t predictionSamples{ 0 }, snapshotsReceived{ 0 }, snapshotsRejected{ 0 };
+
+    bool connect(const sf::IpAddress& host, unsigned short port)
+    {
+        this->host = host;
+        this->port = port;
+        return this->link.open(sf::Socket::AnyPort);
+    }
+
+    const NetSnapshot* latestSnapshot()
+    {
+        return this->snapshots.find(this->latest);
+    }
+
+    // one fixed tick: predicts the ship with this tick's actions and sends them along
+    // with the previous few
+    void update(std::uint32_t actions, float now)
+    {
+        this->tick++;
+        this->hostTime += 1.0f;
+        this->inputs[this->tick % inputHistory] = (std::uint8_t)actions;
+        if (this->predicting)
+        {
+            this->predicted.x = this->predictStep(this->predicted.x, actions);
+            this->predictedX[this->tick % inputHistory] = this->predicted.x;
+        }
+
+        NetWriter packet;
+        packet.u8(NET_INPUT);
+        packet.varint(this->tick);
+        std::uint32_t count = std::min<std::uint32_t>(this->tick, netInputRedundancy);
+        packet.u8(count);
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            packet.u8(this->inputs[(this->tick - i) % inputHistory]);
+        }
+        packet.varint(this->latest);
+        this->link.send(packet, this->host, this->port, now);
+        this->link.flush(now);
+    }
+
+    void receive(float now)
+    {
+        this->link.flush(now);
+        sf::IpAddress address;
+        unsigned short port;
+        while (this->link.receive(this->buffer, address, port))
+        {
+            NetReader in{ this->buffer.data(), this->buffer.size() };
+            if (address != this->host || port != this->port || in.u8() != NET_SNAPSHOT)
+            {
+                continue;
+            }
+            // decoded aside first, a stale or broken packet must not overwrite a ring slot
+            if (!decodeSnapshot(in, this->snapshots, this->scratch) || this->scratch.tick <= this->latest)
+            {
+                this->snapshotsRejected++;
+                continue;
+            }
+            this->snapshotsReceived++;
+            const NetSnapshot* previous = this->latestSnapshot();
+            bool sameMatch = previous && previous->match == this->scratch.match;
+            this->latest = this->scratch.tick;
+            std::swap(this->snapshots.store(this->latest), this->scratch);
+            if (this->hostTime < this->latest || this->hostTime > this->latest + 2.0f * NetSnapshotRing::size)
+            {
+                this->hostTime = (float)this->latest;
+            }
+            this->reconcile(*this->snapshots.find(this->latest), sameMatch);
+        }
+    }
+
+    // the view netInterpolationTicks behind the host, own ship at its predicted position
+    void draw(RenderBackend& backend)
+    {
+        const NetSnapshot* from = nullptr;
+        const NetSnapshot* to = nullptr;
+        float renderTime = this->hostTime - netInterpolationTicks;
+        for (int i = 0; i < NetSnapshotRing::size; i++)
+        {
+            const NetSnapshot& snapshot = this->snapshots.slots[i];
+            if (snapshot.tick == 0 || snapshot.tick + NetSnapshotRing::size * netSnapshotInterval < this->latest)
+            {
+                continue;
+            }
+            if (snapshot.tick <= renderTime && (!from || snapshot.tick > from->tick))
+            {
+                from = &snapshot;
+            }
+            else if (snapshot.tick > renderTime && (!to || snapshot.tick < to->tick))
+            {
+                to = &snapshot;
+            }
+        }
+        if (!from)
+        {
+            std::swap(from, to);
+        }
+        if (!from)
+        {
+            return;
+        }
+        float t = to ? (renderTime - from->tick) / (float)(to->tick - from->tick) : 0.0f;
+        sf::Vector2f formation = this->position(from->formationX, from->formationY);
+        if (to)
+        {
+            formation = lerp(formation, this->position(to->formationX, to->formationY), t);
+        }
+
+        for (int layer = 0; layer < (int)RenderLayer::COUNT; layer++)
+        {
+            backend.setLayer((int)FrameLayer::SIMULATION + layer);
+            for (const NetEntity& entity : from->entities)
+            {
+                if ((int)entity.layer() != layer)
+                {
+                    continue;
+                }
+                sf::Vector2f position = this->position(entity, renderTime);
+                const NetEntity* next = to ? this->findEntity(*to, entity.id) : nullptr;
+                if (next && next->visual == entity.visual && (next->flags & NetEntity::FORMATION) == (entity.flags & NetEntity::FORMATION))
+                {
+                    position = lerp(position, this->position(*next, renderTime), t);
+                }
+                if (entity.flags & NetEntity::FORMATION)
+                {
+                    position += formation;
+                }
+                std::uint8_t flags = entity.flags;
+                int slot = flags & NetEntity::SECOND_PLAYER ? 1 : 0;
+                if ((flags & NetEntity::PLAYER) && slot == this->slot && this->predicting)
+                {
+                    // the own ship is drawn where the prediction says, with the newest overlays
+                    position = this->predicted;
+                    if (const NetEntity* own = this->findEntity(*this->latestSnapshot(), entity.id))
+                    {
+                        flags = own->flags;
+                    }
+                }
+                sf::Vector2f size(entity.w / 2.0f, entity.h / 2.0f);
+                sf::Vector2u textureSize = backend.textureSize(entity.texture());
+                backend.drawSprite(entity.texture(), { 0, 0, (int)textureSize.x, (int)textureSize.y }, position, size, flags & NetEntity::PLAYER ? playerTint(slot) : sf::Color::White);
+                if (flags & NetEntity::PLAYER)
+                {
+                    drawPlayerOverlays(backend, position, flags & NetEntity::LEFT_ENGINE, flags & NetEntity::RIGHT_ENGINE, flags & NetEntity::SHIELD);
+                }
+            }
+        }
+        if (from->bossHealth)
+        {
+            drawBossHealth(backend, this->arena, from->bossHealth / 255.0f);
+        }
+    }
+
+private:
+    static const std::uint32_t inputHistory = 64;
+    std::uint8_t inputs[inputHistory]{};
+    float predictedX[inputHistory]{};
+    std::vector<std::uint8_t> buffer;
+    NetSnapshot scratch;
+
+    sf::Vector2f position(std::int32_t x, std::int32_t y) const
+    {
+        return { x / netPositionScale, y / netPositionScale };
+    }
+
+    // where the entity's velocity has taken it by 'time', in host ticks
+    sf::Vector2f position(const NetEntity& entity, float time) const
+    {
+        float ticks = time - entity.updated;
+        return { (entity.x + entity.vx * ticks / netVelocitySteps) / netPositionScale, (entity.y + entity.vy * ticks / netVelocitySteps) / netPositionScale };
+    }
+
+    const NetEntity* findEntity(const NetSnapshot& snapshot, std::uint32_t id) const
+    {
+        auto it = std::lower_bound(snapshot.entities.begin(), snapshot.entities.end(), id, [](const NetEntity& e, std::uint32_t id) { return e.id < id; });
+        return it != snapshot.entities.end() && it->id == id ? &*it : nullptr;
+    }
+
+    // the same clamp and move the simulation does for a ship, one tick
+    float predictStep(float x, std::uint32_t actions) const
+    {
+        x = std::clamp(x, this->arena.minx + this->predictedHalfWidth, this->arena.maxx - this->predictedHalfWidth);
+        float velocity = 0.0f;
+        velocity = actions & ACTION_LEFT ? -playerShipSpeed : velocity;
+        velocity = actions & ACTION_RIGHT ? playerShipSpeed : velocity;
+        return x + velocity * netTickSeconds;
+    }
+
+    // restarts the prediction from the authoritative ship and replays what the host
+    // hasn't applied yet
+    void reconcile(const NetSnapshot& snapshot, bool sameMatch)
+    {
+        const NetEntity* own = nullptr;
+        for (const NetEntity& entity : snapshot.entities)
+        {
+            if ((entity.flags & NetEntity::PLAYER) && (entity.flags & NetEntity::SECOND_PLAYER ? 1 : 0) == this->slot)
+            {
+                own = &entity;
+            }
+        }
+        if (!own || snapshot.inputAck == 0 || snapshot.inputAck > this->tick || snapshot.inputAck + inputHistory <= this->tick)
+        {
+            this->predicting = false;
+            return;
+        }
+        sf::Vector2f authoritative = this->position(own->x, own->y);
+        if (this->predicting && sameMatch)
+        {
+            double error = std::fabs(this->predictedX[snapshot.inputAck % inputHistory] - authoritative.x);
+            this->predictionError += error;
+            this->maxPredictionError = std::max(this->maxPredictionError, error);
+            this->predictionSamples++;
+        }
+        this->predicted = authoritative;
+        this->predictedHalfWidth = own->w / 4.0f; // w is in 1/2 units
+        for (std::uint32_t t = snapshot.inputAck + 1; t <= this->tick; t++)
+        {
+            this->predicted.x = this->predictStep(this->predicted.x, this->inputs[t % inputHistory]);
+            this->predictedX[t % inputHistory] = this->predicted.x;
+        }
+        this->predicting = true;
+    }
+};
+
+// -------------------------------
+// loopback test
+// -------------------------------
+
+// --net-test: host and client in one process over 127.0.0.1, both links degraded by
+// 'conditions', both players driven by scripted inputs. 'sim' has its level loaded already;
+// 'immortal' keeps both ships alive, so a heavy level stays heavy for the whole run. reports
+// the bandwidth each way, snapshot sizes, what the budget held back and how far the client's
+// prediction was off
+inline void testNetLoopback(Simulation& sim, int seconds, NetConditions conditions, bool immortal)
+{
+    sim.playerCount = 2;
+    sim.reset(1);
+
+    NetHost host;
+    NetClient client;
+    if (!host.open(sf::Socket::AnyPort) || !client.connect(sf::IpAddress::LocalHost, host.link.socket.getLocalPort()))
+    {
+        std::cout << "can't open loopback sockets" << std::endl;
+        return;
+    }
+    host.link.conditions = conditions;
+    client.link.conditions = conditions;
+
+    // players sweep back and forth and fire; held for random stretches so prediction sees turns
+    Rng script;
+    script.seed(7);
+    std::uint32_t actions[maxPlayers] = { ACTION_LEFT, ACTION_RIGHT };
+    int matches = 1;
+    int ticks = seconds * 60;
+    for (int i = 0; i < ticks; i++)
+    {
+        float now = i * netTickSeconds;
+        for (int p = 0; p < maxPlayers; p++)
+        {
+            if (script.below(30) == 0)
+            {
+                actions[p] = (std::uint32_t)script.below(3) | ACTION_FIRE_LASER;
+            }
+        }
+        client.update(actions[1], now);
+        host.receive(now);
+        for (int p = 0; p < sim.playerCount && immortal; p++)
+        {
+            sim.world.get<Player>(sim.players[p]).hp = 1000000;
+        }
+        std::uint32_t hosted[maxPlayers] = { actions[0], host.nextInput() };
+        sim.stepPlayers(hosted, netTickSeconds);
+        host.afterStep(sim, now);
+        if (sim.status != SimStatus::RUNNING)
+        {
+            sim.reset(++matches);
+        }
+        client.receive(now);
+    }
+
+    double down = host.link.bytesSent * 8.0 / seconds / 1000.0;
+    double up = client.link.bytesSent * 8.0 / seconds / 1000.0;
+    std::cout << "loss " << conditions.loss * 100.0f << "%, latency " << conditions.latency * 1000.0f << " ms, jitter " << conditions.jitter * 1000.0f << " ms, " << matches << " matches" << std::endl;
+    std::cout << "down: " << down << " kbit/s, up: " << up << " kbit/s (udp headers included)" << std::endl;
+    std::cout << "snapshots: " << host.snapshotsSent << " sent (" << host.fullSnapshotsSent << " full), " << (host.snapshotsSent ? host.snapshotBytes / host.snapshotsSent : 0) << " bytes average, "
+        << host.largestSnapshot << " largest, " << client.snapshotsReceived << " received, " << client.snapshotsRejected << " without baseline" << std::endl;
+    std::cout << "changes left for a later packet: " << (host.snapshotsSent ? (double)host.encoder.deferred / host.snapshotsSent : 0.0) << " per snapshot; "
+        << host.link.packetsRefused << " packets over the datagram limit, " << host.link.sendFailures + client.link.sendFailures << " sends failed" << std::endl;
+    std::cout << "prediction error: " << (client.predictionSamples ? client.predictionError / client.predictionSamples : 0.0) << " units average, " << client.maxPredictionError << " max over " << client.predictionSamples << " snapshots" << std::endl;
+}
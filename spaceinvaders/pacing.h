@@ -0,0 +1,189 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+// =================================
+// FRAME PACING
+// =================================
+
+// decides when the next frame starts.
+//   VSYNC     display() waits for the monitor
+//   LIMITED   the pacer waits for the target frame time: it sleeps while the deadline is
+//             further away than a sleep can overshoot, then spins the rest, so frames come
+//             out evenly even where the os timer is coarse
+//   UNCAPPED  no waiting at all, for benchmarks
+// whatever the mode, a throttled pacer (the window is in the background) holds frames to
+// throttledSeconds.
+//
+// the time between frame starts is kept for the last few seconds; stats() gives its
+// average, spread and worst case, and how many frames missed their deadline.
+
+enum class PacingMode
+{
+    VSYNC = 0,
+    LIMITED = 1,
+    UNCAPPED = 2
+};
+
+inline const char* pacingModeName(PacingMode mode)
+{
+    static const char* names[] = { "vsync", "limited", "uncapped" };
+    return names[(int)mode];
+}
+
+struct PacingStats
+{
+    int frames{ 0 };
+    double average{ 0.0 };   // seconds between frames
+    double deviation{ 0.0 }; // standard deviation of that, the jitter
+    double worst{ 0.0 };
+    int missed{ 0 };         // frames that took longer than 1.5 targets
+};
+
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    static const int historySize = 240;
+
+    PacingMode mode{ PacingMode::LIMITED };
+    double targetSeconds{ 1.0 / 60.0 };
+    double throttledSeconds{ 1.0 / 10.0 };
+    bool throttled{ false };
+
+    // takes --vsync, --uncapped and --fps <rate> from anywhere on the command line and removes
+    // them from argv, so the other options keep their positions. returns the new argc
+    int configure(int argc, char** argv)
+    {
+        int kept = 1;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--vsync")
+            {
+                this->mode = PacingMode::VSYNC;
+            }
+            else if (arg == "--uncapped")
+            {
+                this->mode = PacingMode::UNCAPPED;
+            }
+            else if (arg == "--fps" && i + 1 < argc)
+            {
+                this->mode = PacingMode::LIMITED;
+                this->targetSeconds = 1.0 / std::max(std::atof(argv[++i]), 1.0);
+            }
+            else
+            {
+                argv[kept++] = argv[i];
+            }
+        }
+        return kept;
+    }
+
+    void apply(sf::RenderWindow& window)
+    {
+        window.setFramerateLimit(0);
+        window.setVerticalSyncEnabled(this->mode == PacingMode::VSYNC);
+        this->deadline = Clock::now();
+        this->lastFrame = this->deadline;
+    }
+
+    // call once per frame, after display(); returns when the next frame should start
+    void wait()
+    {
+        double interval = this->throttled ? std::max(this->throttledSeconds, this->targetSeconds) : this->targetSeconds;
+        if (this->mode == PacingMode::LIMITED || this->throttled)
+        {
+            this->deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval));
+            Clock::time_point now = Clock::now();
+            // more than a frame late (a hitch, a breakpoint): start over instead of rushing to catch up
+            if (now > this->deadline + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval)))
+            {
+                this->deadline = now;
+            }
+            this->sleepUntil(this->deadline);
+        }
+        Clock::time_point now = Clock::now();
+        this->record(std::chrono::duration<double>(now - this->lastFrame).count(), interval);
+        this->lastFrame = now;
+        if (this->mode != PacingMode::LIMITED && !this->throttled)
+        {
+            this->deadline = now;
+        }
+    }
+
+    PacingStats stats() const
+    {
+        PacingStats stats;
+        stats.frames = this->count;
+        stats.missed = this->missed;
+        if (this->count == 0)
+        {
+            return stats;
+        }
+        double sum = 0.0, squares = 0.0;
+        for (int i = 0; i < this->count; i++)
+        {
+            sum += this->history[i];
+            squares += this->history[i] * this->history[i];
+            stats.worst = std::max(stats.worst, this->history[i]);
+        }
+        stats.average = sum / this->count;
+        stats.deviation = std::sqrt(std::max(squares / this->count - stats.average * stats.average, 0.0));
+        return stats;
+    }
+
+private:
+    Clock::time_point deadline{ Clock::now() };
+    Clock::time_point lastFrame{ Clock::now() };
+    double history[historySize]{};
+    bool missedHistory[historySize]{};
+    int count{ 0 };
+    int next{ 0 };
+    int missed{ 0 };
+    // how long a 1 ms sleep really takes, as moving averages. starts out pessimistic
+    double sleepMean{ 0.005 };
+    double sleepVariance{ 0.0 };
+
+    void record(double interval, double target)
+    {
+        if (this->count == historySize)
+        {
+            this->missed -= this->missedHistory[this->next] ? 1 : 0;
+        }
+        bool late = interval > target * 1.5;
+        this->history[this->next] = interval;
+        this->missedHistory[this->next] = late;
+        this->missed += late ? 1 : 0;
+        this->next = (this->next + 1) % historySize;
+        this->count = std::min(this->count + 1, historySize);
+    }
+
+    // sleeps in 1 ms steps while the deadline is further than a pessimistic sleep, then spins
+    void sleepUntil(Clock::time_point target)
+    {
+        while (true)
+        {
+            double remaining = std::chrono::duration<double>(target - Clock::now()).count();
+            double estimate = this->sleepMean + std::sqrt(this->sleepVariance);
+            if (remaining <= estimate)
+            {
+                break;
+            }
+            Clock::time_point before = Clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            double slept = std::chrono::duration<double>(Clock::now() - before).count();
+            double delta = slept - this->sleepMean;
+            this->sleepMean += delta * 0.05;
+            this->sleepVariance += (delta * delta - this->sleepVariance) * 0.05;
+        }
+        while (Clock::now() < target)
+        {
+        }
+    }
+};
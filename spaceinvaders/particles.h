@@ -0,0 +1,283 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PARTICLES_SSE 1
+#endif
+
+// =================================
+// PARTICLES
+// =================================
+
+// short lived sprites for explosions, sparks and engine trails.
+// particles are stored as parallel arrays (one per field) in a fixed size ring:
+// spawning writes over the oldest slot, so there is no allocation and no compaction,
+// and the update is a straight SIMD pass over the used part of the arrays.
+
+// what an event spits out. angles are in radians, 'spread' is the full cone width
+struct ParticleEmitter
+{
+    int count{ 10 };
+    float minSpeed{ 50.0f }, maxSpeed{ 150.0f };
+    float minLife{ 0.3f }, maxLife{ 0.6f };
+    float minSize{ 4.0f }, maxSize{ 8.0f };
+    float spread{ 6.2831853f };
+    sf::Color color{ sf::Color::White };
+    std::uint8_t firstTexture{ 0 }, textureCount{ 1 };
+};
+
+class ParticleSystem
+{
+public:
+    std::size_t capacity{ 0 };
+    std::size_t limit{ 0 }; // slots of the ring in use, at most capacity
+    std::size_t used{ 0 };
+    std::size_t head{ 0 };
+    std::vector<float> x, y, vx, vy, age, life, size;
+    std::vector<sf::Color> color;
+    std::vector<std::uint8_t> texture;
+
+    float gravity{ 0.0f };
+    float drag{ 0.2f }; // fraction of the velocity left after one second
+    std::uint32_t rngState{ 0x9E3779B9u };
+
+    std::vector<sf::Vector2f> textureSizes;
+    std::vector<sf::Vertex> vertices;
+    std::vector<std::size_t> batchStart, batchCount;
+
+    // capacity is rounded up to a multiple of 4 so the SIMD loop never needs a tail
+    void init(std::size_t capacity)
+    {
+        capacity = (capacity + 3) & ~(std::size_t)3;
+        if (capacity != this->capacity)
+        {
+            this->capacity = capacity;
+            this->x.assign(capacity, 0.0f);
+            this->y.assign(capacity, 0.0f);
+            this->vx.assign(capacity, 0.0f);
+            this->vy.assign(capacity, 0.0f);
+            this->age.assign(capacity, 0.0f);
+            this->life.assign(capacity, 0.0f);
+            this->size.assign(capacity, 0.0f);
+            this->color.assign(capacity, sf::Color::White);
+            this->texture.assign(capacity, 0);
+        }
+        this->limit = capacity;
+        this->clear();
+    }
+
+    void clear()
+    {
+        this->used = 0;
+        this->head = 0;
+    }
+
+    // shrinks (or restores) the ring to 'limit' slots, so at most that many particles live.
+    // particles past a new, smaller limit are dropped
+    void setLimit(std::size_t limit)
+    {
+        limit = std::min((std::max(limit, (std::size_t)4) + 3) & ~(std::size_t)3, this->capacity);
+        if (limit == this->limit)
+        {
+            return;
+        }
+        this->limit = limit;
+        this->used = std::min(this->used, limit);
+        this->head = limit ? this->head % limit : 0;
+    }
+
+    // only the texture sizes are needed here, texture coordinates are in pixels
+    void setTextureSizes(const std::vector<sf::Vector2f>& sizes)
+    {
+        this->textureSizes = sizes;
+        this->batchStart.assign(sizes.size() + 1, 0);
+        this->batchCount.assign(sizes.size(), 0);
+    }
+
+    float random(float min, float max)
+    {
+        // xorshift32, cheap and good enough for sparks
+        this->rngState ^= this->rngState << 13;
+        this->rngState ^= this->rngState >> 17;
+        this->rngState ^= this->rngState << 5;
+        return min + (max - min) * (float)(this->rngState & 0xFFFFFF) / (float)0x1000000;
+    }
+
+    void spawn(float px, float py, float pvx, float pvy, float plife, float psize, sf::Color pcolor, std::uint8_t ptexture)
+    {
+        if (this->limit == 0)
+        {
+            return;
+        }
+        std::size_t i = this->head;
+        this->x[i] = px;
+        this->y[i] = py;
+        this->vx[i] = pvx;
+        this->vy[i] = pvy;
+        this->age[i] = 0.0f;
+        this->life[i] = plife;
+        this->size[i] = psize;
+        this->color[i] = pcolor;
+        this->texture[i] = ptexture;
+        this->head = (this->head + 1) % this->limit;
+        if (this->used < this->limit)
+        {
+            this->used++;
+        }
+    }
+
+    // sprays 'emitter.count' particles in a cone around 'angle'
+    void emit(const ParticleEmitter& emitter, sf::Vector2f position, float angle = 0.0f, float countScale = 1.0f)
+    {
+        int count = (int)(emitter.count * countScale);
+        for (int i = 0; i < count; i++)
+        {
+            float a = angle + this->random(-emitter.spread / 2, emitter.spread / 2);
+            float speed = this->random(emitter.minSpeed, emitter.maxSpeed);
+            std::uint8_t t = emitter.firstTexture + (std::uint8_t)this->random(0.0f, (float)emitter.textureCount - 0.001f);
+            this->spawn(position.x, position.y, std::cos(a) * speed, std::sin(a) * speed,
+                this->random(emitter.minLife, emitter.maxLife), this->random(emitter.minSize, emitter.maxSize), emitter.color, t);
+        }
+    }
+
+    void update(float dt)
+    {
+        float damping = std::pow(this->drag, dt);
+        float fall = this->gravity * dt;
+        std::size_t n = (this->used + 3) & ~(std::size_t)3;
+        std::size_t i = 0;
+#ifdef PARTICLES_SSE
+        __m128 vdt = _mm_set1_ps(dt);
+        __m128 vdamping = _mm_set1_ps(damping);
+        __m128 vfall = _mm_set1_ps(fall);
+        for (; i < n; i += 4)
+        {
+            __m128 pvx = _mm_mul_ps(_mm_loadu_ps(&this->vx[i]), vdamping);
+            __m128 pvy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&this->vy[i]), vdamping), vfall);
+            _mm_storeu_ps(&this->vx[i], pvx);
+            _mm_storeu_ps(&this->vy[i], pvy);
+            _mm_storeu_ps(&this->x[i], _mm_add_ps(_mm_loadu_ps(&this->x[i]), _mm_mul_ps(pvx, vdt)));
+            _mm_storeu_ps(&this->y[i], _mm_add_ps(_mm_loadu_ps(&this->y[i]), _mm_mul_ps(pvy, vdt)));
+            _mm_storeu_ps(&this->age[i], _mm_add_ps(_mm_loadu_ps(&this->age[i]), vdt));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            this->vx[i] *= damping;
+            this->vy[i] = this->vy[i] * damping + fall;
+            this->x[i] += this->vx[i] * dt;
+            this->y[i] += this->vy[i] * dt;
+            this->age[i] += dt;
+        }
+    }
+
+    std::size_t aliveCount() const
+    {
+        std::size_t alive = 0;
+        for (std::size_t i = 0; i < this->used; i++)
+        {
+            alive += this->age[i] < this->life[i] ? 1 : 0;
+        }
+        return alive;
+    }
+
+    // one quad per live particle, laid out texture by texture in a single vertex buffer
+    // (counting sort: count per texture, then write). particles fade out and shrink with age.
+    void buildBatches()
+    {
+        std::size_t textureCount = this->textureSizes.size();
+        for (std::size_t t = 0; t < textureCount; t++)
+        {
+            this->batchCount[t] = 0;
+        }
+        for (std::size_t i = 0; i < this->used; i++)
+        {
+            if (this->age[i] < this->life[i] && this->texture[i] < textureCount)
+            {
+                this->batchCount[this->texture[i]]++;
+            }
+        }
+        this->batchStart[0] = 0;
+        for (std::size_t t = 0; t < textureCount; t++)
+        {
+            this->batchStart[t + 1] = this->batchStart[t] + this->batchCount[t] * 4;
+            this->batchCount[t] = 0;
+        }
+        if (this->vertices.size() < this->batchStart[textureCount])
+        {
+            this->vertices.resize(this->capacity * 4);
+        }
+
+        for (std::size_t i = 0; i < this->used; i++)
+        {
+            std::uint8_t t = this->texture[i];
+            if (this->age[i] >= this->life[i] || t >= textureCount)
+            {
+                continue;
+            }
+            float remaining = 1.0f - this->age[i] / this->life[i];
+            float half = this->size[i] * (0.5f + 0.5f * remaining) / 2.0f;
+            sf::Color c = this->color[i];
+            c.a = (sf::Uint8)(c.a * remaining);
+            const sf::Vector2f& ts = this->textureSizes[t];
+
+            sf::Vertex* quad = &this->vertices[this->batchStart[t] + this->batchCount[t] * 4];
+            this->batchCount[t]++;
+            quad[0] = sf::Vertex({ this->x[i] - half, this->y[i] - half }, c, { 0.0f, 0.0f });
+            quad[1] = sf::Vertex({ this->x[i] + half, this->y[i] - half }, c, { ts.x, 0.0f });
+            quad[2] = sf::Vertex({ this->x[i] + half, this->y[i] + half }, c, { ts.x, ts.y });
+            quad[3] = sf::Vertex({ this->x[i] - half, this->y[i] + half }, c, { 0.0f, ts.y });
+        }
+    }
+
+    // hands every texture batch to drawBatch(texture index, vertices, vertex count)
+    template <typename F>
+    void draw(F&& drawBatch)
+    {
+        this->buildBatches();
+        for (std::size_t t = 0; t < this->textureSizes.size(); t++)
+        {
+            if (this->batchCount[t] > 0)
+            {
+                drawBatch(t, &this->vertices[this->batchStart[t]], this->batchCount[t] * 4);
+            }
+        }
+    }
+};
+
+// --bench-particles: fills the ring with long lived particles and times update and vertex building
+inline void benchmarkParticles(std::size_t count, int frames)
+{
+    ParticleSystem particles;
+    particles.init(count);
+    particles.setTextureSizes({ { 1, 1 }, { 1, 1 }, { 1, 1 }, { 1, 1 } });
+    ParticleEmitter emitter;
+    emitter.count = (int)count;
+    emitter.minLife = 1000.0f;
+    emitter.maxLife = 1000.0f;
+    emitter.textureCount = 4;
+    particles.emit(emitter, { 800.0f, 400.0f });
+
+    sf::Clock clock;
+    for (int i = 0; i < frames; i++)
+    {
+        particles.update(1.0f / 60.0f);
+    }
+    float updateMs = clock.restart().asSeconds() * 1000.0f / frames;
+    for (int i = 0; i < frames; i++)
+    {
+        particles.buildBatches();
+    }
+    float buildMs = clock.restart().asSeconds() * 1000.0f / frames;
+
+    std::cout << "particles: " << particles.aliveCount() << ", frames: " << frames << std::endl;
+    std::cout << "update: " << updateMs << " ms/frame, " << particles.aliveCount() / updateMs << " particles/ms" << std::endl;
+    std::cout << "vertex build: " << buildMs << " ms/frame, " << particles.aliveCount() / buildMs << " particles/ms" << std::endl;
+    std::cout << "total: " << updateMs + buildMs << " ms/frame (" << (updateMs + buildMs <= 1000.0f / 60.0f ? "within" : "over") << " the 60 fps budget)" << std::endl;
+}
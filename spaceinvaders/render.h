@@ -0,0 +1,264 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "simulation.h"
+
+// =================================
+// RENDERING
+// =================================
+
+// the game draws through a RenderBackend instead of an sf::RenderWindow, so the same frame
+// can go to the window (SfmlRenderer below) or into a CPU framebuffer (SoftwareRenderer in
+// softrender.h) on machines with no display or GPU. coordinates are world coordinates and
+// textures are referred to by TextureId.
+
+inline const char* textureFile(TextureId id)
+{
+    static const char* files[(int)TextureId::COUNT] = {
+        "./assets/graphics/playerShip1_blue.png",
+        "./assets/graphics/leftEngine.png",
+        "./assets/graphics/rightEngine.png",
+        "./assets/graphics/laserBlue05.png",
+        "./assets/graphics/missile.png",
+        "./assets/graphics/shield3.png",
+        "./assets/graphics/powerup_shield.png",
+        "./assets/graphics/powerup_fire.png",
+        "./assets/graphics/laserRed05.png",
+        "./assets/graphics/enemyRed3.png",
+        "./assets/graphics/enemyRed5.png",
+        "./assets/graphics/explosionSprite.png",
+        "./assets/graphics/score_animation.png",
+        "./assets/graphics/explosionblue01.png",
+        "./assets/graphics/explosionblue02.png",
+        "./assets/graphics/explosionblue03.png",
+        "./assets/graphics/explosionblue04.png",
+        "./assets/graphics/black2.png",
+        "./assets/graphics/background.png",
+        "./assets/graphics/menu_background.png",
+        "./assets/graphics/start_button.png",
+        "./assets/graphics/start_button_selected.png",
+        "./assets/graphics/exit_button.png",
+        "./assets/graphics/exit_button_selected.png",
+        "./assets/graphics/victory.png",
+        "./assets/graphics/defeat.png"
+    };
+    return files[(int)id];
+}
+
+// masks for the textures that take hits, built from their alpha channel
+inline std::shared_ptr<const CollisionMasks> loadCollisionMasks()
+{
+    std::shared_ptr<CollisionMasks> masks = std::make_shared<CollisionMasks>();
+    masks->byTexture.resize((int)TextureId::COUNT);
+    const TextureId ships[] = { TextureId::PLAYER, TextureId::ENEMY, TextureId::BOSS };
+    for (TextureId id : ships)
+    {
+        sf::Image image;
+        if (image.loadFromFile(textureFile(id)))
+        {
+            masks->byTexture[(int)id] = CollisionMask::fromAlpha(image.getPixelsPtr(), (int)image.getSize().x, (int)image.getSize().y);
+        }
+    }
+    return masks;
+}
+
+// draw order of a frame. the simulation's RenderLayer values sit between the arena
+// background and the hud; backends that record (RenderCommandList) sort by it
+enum class FrameLayer
+{
+    BACKGROUND = 0,
+    SIMULATION = 1,
+    HUD = SIMULATION + (int)RenderLayer::COUNT,
+    COUNT
+};
+
+class RenderBackend
+{
+public:
+    // immediate backends draw in call order and can ignore layers
+    virtual void setLayer(int layer) {}
+    virtual void clear(sf::Color color) = 0;
+    virtual sf::Vector2u textureSize(TextureId texture) = 0;
+    // stretches 'rect' of the texture over size, centered on center.
+    // the rect may reach past the texture edges, the texture repeats (scrolling backgrounds)
+    virtual void drawSprite(TextureId texture, sf::IntRect rect, sf::Vector2f center, sf::Vector2f size, sf::Color color = sf::Color::White) = 0;
+    // axis aligned textured quads, 4 vertices each (top left first, bottom right third)
+    virtual void drawQuads(TextureId texture, const sf::Vertex* vertices, std::size_t vertexCount) = 0;
+    virtual void drawLineStrip(const sf::Vector2f* points, std::size_t count, sf::Color color) = 0;
+    virtual void drawPoints(const sf::Vector2f* points, std::size_t count, sf::Color color) = 0;
+    virtual void fillRect(sf::FloatRect rect, sf::Color color) = 0;
+    virtual void drawText(std::string_view text, sf::Vector2f position, unsigned int size, sf::Color color) = 0;
+    virtual ~RenderBackend() = default;
+};
+
+// draws straight to an SFML render target (the window)
+class SfmlRenderer : public RenderBackend
+{
+public:
+    sf::RenderTarget* target{ nullptr };
+    const std::vector<sf::Texture*>* textures{ nullptr };
+    sf::Sprite sprite;
+    sf::Text text;
+    std::vector<sf::Vertex> vertices;
+
+    void init(sf::RenderTarget& target, const std::vector<sf::Texture*>& textures, const sf::Font& font)
+    {
+        this->target = &target;
+        this->textures = &textures;
+        this->text.setFont(font);
+        this->text.setStyle(sf::Text::Bold);
+    }
+
+    void clear(sf::Color color) override
+    {
+        this->target->clear(color);
+    }
+
+    sf::Vector2u textureSize(TextureId texture) override
+    {
+        return (*this->textures)[(int)texture]->getSize();
+    }
+
+    void drawSprite(TextureId texture, sf::IntRect rect, sf::Vector2f center, sf::Vector2f size, sf::Color color) override
+    {
+        this->sprite.setTexture(*(*this->textures)[(int)texture]);
+        this->sprite.setTextureRect(rect);
+        this->sprite.setOrigin(rect.width / 2.0f, rect.height / 2.0f);
+        this->sprite.setScale(size.x / rect.width, size.y / rect.height);
+        this->sprite.setPosition(center);
+        this->sprite.setColor(color);
+        this->target->draw(this->sprite);
+    }
+
+    void drawQuads(TextureId texture, const sf::Vertex* vertices, std::size_t vertexCount) override
+    {
+        this->target->draw(vertices, vertexCount, sf::PrimitiveType::Quads, sf::RenderStates((*this->textures)[(int)texture]));
+    }
+
+    void drawLineStrip(const sf::Vector2f* points, std::size_t count, sf::Color color) override
+    {
+        this->drawPrimitive(points, count, color, sf::PrimitiveType::LinesStrip);
+    }
+
+    void drawPoints(const sf::Vector2f* points, std::size_t count, sf::Color color) override
+    {
+        this->drawPrimitive(points, count, color, sf::PrimitiveType::Points);
+    }
+
+    void fillRect(sf::FloatRect rect, sf::Color color) override
+    {
+        sf::Vector2f corners[4] = { { rect.left, rect.top }, { rect.left + rect.width, rect.top }, { rect.left + rect.width, rect.top + rect.height }, { rect.left, rect.top + rect.height } };
+        this->drawPrimitive(corners, 4, color, sf::PrimitiveType::Quads);
+    }
+
+    void drawText(std::string_view text, sf::Vector2f position, unsigned int size, sf::Color color) override
+    {
+        this->text.setString(sf::String::fromUtf8(text.begin(), text.end()));
+        this->text.setCharacterSize(size);
+        this->text.setFillColor(color);
+        this->text.setPosition(position);
+        this->target->draw(this->text);
+    }
+
+private:
+    void drawPrimitive(const sf::Vector2f* points, std::size_t count, sf::Color color, sf::PrimitiveType type)
+    {
+        this->vertices.clear();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            this->vertices.push_back(sf::Vertex(points[i], color));
+        }
+        this->target->draw(this->vertices.data(), this->vertices.size(), type);
+    }
+};
+
+// -------------------------------
+// scene
+// -------------------------------
+
+// second co-op ship is the same sprite, tinted
+inline sf::Color playerTint(int slot)
+{
+    return slot == 0 ? sf::Color::White : sf::Color(255, 170, 90);
+}
+
+// engines are drawn at their native size, the shield is stretched over the ship
+inline void drawPlayerOverlays(RenderBackend& backend, sf::Vector2f position, bool leftEngine, bool rightEngine, bool shield)
+{
+    if (leftEngine)
+    {
+        sf::Vector2f size(backend.textureSize(TextureId::LEFT_ENGINE));
+        backend.drawSprite(TextureId::LEFT_ENGINE, { 0, 0, (int)size.x, (int)size.y }, position + sf::Vector2f({ -60.0f, 0.0f }) + size / 2.0f, size);
+    }
+    if (rightEngine)
+    {
+        sf::Vector2f size(backend.textureSize(TextureId::RIGHT_ENGINE));
+        backend.drawSprite(TextureId::RIGHT_ENGINE, { 0, 0, (int)size.x, (int)size.y }, position + sf::Vector2f({ 20.0f, 0.0f }) + size / 2.0f, size);
+    }
+    if (shield)
+    {
+        sf::Vector2u size = backend.textureSize(TextureId::PLAYER_SHIELD);
+        backend.drawSprite(TextureId::PLAYER_SHIELD, { 0, 0, (int)size.x, (int)size.y }, position, { 50.0f, 50.0f });
+    }
+}
+
+inline void drawBossHealth(RenderBackend& backend, const Config& arena, float health)
+{
+    backend.setLayer((int)FrameLayer::HUD);
+    sf::Vector2f outline[5] = { { arena.minx, arena.miny }, { arena.maxx, arena.miny }, { arena.maxx, 5.0f }, { arena.minx, 5.0f }, { arena.minx, arena.miny } };
+    backend.drawLineStrip(outline, 5, sf::Color::Green);
+    backend.fillRect({ arena.minx, 5.0f, (arena.maxx - arena.minx) * health, arena.miny - 5.0f }, sf::Color::Green);
+}
+
+// everything the simulation decides is visible: ships, projectiles, powerups, the player
+// overlays and the boss health bar. 'afterLayer' lets the game slot its own effects
+// (animations, particles) in between the layers.
+template <typename F>
+void drawSimulation(Simulation& sim, RenderBackend& backend, F&& afterLayer)
+{
+    sim.syncFormation();
+    ComponentPool<Renderable>& renderables = sim.world.pool<Renderable>();
+    for (int layer = 0; layer < (int)RenderLayer::COUNT; layer++)
+    {
+        backend.setLayer((int)FrameLayer::SIMULATION + layer);
+        for (std::size_t i = 0; i < renderables.size(); i++)
+        {
+            Renderable& renderable = renderables.components[i];
+            if ((int)renderable.layer != layer)
+            {
+                continue;
+            }
+            Transform& transform = sim.world.get<Transform>(renderables.entities[i]);
+            sf::IntRect rect = renderable.textureRect;
+            if (rect.width == 0 || rect.height == 0)
+            {
+                sf::Vector2u size = backend.textureSize(renderable.texture);
+                rect = { 0, 0, (int)size.x, (int)size.y };
+            }
+            Player* player = renderable.layer == RenderLayer::PLAYER ? sim.world.tryGet<Player>(renderables.entities[i]) : nullptr;
+            backend.drawSprite(renderable.texture, rect, transform.position, transform.size, player ? playerTint(player->slot) : sf::Color::White);
+        }
+        afterLayer(layer);
+        if (layer == (int)RenderLayer::PLAYER)
+        {
+            for (int i = 0; i < sim.playerCount; i++)
+            {
+                Player& player = sim.world.get<Player>(sim.players[i]);
+                drawPlayerOverlays(backend, sim.world.get<Transform>(sim.players[i]).position, player.leftEngineActive, player.rightEngineActive, player.powerupShield);
+            }
+        }
+    }
+
+    if (sim.bossActive && sim.world.count<Boss>() > 0)
+    {
+        ComponentPool<Boss>& bosses = sim.world.pool<Boss>();
+        drawBossHealth(backend, sim.arena, (float)sim.world.get<Enemy>(bosses.entities[0]).hp / bosses.components[0].maxHp);
+    }
+}
+
+inline void drawSimulation(Simulation& sim, RenderBackend& backend)
+{
+    drawSimulation(sim, backend, [](int layer) {});
+}
@@ -0,0 +1,475 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory_resource>
+#include <fstream>
+#include <algorithm>
+#include "render.h"
+#include "softrender.h"
+
+// =================================
+// RENDER COMMAND LISTS
+// =================================
+
+// a frame is recorded first and drawn afterwards. the recorder is itself a RenderBackend,
+// so the game draws into it exactly like into the window; every call becomes one fixed-size
+// command (layer, texture, transform, texture rect, color) and variable data (vertices,
+// points, strings) goes to side arrays. before submission the commands are stable sorted
+// by layer and texture, then runs of sprites and quads sharing a texture are merged into a
+// single drawQuads call.
+//
+// lists save to a flat binary like compiled levels do (header + record arrays, 32 bit
+// little endian), so a captured frame can be replayed offline on any backend:
+//   spaceinvaders --replay-frame capture.rcl [width] [height]
+
+const char renderCommandsMagic[4] = { 'S', 'I', 'R', 'C' };
+const std::uint32_t renderCommandsVersion = 1;
+
+struct RenderCommandsHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t clearColor;
+    std::uint32_t commandCount;
+    std::uint32_t vertexCount;
+    std::uint32_t pointCount;
+    std::uint32_t textLength;
+    std::uint32_t textureCount;
+};
+
+struct RenderCommand
+{
+    enum Type
+    {
+        SPRITE = 0,
+        QUADS = 1,
+        LINE_STRIP = 2,
+        POINTS = 3,
+        FILL_RECT = 4,
+        TEXT = 5
+    };
+    // untextured commands sort after the textured ones of their layer
+    static const std::uint16_t noTexture = 0xFFFF;
+
+    std::uint8_t type;
+    std::uint8_t layer;
+    std::uint16_t texture;
+    // sprite: center and size. fill: the rect. text: position, character size in w
+    float x, y, w, h;
+    std::int32_t rectLeft, rectTop, rectWidth, rectHeight;
+    std::uint32_t color;
+    // range in the vertex, point or text array
+    std::uint32_t first, count;
+
+    std::uint32_t key() const
+    {
+        return ((std::uint32_t)this->layer << 16) | this->texture;
+    }
+};
+
+struct RenderCommandStats
+{
+    std::size_t commands{ 0 };
+    std::size_t drawCalls{ 0 };
+    std::size_t textureChanges{ 0 };
+};
+
+class RenderCommandList : public RenderBackend
+{
+public:
+    std::uint32_t clearColor{ 0xFF000000 };
+    std::vector<RenderCommand> commands;
+    std::vector<sf::Vertex> vertices;
+    std::vector<sf::Vector2f> points;
+    std::string text;
+    // recorded with the list so textureSize() answers the same offline
+    std::vector<sf::Vector2u> textureSizes;
+    int layer{ 0 };
+
+    // scratch for merged quads during submission
+    std::vector<sf::Vertex> batch;
+
+    void setTextureSizes(RenderBackend& backend)
+    {
+        this->textureSizes.resize((int)TextureId::COUNT);
+        for (int i = 0; i < (int)TextureId::COUNT; i++)
+        {
+            this->textureSizes[i] = backend.textureSize((TextureId)i);
+        }
+    }
+
+    void reset()
+    {
+        this->commands.clear();
+        this->vertices.clear();
+        this->points.clear();
+        this->text.clear();
+        this->layer = 0;
+    }
+
+    static std::uint32_t pack(sf::Color c)
+    {
+        return (std::uint32_t)c.r | ((std::uint32_t)c.g << 8) | ((std::uint32_t)c.b << 16) | ((std::uint32_t)c.a << 24);
+    }
+
+    static sf::Color unpack(std::uint32_t c)
+    {
+        return sf::Color(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF, c >> 24);
+    }
+
+    // -------------------------------
+    // recording
+    // -------------------------------
+
+    void setLayer(int layer) override
+    {
+        this->layer = layer;
+    }
+
+    void clear(sf::Color color) override
+    {
+        this->reset();
+        this->clearColor = pack(color);
+    }
+
+    sf::Vector2u textureSize(TextureId texture) override
+    {
+        return (int)texture < (int)this->textureSizes.size() ? this->textureSizes[(int)texture] : sf::Vector2u(0, 0);
+    }
+
+    void drawSprite(TextureId texture, sf::IntRect rect, sf::Vector2f center, sf::Vector2f size, sf::Color color) override
+    {
+        RenderCommand& command = this->add(RenderCommand::SPRITE, (std::uint16_t)texture, color);
+        command.x = center.x;
+        command.y = center.y;
+        command.w = size.x;
+        command.h = size.y;
+        command.rectLeft = rect.left;
+        command.rectTop = rect.top;
+        command.rectWidth = rect.width;
+        command.rectHeight = rect.height;
+    }
+
+    void drawQuads(TextureId texture, const sf::Vertex* vertices, std::size_t vertexCount) override
+    {
+        RenderCommand& command = this->add(RenderCommand::QUADS, (std::uint16_t)texture, sf::Color::White);
+        command.first = (std::uint32_t)this->vertices.size();
+        command.count = (std::uint32_t)vertexCount;
+        this->vertices.insert(this->vertices.end(), vertices, vertices + vertexCount);
+    }
+
+    void drawLineStrip(const sf::Vector2f* points, std::size_t count, sf::Color color) override
+    {
+        this->addPoints(RenderCommand::LINE_STRIP, points, count, color);
+    }
+
+    void drawPoints(const sf::Vector2f* points, std::size_t count, sf::Color color) override
+    {
+        this->addPoints(RenderCommand::POINTS, points, count, color);
+    }
+
+    void fillRect(sf::FloatRect rect, sf::Color color) override
+    {
+        RenderCommand& command = this->add(RenderCommand::FILL_RECT, RenderCommand::noTexture, color);
+        command.x = rect.left;
+        command.y = rect.top;
+        command.w = rect.width;
+        command.h = rect.height;
+    }
+
+    void drawText(std::string_view text, sf::Vector2f position, unsigned int size, sf::Color color) override
+    {
+        RenderCommand& command = this->add(RenderCommand::TEXT, RenderCommand::noTexture, color);
+        command.x = position.x;
+        command.y = position.y;
+        command.w = (float)size;
+        command.first = (std::uint32_t)this->text.size();
+        command.count = (std::uint32_t)text.size();
+        this->text.append(text);
+    }
+
+    // -------------------------------
+    // submission
+    // -------------------------------
+
+    // stable, so commands sharing a layer and texture keep their recorded order. sorts
+    // (key, recorded index) pairs, then moves the commands; both buffers come from
+    // 'scratch', the game passes its frame arena so sorting doesn't touch the heap
+    void sort(std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+    {
+        std::pmr::vector<std::uint64_t> order(scratch);
+        order.reserve(this->commands.size());
+        for (std::size_t i = 0; i < this->commands.size(); i++)
+        {
+            order.push_back(((std::uint64_t)this->commands[i].key() << 32) | i);
+        }
+        std::sort(order.begin(), order.end());
+        std::pmr::vector<RenderCommand> sorted(scratch);
+        sorted.reserve(this->commands.size());
+        for (std::uint64_t entry : order)
+        {
+            sorted.push_back(this->commands[(std::uint32_t)entry]);
+        }
+        std::copy(sorted.begin(), sorted.end(), this->commands.begin());
+    }
+
+    // clears the target and draws the commands on layers [firstLayer, endLayer), so the world
+    // and the hud can go to different targets. a pass drawn over what is already on the
+    // target leaves clearTarget off
+    RenderCommandStats submit(RenderBackend& backend, int firstLayer = 0, int endLayer = (int)FrameLayer::COUNT, bool clearTarget = true)
+    {
+        RenderCommandStats stats;
+        if (clearTarget)
+        {
+            backend.clear(unpack(this->clearColor));
+        }
+        std::uint16_t boundTexture = RenderCommand::noTexture;
+        for (std::size_t i = 0; i < this->commands.size(); )
+        {
+            const RenderCommand& command = this->commands[i];
+            if (command.layer < firstLayer || command.layer >= endLayer)
+            {
+                i++;
+                continue;
+            }
+            backend.setLayer(command.layer);
+            if (command.texture != RenderCommand::noTexture && command.texture != boundTexture)
+            {
+                boundTexture = command.texture;
+                stats.textureChanges++;
+            }
+            stats.drawCalls++;
+            if (command.type == RenderCommand::SPRITE || command.type == RenderCommand::QUADS)
+            {
+                std::size_t end = i;
+                this->batch.clear();
+                while (end < this->commands.size() && this->commands[end].key() == command.key()
+                    && (this->commands[end].type == RenderCommand::SPRITE || this->commands[end].type == RenderCommand::QUADS))
+                {
+                    this->appendQuads(this->commands[end]);
+                    stats.commands++;
+                    end++;
+                }
+                backend.drawQuads((TextureId)command.texture, this->batch.data(), this->batch.size());
+                i = end;
+                continue;
+            }
+            this->dispatch(command, backend);
+            stats.commands++;
+            i++;
+        }
+        return stats;
+    }
+
+    // -------------------------------
+    // serialization
+    // -------------------------------
+
+    template <typename T>
+    static void append(std::vector<char>& out, const T* records, std::size_t count)
+    {
+        const char* bytes = reinterpret_cast<const char*>(records);
+        out.insert(out.end(), bytes, bytes + count * sizeof(T));
+    }
+
+    std::vector<char> serialize() const
+    {
+        RenderCommandsHeader header;
+        std::memcpy(header.magic, renderCommandsMagic, 4);
+        header.version = renderCommandsVersion;
+        header.clearColor = this->clearColor;
+        header.commandCount = (std::uint32_t)this->commands.size();
+        header.vertexCount = (std::uint32_t)this->vertices.size();
+        header.pointCount = (std::uint32_t)this->points.size();
+        header.textLength = (std::uint32_t)this->text.size();
+        header.textureCount = (std::uint32_t)this->textureSizes.size();
+
+        std::vector<char> out(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header));
+        append(out, this->commands.data(), this->commands.size());
+        append(out, this->vertices.data(), this->vertices.size());
+        append(out, this->points.data(), this->points.size());
+        append(out, this->text.data(), this->text.size());
+        append(out, this->textureSizes.data(), this->textureSizes.size());
+        return out;
+    }
+
+    bool saveToFile(const std::string& filename) const
+    {
+        std::vector<char> bytes = this->serialize();
+        std::ofstream output(filename, std::ios::binary);
+        output.write(bytes.data(), bytes.size());
+        return (bool)output;
+    }
+
+    bool loadFromMemory(const std::vector<char>& buffer)
+    {
+        this->reset();
+        if (buffer.size() < sizeof(RenderCommandsHeader))
+        {
+            return false;
+        }
+        RenderCommandsHeader header;
+        std::memcpy(&header, buffer.data(), sizeof(header));
+        if (std::memcmp(header.magic, renderCommandsMagic, 4) != 0 || header.version != renderCommandsVersion)
+        {
+            return false;
+        }
+        std::size_t expected = sizeof(RenderCommandsHeader)
+            + header.commandCount * sizeof(RenderCommand)
+            + header.vertexCount * sizeof(sf::Vertex)
+            + header.pointCount * sizeof(sf::Vector2f)
+            + header.textLength
+            + header.textureCount * sizeof(sf::Vector2u);
+        if (buffer.size() != expected)
+        {
+            return false;
+        }
+
+        const char* cursor = buffer.data() + sizeof(RenderCommandsHeader);
+        this->clearColor = header.clearColor;
+        cursor = read(cursor, this->commands, header.commandCount);
+        cursor = read(cursor, this->vertices, header.vertexCount);
+        cursor = read(cursor, this->points, header.pointCount);
+        this->text.assign(cursor, header.textLength);
+        cursor += header.textLength;
+        read(cursor, this->textureSizes, header.textureCount);
+
+        // a damaged file must not send submit() out of bounds
+        for (std::size_t i = 0; i < this->commands.size(); i++)
+        {
+            const RenderCommand& command = this->commands[i];
+            std::size_t limit = command.type == RenderCommand::QUADS ? this->vertices.size()
+                : command.type == RenderCommand::TEXT ? this->text.size()
+                : command.type == RenderCommand::LINE_STRIP || command.type == RenderCommand::POINTS ? this->points.size()
+                : ~(std::size_t)0;
+            if (command.type > RenderCommand::TEXT || (std::size_t)command.first + command.count > limit
+                || (command.texture != RenderCommand::noTexture && command.texture >= (int)TextureId::COUNT))
+            {
+                this->reset();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool loadFromFile(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            return false;
+        }
+        std::vector<char> buffer((std::size_t)file.tellg());
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+        if (!file)
+        {
+            return false;
+        }
+        return this->loadFromMemory(buffer);
+    }
+
+private:
+    RenderCommand& add(RenderCommand::Type type, std::uint16_t texture, sf::Color color)
+    {
+        RenderCommand command{};
+        command.type = (std::uint8_t)type;
+        command.layer = (std::uint8_t)this->layer;
+        command.texture = texture;
+        command.color = pack(color);
+        this->commands.push_back(command);
+        return this->commands.back();
+    }
+
+    void addPoints(RenderCommand::Type type, const sf::Vector2f* points, std::size_t count, sf::Color color)
+    {
+        RenderCommand& command = this->add(type, RenderCommand::noTexture, color);
+        command.first = (std::uint32_t)this->points.size();
+        command.count = (std::uint32_t)count;
+        this->points.insert(this->points.end(), points, points + count);
+    }
+
+    template <typename T>
+    static const char* read(const char* cursor, std::vector<T>& out, std::size_t count)
+    {
+        out.resize(count);
+        if (count > 0)
+        {
+            std::memcpy(out.data(), cursor, count * sizeof(T));
+        }
+        return cursor + count * sizeof(T);
+    }
+
+    // sprites become one quad each; the texture repeats, so rects past the edges still wrap
+    void appendQuads(const RenderCommand& command)
+    {
+        if (command.type == RenderCommand::QUADS)
+        {
+            this->batch.insert(this->batch.end(), this->vertices.begin() + command.first, this->vertices.begin() + command.first + command.count);
+            return;
+        }
+        sf::Color color = unpack(command.color);
+        float left = command.x - command.w / 2.0f, top = command.y - command.h / 2.0f;
+        float right = left + command.w, bottom = top + command.h;
+        float u0 = (float)command.rectLeft, v0 = (float)command.rectTop;
+        float u1 = u0 + command.rectWidth, v1 = v0 + command.rectHeight;
+        this->batch.push_back(sf::Vertex({ left, top }, color, { u0, v0 }));
+        this->batch.push_back(sf::Vertex({ right, top }, color, { u1, v0 }));
+        this->batch.push_back(sf::Vertex({ right, bottom }, color, { u1, v1 }));
+        this->batch.push_back(sf::Vertex({ left, bottom }, color, { u0, v1 }));
+    }
+
+    void dispatch(const RenderCommand& command, RenderBackend& backend)
+    {
+        sf::Color color = unpack(command.color);
+        switch (command.type)
+        {
+        case RenderCommand::LINE_STRIP:
+            backend.drawLineStrip(this->points.data() + command.first, command.count, color);
+            break;
+        case RenderCommand::POINTS:
+            backend.drawPoints(this->points.data() + command.first, command.count, color);
+            break;
+        case RenderCommand::FILL_RECT:
+            backend.fillRect({ command.x, command.y, command.w, command.h }, color);
+            break;
+        case RenderCommand::TEXT:
+            backend.drawText(std::string_view(this->text).substr(command.first, command.count), { command.x, command.y }, (unsigned int)command.w, color);
+            break;
+        }
+    }
+};
+
+// --replay-frame: prints what a captured frame costs and replays it on the software renderer
+inline void replayRenderCommands(const std::string& filename, int width, int height, int repeats)
+{
+    RenderCommandList list;
+    if (!list.loadFromFile(filename))
+    {
+        std::cout << filename << ": not a render command list" << std::endl;
+        return;
+    }
+    SoftwareRenderer renderer;
+    renderer.resize(width, height, { 0.0f, 0.0f, 1600.0f, 800.0f });
+    renderer.loadTextures();
+
+    RenderCommandList unsorted = list;
+    RenderCommandStats before = unsorted.submit(renderer);
+    list.sort();
+    RenderCommandStats after;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++)
+    {
+        after = list.submit(renderer);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "commands: " << after.commands << ", vertices: " << list.vertices.size() << ", points: " << list.points.size() << std::endl;
+    std::cout << "recorded order: " << before.drawCalls << " draw calls, " << before.textureChanges << " texture changes" << std::endl;
+    std::cout << "sorted: " << after.drawCalls << " draw calls, " << after.textureChanges << " texture changes" << std::endl;
+    std::cout << "submit at " << width << "x" << height << ": " << seconds / repeats * 1000.0 << " ms" << std::endl;
+    renderer.saveToFile(filename + ".png");
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <iostream>
+#include "simulation.h"
+
+// =================================
+// BATCH RUNNER
+// =================================
+
+// hosts many independent simulations in one process and steps them in lockstep across
+// a pool of worker threads. the simulations share nothing but the read only level, so
+// there are no locks on the hot path: a step hands out simulation indexes through one
+// atomic counter and every simulation is touched by exactly one thread.
+
+// fixed set of threads running one job over [0, count) at a time. the calling thread
+// pitches in too, so a pool with n threads keeps n + 1 cores busy
+class WorkerPool
+{
+public:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(std::size_t)>* job{ nullptr };
+    std::size_t count{ 0 };
+    std::atomic<std::size_t> next{ 0 };
+    std::uint64_t generation{ 0 };
+    std::size_t busy{ 0 };
+    bool quit{ false };
+
+    void start(std::size_t threadCount)
+    {
+        for (std::size_t i = 0; i < threadCount; i++)
+        {
+            this->threads.emplace_back([this]() { this->workerLoop(); });
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->quit = true;
+        }
+        this->wake.notify_all();
+        for (std::size_t i = 0; i < this->threads.size(); i++)
+        {
+            this->threads[i].join();
+        }
+    }
+
+    // calls job(i) for every i in [0, count) and returns once all of them are done
+    void run(std::size_t count, const std::function<void(std::size_t)>& job)
+    {
+        if (this->threads.empty())
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                job(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->job = &job;
+            this->count = count;
+            this->next = 0;
+            this->busy = this->threads.size();
+            this->generation++;
+        }
+        this->wake.notify_all();
+        this->drain();
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done.wait(lock, [this]() { return this->busy == 0; });
+    }
+
+private:
+    void drain()
+    {
+        for (std::size_t i = this->next++; i < this->count; i = this->next++)
+        {
+            (*this->job)(i);
+        }
+    }
+
+    void workerLoop()
+    {
+        std::uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->wake.wait(lock, [&]() { return this->quit || this->generation != seen; });
+                if (this->quit)
+                {
+                    return;
+                }
+                seen = this->generation;
+            }
+            this->drain();
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (--this->busy == 0)
+                {
+                    this->done.notify_one();
+                }
+            }
+        }
+    }
+};
+
+// splitmix64, turns (base seed, simulation, match) into well spread independent seeds
+inline std::uint64_t streamSeed(std::uint64_t seed, std::uint64_t stream, std::uint64_t match)
+{
+    std::uint64_t z = seed + stream * 0x9E3779B97F4A7C15ull + match * 0xD1B54A32D192ED03ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+class SimulationBatch
+{
+public:
+    // one allocation per simulation keeps their hot data on separate cache lines
+    std::vector<std::unique_ptr<Simulation>> simulations;
+    std::vector<std::uint64_t> matches;
+    // per simulation result of the last step: the status a match ended with (the simulation
+    // has already been reset) or RUNNING, and the final score of that match
+    std::vector<SimStatus> finished;
+    std::vector<int> finalScores;
+    std::uint64_t seed{ 0 };
+    WorkerPool workers;
+
+    // threads = 0 uses every core
+    void init(std::shared_ptr<const Level> level, std::size_t count, std::size_t threads, std::uint64_t seed)
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        this->seed = seed;
+        this->simulations.clear();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            this->simulations.push_back(std::make_unique<Simulation>());
+            this->simulations[i]->level = level;
+        }
+        this->matches.assign(count, 0);
+        this->finished.assign(count, SimStatus::RUNNING);
+        this->finalScores.assign(count, 0);
+        if (this->workers.threads.empty())
+        {
+            this->workers.start(std::min(threads, std::max<std::size_t>(count, 1)) - 1);
+        }
+        this->reset();
+    }
+
+    void reset()
+    {
+        for (std::size_t i = 0; i < this->simulations.size(); i++)
+        {
+            this->simulations[i]->reset(streamSeed(this->seed, i, this->matches[i]));
+        }
+    }
+
+    std::size_t size() const
+    {
+        return this->simulations.size();
+    }
+
+    // steps every simulation 'ticks' times with its own action, restarting finished matches
+    // with the next seed of their stream. 'after' runs on the worker that stepped simulation i
+    void step(const std::uint32_t* actions, int ticks, float dt, const std::function<void(std::size_t)>& after = nullptr)
+    {
+        this->workers.run(this->simulations.size(), [&](std::size_t i)
+            {
+                Simulation& sim = *this->simulations[i];
+                this->finished[i] = SimStatus::RUNNING;
+                for (int t = 0; t < ticks; t++)
+                {
+                    if (sim.step(actions[i], dt) != SimStatus::RUNNING)
+                    {
+                        this->finished[i] = sim.status;
+                        this->finalScores[i] = sim.score;
+                        sim.reset(streamSeed(this->seed, i, ++this->matches[i]));
+                        break;
+                    }
+                }
+                if (after)
+                {
+                    after(i);
+                }
+            });
+    }
+};
+
+// --bench-batch: total ticks per second over 'count' simulations for 1, 2, 4... threads
+inline void benchmarkBatch(std::size_t count, std::size_t maxThreads, int steps)
+{
+    std::shared_ptr<Level> level = std::make_shared<Level>();
+    if (!loadLevel(*level, "level1"))
+    {
+        return;
+    }
+    if (maxThreads == 0)
+    {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::uint32_t> actions(count);
+    double single = 0.0;
+    for (std::size_t threads = 1; ; threads = std::min(threads * 2, maxThreads))
+    {
+        SimulationBatch batch;
+        batch.init(level, count, threads, 1);
+        Rng inputs;
+        auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++)
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                actions[i] = inputs.next() & 0xF;
+            }
+            batch.step(actions.data(), 4, 1.0f / 60.0f);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double ticksPerSecond = (double)count * steps * 4 / seconds;
+        if (threads == 1)
+        {
+            single = ticksPerSecond;
+        }
+        std::cout << "threads: " << threads << ", simulations: " << count << ", " << ticksPerSecond << " ticks/s, speedup " << ticksPerSecond / single << "x" << std::endl;
+        if (threads == maxThreads)
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,432 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include "simulation.h"
+#include "rendercommands.h"
+#include "allocations.h"
+
+// =================================
+// SCENARIOS
+// =================================
+
+// whole fights played headless with fixed seeds, for what the microbenchmarks miss:
+//   spaceinvaders --bench-scenarios [results.json [baseline.json [threshold %]]]
+//
+// a scenario is a level, a seed and a tick budget. a bot plays it, firing everything it has
+// and steering under the nearest ship; it takes its hits but can't die, so every scenario
+// plays its fight to the end. after every tick the world is drawn into a command list and
+// submitted to a small software target. per scenario the runner writes the step's time
+// percentiles, the heap peak over where it started, the allocations while it played, the
+// draw calls of a frame and a checksum of where the match ended.
+//
+// every scenario is played three times and the times are the best of the three: what a
+// fight costs doesn't change between runs, what else the machine was doing does. times
+// only compare on the machine that wrote the baseline, so keep one per machine.
+//
+// with a baseline (the results of an earlier run) every number that grew by more than the
+// threshold, 10% by default, fails the run. a checksum that differs from the baseline's
+// means the game itself changed and the fights aren't the same any more; that is
+// reported, not failed.
+
+struct Scenario
+{
+    const char* name;
+    // level text, nullptr for level1
+    const char* level;
+    // bullet script text for the level, nullptr for level1.bullets
+    const char* bullets;
+    std::uint64_t seed;
+    int ticks;
+    // a new match every this many ticks (and when one ends), 0 plays a single match
+    int restartTicks;
+    // ends when the level reaches this wave, -1 plays until the match ends
+    int endWave;
+};
+
+// the boss wave of level1 on its own
+const char scenarioBossLevel[] =
+    "wave\n"
+    " ship boss\n size 150 100\n hp 2000\n speed 400\n descend 100\n bounce 200\n fire_rate 0.5\n"
+    " origin 500 100\n slot 0 0\n phase 0.5 0.35 500 fan\n phase 0.2 0.25 600 bloom\n"
+    "end\n";
+
+// a boss that can't be brought down, in a phase from its first tick that keeps ~5000
+// slow bullets in the air
+const char scenarioStormLevel[] =
+    "wave\n"
+    " ship boss\n size 150 100\n hp 100000000\n speed 100\n descend 0\n bounce 300\n fire_rate 1000\n"
+    " origin 650 100\n slot 0 0\n phase 1 1000 100 storm\n"
+    "end\n";
+
+const char scenarioStormBullets[] =
+    "emitter storm\n"
+    "  speed 36\n"
+    "  repeat forever\n"
+    "    repeat 24\n"
+    "      fire\n"
+    "      rotate 15\n"
+    "    end\n"
+    "    rotate 7\n"
+    "    wait 0.05\n"
+    "  end\n"
+    "end\n";
+
+// 10000 ships in a 100x100 grid that shoots back and never comes down
+const char scenarioFormationLevel[] =
+    "wave\n"
+    " ship enemy\n size 4 4\n hp 100\n speed 100\n descend 0\n bounce 200\n fire_rate 0.5\n"
+    " origin 300 20\n grid 100 100 4 4\n"
+    "end\n";
+
+const int scenarioRuns = 3;
+
+const Scenario scenarios[] = {
+    { "wave", nullptr, nullptr, 1, 7200, 0, 1 },
+    { "boss", scenarioBossLevel, nullptr, 2, 7200, 0, -1 },
+    { "storm", scenarioStormLevel, scenarioStormBullets, 3, 3600, 0, -1 },
+    { "formation", scenarioFormationLevel, nullptr, 4, 600, 0, -1 },
+    { "restarts", nullptr, nullptr, 5, 6000, 60, -1 }
+};
+
+struct ScenarioResult
+{
+    std::string name;
+    int ticks{ 0 };
+    int matches{ 0 };
+    // step times in ms
+    double p50{ 0.0 }, p90{ 0.0 }, p99{ 0.0 }, max{ 0.0 };
+    std::int64_t peakHeap{ 0 };
+    std::uint64_t allocations{ 0 }, allocationBytes{ 0 };
+    double drawCalls{ 0.0 };
+    std::size_t drawCallsMax{ 0 }, commandsMax{ 0 }, projectilesMax{ 0 };
+    std::uint64_t checksum{ 0 };
+};
+
+// the scenario player: fires everything every tick (the cooldowns decide what goes out) and
+// steers under the nearest ship
+inline std::uint32_t scenarioBot(Simulation& sim)
+{
+    Transform* player = sim.world.tryGet<Transform>(sim.players[0]);
+    if (!player)
+    {
+        return 0;
+    }
+    float x = player->position.x;
+    float target = x, nearest = std::numeric_limits<float>::max();
+    sim.world.each<Enemy>([&](Entity e, Enemy& enemy)
+        {
+            float enemyX = sim.positionOf(e).x;
+            if (std::abs(enemyX - x) < nearest)
+            {
+                nearest = std::abs(enemyX - x);
+                target = enemyX;
+            }
+        });
+    std::uint32_t action = ACTION_FIRE_LASER | ACTION_FIRE_MISSILES;
+    if (target < x - 10.0f)
+    {
+        action |= ACTION_LEFT;
+    }
+    else if (target > x + 10.0f)
+    {
+        action |= ACTION_RIGHT;
+    }
+    return action;
+}
+
+inline const Scenario* findScenario(const std::string& name)
+{
+    for (const Scenario& scenario : scenarios)
+    {
+        if (name == scenario.name)
+        {
+            return &scenario;
+        }
+    }
+    return nullptr;
+}
+
+inline bool loadScenarioLevel(const Scenario& scenario, Simulation& sim)
+{
+    if (!scenario.level)
+    {
+        return sim.loadDefaultLevel();
+    }
+    std::istringstream text(scenario.level);
+    LevelCompiler compiler;
+    std::shared_ptr<Level> level = std::make_shared<Level>();
+    if (!compiler.compile(text) || !level->loadFromMemory(compiler.serialize()))
+    {
+        std::cout << scenario.name << " level: " << compiler.error << std::endl;
+        return false;
+    }
+    if (scenario.bullets)
+    {
+        std::istringstream bullets(scenario.bullets);
+        if (!level->bullets.compile(bullets))
+        {
+            std::cout << scenario.name << " bullets: " << level->bullets.error << std::endl;
+            return false;
+        }
+    }
+    else if (!loadBulletScripts(*level, "./assets/levels/level1.bullets"))
+    {
+        return false;
+    }
+    sim.level = level;
+    return true;
+}
+
+inline double scenarioPercentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    return sorted[std::min(sorted.size() - 1, (std::size_t)(p * (sorted.size() - 1) + 0.5))];
+}
+
+inline ScenarioResult runScenario(const Scenario& scenario, SoftwareRenderer& target, std::shared_ptr<const CollisionMasks> masks)
+{
+    typedef std::chrono::steady_clock Clock;
+    ScenarioResult result;
+    result.name = scenario.name;
+    // the peak counts from before the level loads, so the scenario's own world is in it
+    std::int64_t liveBefore = allocationTracker.live.load();
+    allocationTracker.peak.store(liveBefore);
+
+    Simulation sim;
+    if (!loadScenarioLevel(scenario, sim))
+    {
+        return result;
+    }
+    sim.masks = masks;
+    sim.reset(scenario.seed);
+    result.matches = 1;
+    RenderCommandList frame;
+    frame.setTextureSizes(target);
+    std::vector<double> times;
+    times.reserve(scenario.ticks);
+    std::size_t drawCalls = 0;
+
+    allocationTracker.start();
+    for (int i = 0; i < scenario.ticks; i++)
+    {
+        // a restart is part of the tick that follows it, so its cost shows in the percentiles
+        bool restart = scenario.restartTicks > 0 && i > 0 && (i % scenario.restartTicks == 0 || sim.status != SimStatus::RUNNING);
+        if (!restart)
+        {
+            sim.world.get<Player>(sim.players[0]).hp = 1000000;
+        }
+        std::uint32_t action = restart ? 0 : scenarioBot(sim);
+        Clock::time_point start = Clock::now();
+        if (restart)
+        {
+            sim.reset(scenario.seed + result.matches++);
+        }
+        SimStatus status = sim.step(action, 1.0f / 60.0f);
+        times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        allocationTracker.endFrame();
+
+        frame.reset();
+        drawSimulation(sim, frame);
+        frame.sort();
+        RenderCommandStats stats = frame.submit(target);
+        drawCalls += stats.drawCalls;
+        result.drawCallsMax = std::max(result.drawCallsMax, stats.drawCalls);
+        result.commandsMax = std::max(result.commandsMax, stats.commands);
+        result.projectilesMax = std::max(result.projectilesMax, sim.world.count<Projectile>());
+
+        if ((status != SimStatus::RUNNING && scenario.restartTicks == 0) || (scenario.endWave >= 0 && sim.currentWave >= scenario.endWave))
+        {
+            break;
+        }
+    }
+    allocationTracker.stop();
+
+    result.ticks = (int)times.size();
+    result.checksum = sim.checksum();
+    result.allocations = allocationTracker.total.count;
+    result.allocationBytes = allocationTracker.total.bytes;
+    result.peakHeap = allocationTracker.peak.load() - liveBefore;
+    result.drawCalls = (double)drawCalls / std::max(result.ticks, 1);
+    std::sort(times.begin(), times.end());
+    result.p50 = scenarioPercentile(times, 0.5);
+    result.p90 = scenarioPercentile(times, 0.9);
+    result.p99 = scenarioPercentile(times, 0.99);
+    result.max = times.empty() ? 0.0 : times.back();
+    return result;
+}
+
+inline std::string scenarioChecksumText(std::uint64_t checksum)
+{
+    std::ostringstream text;
+    text << std::hex << checksum;
+    return text.str();
+}
+
+// one scenario per line, so the baseline reader below can stay a line scanner
+inline bool writeScenarioResults(const std::string& filename, const std::vector<ScenarioResult>& results)
+{
+    std::ofstream out(filename);
+    out << "{\"scenarios\":[";
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const ScenarioResult& r = results[i];
+        out << (i ? "," : "") << "\n{\"name\":\"" << r.name << "\",\"ticks\":" << r.ticks << ",\"matches\":" << r.matches
+            << ",\"tick_ms_p50\":" << r.p50 << ",\"tick_ms_p90\":" << r.p90 << ",\"tick_ms_p99\":" << r.p99 << ",\"tick_ms_max\":" << r.max
+            << ",\"peak_heap_bytes\":" << r.peakHeap << ",\"allocations\":" << r.allocations << ",\"allocation_bytes\":" << r.allocationBytes
+            << ",\"draw_calls\":" << r.drawCalls << ",\"draw_calls_max\":" << r.drawCallsMax << ",\"commands_max\":" << r.commandsMax
+            << ",\"projectiles_max\":" << r.projectilesMax << ",\"checksum\":\"" << scenarioChecksumText(r.checksum) << "\"}";
+    }
+    out << "\n]}" << std::endl;
+    return (bool)out;
+}
+
+// reads a field back from a line writeScenarioResults wrote
+inline bool scenarioField(const std::string& line, const std::string& key, std::string& value)
+{
+    std::string pattern = "\"" + key + "\":";
+    std::size_t at = line.find(pattern);
+    if (at == std::string::npos)
+    {
+        return false;
+    }
+    at += pattern.size();
+    if (line[at] == '"')
+    {
+        value = line.substr(at + 1, line.find('"', at + 1) - at - 1);
+    }
+    else
+    {
+        value = line.substr(at, line.find_first_of(",}", at) - at);
+    }
+    return true;
+}
+
+// the numbers a run is held to, and how much noise a time gets before the threshold applies
+struct ScenarioLimit
+{
+    const char* key;
+    double slack;
+};
+
+const ScenarioLimit scenarioLimits[] = {
+    { "tick_ms_p50", 0.005 },
+    { "tick_ms_p99", 0.02 },
+    { "peak_heap_bytes", 0.0 },
+    { "allocations", 0.0 },
+    { "draw_calls_max", 0.0 }
+};
+
+inline double scenarioValue(const ScenarioResult& r, const std::string& key)
+{
+    if (key == "tick_ms_p50")
+    {
+        return r.p50;
+    }
+    if (key == "tick_ms_p99")
+    {
+        return r.p99;
+    }
+    if (key == "peak_heap_bytes")
+    {
+        return (double)r.peakHeap;
+    }
+    if (key == "allocations")
+    {
+        return (double)r.allocations;
+    }
+    return (double)r.drawCallsMax;
+}
+
+// returns false when any scenario regressed past 'threshold' percent of the baseline
+inline bool compareScenarioResults(const std::string& filename, const std::vector<ScenarioResult>& results, double threshold)
+{
+    std::ifstream in(filename);
+    if (!in)
+    {
+        std::cout << filename << ": no baseline" << std::endl;
+        return false;
+    }
+    bool passed = true;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::string name, checksum, text;
+        if (!scenarioField(line, "name", name))
+        {
+            continue;
+        }
+        auto result = std::find_if(results.begin(), results.end(), [&name](const ScenarioResult& r) { return r.name == name; });
+        if (result == results.end())
+        {
+            std::cout << name << ": in the baseline but not run" << std::endl;
+            continue;
+        }
+        if (scenarioField(line, "checksum", checksum) && checksum != scenarioChecksumText(result->checksum))
+        {
+            std::cout << name << ": checksum " << scenarioChecksumText(result->checksum) << " against " << checksum << ", the fight changed" << std::endl;
+        }
+        for (const ScenarioLimit& limit : scenarioLimits)
+        {
+            if (!scenarioField(line, limit.key, text))
+            {
+                continue;
+            }
+            double before = std::atof(text.c_str());
+            double now = scenarioValue(*result, limit.key);
+            if (now > before * (1.0 + threshold / 100.0) + limit.slack)
+            {
+                std::cout << name << ": " << limit.key << " " << now << " against " << before << " (+" << (before > 0.0 ? (now / before - 1.0) * 100.0 : 100.0) << "%)" << std::endl;
+                passed = false;
+            }
+        }
+    }
+    std::cout << (passed ? "within " : "regressed past ") << threshold << "% of " << filename << std::endl;
+    return passed;
+}
+
+// --bench-scenarios
+inline bool runScenarios(const std::string& output, const std::string& baseline, double threshold)
+{
+    SoftwareRenderer target;
+    target.resize(160, 80, { 0.0f, 0.0f, 1600.0f, 800.0f });
+    if (!target.loadTextures())
+    {
+        std::cout << "software renderer: some textures failed to load" << std::endl;
+    }
+    std::shared_ptr<const CollisionMasks> masks = loadCollisionMasks();
+
+    std::vector<ScenarioResult> results;
+    for (const Scenario& scenario : scenarios)
+    {
+        ScenarioResult r = runScenario(scenario, target, masks);
+        for (int run = 1; run < scenarioRuns; run++)
+        {
+            ScenarioResult again = runScenario(scenario, target, masks);
+            r.p50 = std::min(r.p50, again.p50);
+            r.p90 = std::min(r.p90, again.p90);
+            r.p99 = std::min(r.p99, again.p99);
+            r.max = std::min(r.max, again.max);
+        }
+        std::cout << r.name << ": " << r.ticks << " ticks, " << r.matches << " matches, tick ms p50 " << r.p50 << ", p99 " << r.p99 << ", max " << r.max
+            << ", peak heap " << r.peakHeap << " bytes, " << r.allocations << " allocations, " << r.drawCalls << " draw calls, " << r.projectilesMax << " projectiles max" << std::endl;
+        results.push_back(r);
+    }
+    if (!writeScenarioResults(output, results))
+    {
+        std::cout << "can't write " << output << std::endl;
+        return false;
+    }
+    std::cout << "results written to " << output << std::endl;
+    return baseline.empty() || compareScenarioResults(baseline, results, threshold);
+}
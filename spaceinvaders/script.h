@@ -0,0 +1,335 @@
+#pragma once
+#include <coroutine>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+// =================================
+// SCRIPTS
+// =================================
+
+// level timelines written as straight line code. a script is a coroutine returning
+// ScriptTask; it runs until it awaits something, and the scheduler resumes it when that
+// happens:
+//   co_await scripts.delay(2.0f);                          // simulated seconds
+//   co_await scripts.signals(ScriptSignal::ENEMY_KILLED, 5); // five more kills
+//   co_await scripts.when(ScriptSignal::BOSS_DAMAGED, [&] { return hp < 500; });
+//   co_await scripts.until([&] { return ...; });            // tested every tick
+//
+// the simulation raises a signal where the thing it names happens. only the scripts
+// parked on that signal test their condition then, and timers sit in a heap ordered by
+// wake time, so a tick where nothing a script waits for happens costs a comparison.
+// until() is the fallback for conditions no signal covers.
+//
+// scripts resume inside raise() and advance(), so they may change the world there. the
+// awaiting code runs in the order the scripts parked, the same every run.
+
+enum class ScriptSignal : std::uint8_t
+{
+    TICK = 0,
+    ENEMY_KILLED = 1,
+    BOSS_DAMAGED = 2,
+    COUNT
+};
+
+class ScriptScheduler;
+
+class ScriptTask
+{
+public:
+    struct promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    // a finished script takes itself off the scheduler's list and frees its frame
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(Handle handle) noexcept;
+        void await_resume() noexcept {}
+    };
+
+    struct promise_type
+    {
+        ScriptScheduler* scheduler{ nullptr };
+
+        ScriptTask get_return_object()
+        {
+            return ScriptTask(Handle::from_promise(*this));
+        }
+
+        // nothing runs until the scheduler starts it
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    ScriptTask(ScriptTask&& other) noexcept : handle(std::exchange(other.handle, nullptr))
+    {
+    }
+
+    ScriptTask(const ScriptTask&) = delete;
+    ScriptTask& operator=(const ScriptTask&) = delete;
+
+    ~ScriptTask()
+    {
+        if (this->handle)
+        {
+            this->handle.destroy();
+        }
+    }
+
+    Handle release()
+    {
+        return std::exchange(this->handle, nullptr);
+    }
+
+private:
+    explicit ScriptTask(Handle handle) : handle(handle)
+    {
+    }
+
+    Handle handle;
+};
+
+class ScriptScheduler
+{
+public:
+    struct DelayAwaiter
+    {
+        ScriptScheduler& scheduler;
+        float seconds;
+
+        bool await_ready()
+        {
+            return this->seconds <= 0.0f;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            this->scheduler.addTimer(this->scheduler.time + this->seconds, handle);
+        }
+
+        void await_resume()
+        {
+        }
+    };
+
+    // lives in the awaiting coroutine's frame while it is parked, the waiter points at it
+    template <typename F>
+    struct WhenAwaiter
+    {
+        ScriptScheduler& scheduler;
+        ScriptSignal signal;
+        F condition;
+
+        bool await_ready()
+        {
+            return this->condition();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            this->scheduler.waiters[(int)this->signal].push_back({ handle, &WhenAwaiter::test, this });
+        }
+
+        void await_resume()
+        {
+        }
+
+        static bool test(void* self)
+        {
+            return static_cast<WhenAwaiter*>(self)->condition();
+        }
+    };
+
+    ScriptScheduler() = default;
+    ScriptScheduler(const ScriptScheduler&) = delete;
+    ScriptScheduler& operator=(const ScriptScheduler&) = delete;
+
+    ~ScriptScheduler()
+    {
+        this->clear();
+    }
+
+    // runs the script up to its first co_await
+    void start(ScriptTask task)
+    {
+        ScriptTask::Handle handle = task.release();
+        handle.promise().scheduler = this;
+        this->tasks.push_back(handle);
+        handle.resume();
+    }
+
+    // drops every script where it is parked. not for use from inside a script
+    void clear()
+    {
+        for (std::vector<Waiter>& list : this->waiters)
+        {
+            list.clear();
+        }
+        this->timers.clear();
+        this->ready.clear();
+        for (ScriptTask::Handle handle : this->tasks)
+        {
+            handle.destroy();
+        }
+        this->tasks.clear();
+        this->time = 0.0f;
+        std::fill(std::begin(this->counts), std::end(this->counts), 0);
+    }
+
+    std::size_t running() const
+    {
+        return this->tasks.size();
+    }
+
+    float now() const
+    {
+        return this->time;
+    }
+
+    // how often a signal has been raised since clear()
+    std::uint64_t raised(ScriptSignal signal) const
+    {
+        return this->counts[(int)signal];
+    }
+
+    // once per step: wakes the timers that are due, then the until() conditions
+    void advance(float dt)
+    {
+        this->time += dt;
+        while (!this->timers.empty() && this->timers.front().time <= this->time)
+        {
+            std::pop_heap(this->timers.begin(), this->timers.end(), Timer::later);
+            std::coroutine_handle<> handle = this->timers.back().handle;
+            this->timers.pop_back();
+            handle.resume();
+        }
+        this->raise(ScriptSignal::TICK, 0);
+    }
+
+    // the scripts parked on 'signal' whose condition now holds run, in the order they parked
+    void raise(ScriptSignal signal, std::uint32_t count = 1)
+    {
+        this->counts[(int)signal] += count;
+        std::vector<Waiter>& list = this->waiters[(int)signal];
+        if (list.empty())
+        {
+            return;
+        }
+        // resumed scripts can park again or raise signals themselves, so the ones to wake
+        // are taken off the list first. nested raises stack their own run on 'ready'
+        std::size_t first = this->ready.size();
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < list.size(); i++)
+        {
+            if (list[i].test(list[i].awaiter))
+            {
+                this->ready.push_back(list[i].handle);
+            }
+            else
+            {
+                list[kept++] = list[i];
+            }
+        }
+        list.resize(kept);
+        for (std::size_t i = first; i < this->ready.size(); i++)
+        {
+            this->ready[i].resume();
+        }
+        this->ready.resize(first);
+    }
+
+    DelayAwaiter delay(float seconds)
+    {
+        return { *this, seconds };
+    }
+
+    template <typename F>
+    WhenAwaiter<F> when(ScriptSignal signal, F condition)
+    {
+        return { *this, signal, std::move(condition) };
+    }
+
+    template <typename F>
+    WhenAwaiter<F> until(F condition)
+    {
+        return this->when(ScriptSignal::TICK, std::move(condition));
+    }
+
+    // 'count' more raises of the signal from now
+    auto signals(ScriptSignal signal, std::uint32_t count)
+    {
+        std::uint64_t target = this->raised(signal) + count;
+        return this->when(signal, [this, signal, target]() { return this->raised(signal) >= target; });
+    }
+
+private:
+    friend struct ScriptTask::FinalAwaiter;
+
+    struct Timer
+    {
+        float time;
+        std::uint64_t order;
+        std::coroutine_handle<> handle;
+
+        // heap order: earliest first, then the one that started waiting first
+        static bool later(const Timer& a, const Timer& b)
+        {
+            return a.time > b.time || (a.time == b.time && a.order > b.order);
+        }
+    };
+
+    struct Waiter
+    {
+        std::coroutine_handle<> handle;
+        bool (*test)(void*);
+        void* awaiter;
+    };
+
+    std::vector<ScriptTask::Handle> tasks;
+    std::vector<Timer> timers;
+    std::vector<Waiter> waiters[(int)ScriptSignal::COUNT];
+    std::vector<std::coroutine_handle<>> ready;
+    std::uint64_t counts[(int)ScriptSignal::COUNT]{};
+    std::uint64_t timerOrder{ 0 };
+    float time{ 0.0f };
+
+    void addTimer(float time, std::coroutine_handle<> handle)
+    {
+        this->timers.push_back({ time, this->timerOrder++, handle });
+        std::push_heap(this->timers.begin(), this->timers.end(), Timer::later);
+    }
+
+    void finished(ScriptTask::Handle handle)
+    {
+        this->tasks.erase(std::find(this->tasks.begin(), this->tasks.end(), handle));
+    }
+};
+
+inline void ScriptTask::FinalAwaiter::await_suspend(Handle handle) noexcept
+{
+    if (handle.promise().scheduler)
+    {
+        handle.promise().scheduler->finished(handle);
+    }
+    handle.destroy();
+}
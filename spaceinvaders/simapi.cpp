@@ -0,0 +1,198 @@
+#include "simapi.h"
+#include "simulation.h"
+#include "runner.h"
+#include <cstring>
+
+struct si_env
+{
+    Simulation sim;
+    si_observation* observation{ nullptr };
+};
+
+// stamps the entity bounds into the occupancy grid, later kinds win where they overlap
+static void stampGrid(si_observation& observation, const Simulation& sim, const Transform& transform, int kind)
+{
+    float cellx = (sim.maxx - sim.minx) / observation.grid_width;
+    float celly = (sim.maxy - sim.miny) / observation.grid_height;
+    sf::FloatRect bounds = transform.bounds();
+    int left = std::max(0, (int)((bounds.left - sim.minx) / cellx));
+    int right = std::min((int)observation.grid_width - 1, (int)((bounds.left + bounds.width - sim.minx) / cellx));
+    int top = std::max(0, (int)((bounds.top - sim.miny) / celly));
+    int bottom = std::min((int)observation.grid_height - 1, (int)((bounds.top + bounds.height - sim.miny) / celly));
+    if (left > right)
+    {
+        return;
+    }
+    for (int y = top; y <= bottom; y++)
+    {
+        std::memset(observation.grid + (std::size_t)y * observation.grid_width + left, kind + 1, right - left + 1);
+    }
+}
+
+static void writeEntity(si_observation& observation, const Simulation& sim, const Transform& transform, int kind, int hp)
+{
+    if (observation.entities != nullptr && observation.entity_count < observation.entity_capacity)
+    {
+        observation.entities[observation.entity_count++] = { transform.position.x, transform.position.y, transform.size.x, transform.size.y, (float)kind, (float)hp };
+    }
+    if (observation.grid != nullptr && observation.grid_width > 0 && observation.grid_height > 0)
+    {
+        stampGrid(observation, sim, transform, kind);
+    }
+}
+
+struct si_batch
+{
+    SimulationBatch batch;
+    si_observation* observations{ nullptr };
+};
+
+// walks the pools directly, so entities come out grouped by kind: powerups, projectiles, enemies, player
+static void writeObservation(si_observation& observation, Simulation& sim)
+{
+    sim.syncFormation();
+    World& world = sim.world;
+
+    observation.entity_count = 0;
+    if (observation.grid != nullptr)
+    {
+        std::memset(observation.grid, 0, (std::size_t)observation.grid_width * observation.grid_height);
+    }
+
+    ComponentPool<Powerup>& powerups = world.pool<Powerup>();
+    for (std::size_t i = 0; i < powerups.size(); i++)
+    {
+        int kind = powerups.components[i].type == Powerup::PowerupTypes::SHIELD ? SI_KIND_POWERUP_SHIELD : SI_KIND_POWERUP_FIRE;
+        writeEntity(observation, sim, world.get<Transform>(powerups.entities[i]), kind, 0);
+    }
+    ComponentPool<Projectile>& projectiles = world.pool<Projectile>();
+    for (std::size_t i = 0; i < projectiles.size(); i++)
+    {
+        int kind = projectiles.components[i].faction == Faction::PLAYER ? SI_KIND_PLAYER_PROJECTILE : SI_KIND_ENEMY_PROJECTILE;
+        writeEntity(observation, sim, world.get<Transform>(projectiles.entities[i]), kind, 0);
+    }
+    ComponentPool<Enemy>& enemies = world.pool<Enemy>();
+    for (std::size_t i = 0; i < enemies.size(); i++)
+    {
+        int kind = world.has<Boss>(enemies.entities[i]) ? SI_KIND_BOSS : SI_KIND_ENEMY;
+        writeEntity(observation, sim, world.get<Transform>(enemies.entities[i]), kind, enemies.components[i].hp);
+    }
+    Player& player = world.get<Player>(sim.players[0]);
+    writeEntity(observation, sim, world.get<Transform>(sim.players[0]), SI_KIND_PLAYER, player.hp);
+
+    observation.score = sim.score;
+    observation.player_hp = player.hp;
+    observation.wave = sim.currentWave;
+    observation.status = (int32_t)sim.status;
+    observation.tick = sim.tick;
+}
+
+static void writeObservation(si_env& env)
+{
+    if (env.observation != nullptr)
+    {
+        writeObservation(*env.observation, env.sim);
+    }
+}
+
+static std::shared_ptr<Level> loadApiLevel(const char* level_path)
+{
+    std::shared_ptr<Level> level = std::make_shared<Level>();
+    if (level_path == nullptr)
+    {
+        return loadLevel(*level, "level1") ? level : nullptr;
+    }
+    // the bullet scripts sit next to the level: foo.lvl, foo.bullets
+    std::string path(level_path);
+    if (!level->loadFromFile(path) || !loadBulletScripts(*level, path.substr(0, path.rfind('.')) + ".bullets"))
+    {
+        return nullptr;
+    }
+    return level;
+}
+
+si_env* si_create(const char* level_path)
+{
+    std::shared_ptr<Level> level = loadApiLevel(level_path);
+    if (!level)
+    {
+        return nullptr;
+    }
+    si_env* env = new si_env();
+    env->sim.level = level;
+    env->sim.reset(0);
+    return env;
+}
+
+void si_destroy(si_env* env)
+{
+    delete env;
+}
+
+void si_bind_observation(si_env* env, si_observation* observation)
+{
+    env->observation = observation;
+    writeObservation(*env);
+}
+
+void si_reset(si_env* env, uint64_t seed)
+{
+    env->sim.reset(seed);
+    writeObservation(*env);
+}
+
+int32_t si_step(si_env* env, uint32_t actions, int32_t n_ticks)
+{
+    for (int32_t i = 0; i < n_ticks && env->sim.status == SimStatus::RUNNING; i++)
+    {
+        env->sim.step(actions, SI_TICK_SECONDS);
+    }
+    writeObservation(*env);
+    return (int32_t)env->sim.status;
+}
+
+si_batch* si_batch_create(const char* level_path, uint32_t count, uint32_t threads, uint64_t seed)
+{
+    std::shared_ptr<Level> level = loadApiLevel(level_path);
+    if (!level)
+    {
+        return nullptr;
+    }
+    si_batch* batch = new si_batch();
+    batch->batch.init(level, count, threads, seed);
+    return batch;
+}
+
+void si_batch_destroy(si_batch* batch)
+{
+    delete batch;
+}
+
+void si_batch_bind_observations(si_batch* batch, si_observation* observations)
+{
+    batch->observations = observations;
+    if (observations != nullptr)
+    {
+        for (std::size_t i = 0; i < batch->batch.size(); i++)
+        {
+            writeObservation(observations[i], *batch->batch.simulations[i]);
+        }
+    }
+}
+
+void si_batch_step(si_batch* batch, const uint32_t* actions, int32_t n_ticks, int32_t* statuses)
+{
+    // observations are written on the worker that stepped the env, while its data is still in cache
+    si_observation* observations = batch->observations;
+    batch->batch.step(actions, n_ticks, SI_TICK_SECONDS, [&](std::size_t i)
+        {
+            if (observations != nullptr)
+            {
+                writeObservation(observations[i], *batch->batch.simulations[i]);
+            }
+            if (statuses != nullptr)
+            {
+                statuses[i] = (int32_t)batch->batch.finished[i];
+            }
+        });
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * =================================
+ * SIMULATION C API
+ * =================================
+ *
+ * plain C entry points around the headless Simulation, built as spaceinvaders_sim.dll.
+ * meant for balance bots and learning agents driving the game from another language.
+ *
+ * observations go straight into buffers the caller owns: bind them once with
+ * si_bind_observation and every si_reset / si_step writes into them. nothing is copied
+ * out or allocated per step on the library side.
+ *
+ * python sketch (ctypes + numpy):
+ *
+ *     lib = ctypes.CDLL("spaceinvaders_sim.dll")
+ *     env = lib.si_create(None)
+ *     entities = numpy.zeros((256, 6), numpy.float32)   # matches si_entity
+ *     grid = numpy.zeros((84, 84), numpy.uint8)
+ *     obs = si_observation(entities.ctypes.data, 256, grid.ctypes.data, 84, 84)
+ *     lib.si_bind_observation(env, ctypes.byref(obs))
+ *     lib.si_reset(env, 42)
+ *     while lib.si_step(env, SI_ACTION_LEFT | SI_ACTION_FIRE_LASER, 4) == SI_STATUS_RUNNING: ...
+ */
+
+#if defined(_WIN32)
+#if defined(SI_BUILD_DLL)
+#define SI_API __declspec(dllexport)
+#else
+#define SI_API __declspec(dllimport)
+#endif
+#else
+#define SI_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* one tick of simulated time */
+#define SI_TICK_SECONDS (1.0f / 60.0f)
+
+/* action bits, or them together. held for every tick of a step */
+#define SI_ACTION_LEFT 1u
+#define SI_ACTION_RIGHT 2u
+#define SI_ACTION_FIRE_LASER 4u
+#define SI_ACTION_FIRE_MISSILES 8u
+#define SI_ACTION_FIRE_BEAM 16u
+
+/* match status, returned by si_step */
+#define SI_STATUS_RUNNING 0
+#define SI_STATUS_VICTORY 1
+#define SI_STATUS_GAME_OVER 2
+
+/* entity kinds. the occupancy grid stores kind + 1, 0 means an empty cell */
+#define SI_KIND_PLAYER 0
+#define SI_KIND_ENEMY 1
+#define SI_KIND_BOSS 2
+#define SI_KIND_PLAYER_PROJECTILE 3
+#define SI_KIND_ENEMY_PROJECTILE 4
+#define SI_KIND_POWERUP_SHIELD 5
+#define SI_KIND_POWERUP_FIRE 6
+
+/* arena coordinates, x and y are the center */
+typedef struct si_entity
+{
+    float x, y, w, h;
+    float kind;
+    float hp; /* ships only, 0 for everything else */
+} si_entity;
+
+typedef struct si_observation
+{
+    /* set by the caller. entities past the capacity are dropped, grid may be NULL */
+    si_entity* entities;
+    uint32_t entity_capacity;
+    uint8_t* grid; /* grid_width * grid_height cells, row major, covering the arena */
+    uint32_t grid_width;
+    uint32_t grid_height;
+
+    /* written by the library */
+    uint32_t entity_count;
+    int32_t score;
+    int32_t player_hp;
+    int32_t wave;
+    int32_t status;
+    uint64_t tick;
+} si_observation;
+
+typedef struct si_env si_env;
+
+/* level_path may be NULL for the default level. a compiled level path.lvl picks up the
+   bullet scripts in path.bullets. returns NULL if the level can't be loaded */
+SI_API si_env* si_create(const char* level_path);
+SI_API void si_destroy(si_env* env);
+
+/* the observation must stay alive until it is rebound or the env is destroyed */
+SI_API void si_bind_observation(si_env* env, si_observation* observation);
+
+/* starts a new match; the same seed and the same actions replay the same match */
+SI_API void si_reset(si_env* env, uint64_t seed);
+
+/* runs n_ticks ticks (fewer if the match ends), then writes the observation */
+SI_API int32_t si_step(si_env* env, uint32_t actions, int32_t n_ticks);
+
+/*
+ * batches: count independent envs in one process, stepped together across a thread pool.
+ * every env draws from its own seed stream and restarts by itself when its match ends.
+ */
+typedef struct si_batch si_batch;
+
+/* threads = 0 uses every core. returns NULL if the level can't be loaded */
+SI_API si_batch* si_batch_create(const char* level_path, uint32_t count, uint32_t threads, uint64_t seed);
+SI_API void si_batch_destroy(si_batch* batch);
+
+/* observations points at count si_observation, one per env, each with its own buffers */
+SI_API void si_batch_bind_observations(si_batch* batch, si_observation* observations);
+
+/*
+ * actions holds count action bitsets. statuses (count entries, may be NULL) receives
+ * SI_STATUS_VICTORY or SI_STATUS_GAME_OVER for envs whose match ended during this step,
+ * SI_STATUS_RUNNING otherwise. ended envs are already reset and observe their new match.
+ */
+SI_API void si_batch_step(si_batch* batch, const uint32_t* actions, int32_t n_ticks, int32_t* statuses);
+
+#ifdef __cplusplus
+}
+#endif
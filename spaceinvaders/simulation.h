@@ -0,0 +1,1820 @@
+#pragma once
+#include <SFML/System/Vector2.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <vector>
+#include <array>
+#include <span>
+#include <utility>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include <chrono>
+#include "ecs.h"
+#include "level.h"
+#include "collision.h"
+#include "spatial.h"
+#include "script.h"
+#include "timerwheel.h"
+#include "framearena.h"
+
+// =================================
+// SIMULATION
+// =================================
+
+// everything that decides the outcome of a match: ships, projectiles, waves, drops and
+// scoring. there is no window, texture, sound or keyboard in here; the game feeds it an
+// action bitset and a time step, then draws the World and plays the events it left behind.
+// the same code runs headless behind the C API in simapi.h.
+
+// arena bounds
+struct Config
+{
+    float minx = 300;
+    float maxx = 1300;
+    float miny = 50;
+    float maxy = 750;
+};
+
+// sprites are referred to by id; the game maps ids to loaded textures when drawing
+enum class TextureId
+{
+    PLAYER = 0,
+    LEFT_ENGINE = 1,
+    RIGHT_ENGINE = 2,
+    PLAYER_LASER = 3,
+    PLAYER_MISSILE = 4,
+    PLAYER_SHIELD = 5,
+    POWERUP_SHIELD = 6,
+    POWERUP_FIRE = 7,
+    ENEMY_LASER = 8,
+    ENEMY = 9,
+    BOSS = 10,
+    EXPLOSION = 11,
+    SCORE_ANIMATION = 12,
+    EXPLOSION_BLUE_1 = 13,
+    EXPLOSION_BLUE_2 = 14,
+    EXPLOSION_BLUE_3 = 15,
+    EXPLOSION_BLUE_4 = 16,
+    BACKGROUND = 17,
+    BACKGROUND_STARS = 18,
+    MENU_BACKGROUND = 19,
+    START_BUTTON = 20,
+    START_BUTTON_SELECTED = 21,
+    EXIT_BUTTON = 22,
+    EXIT_BUTTON_SELECTED = 23,
+    VICTORY = 24,
+    DEFEAT = 25,
+    COUNT = 26
+};
+
+// utility functions
+constexpr float pi = 3.141592f;
+
+inline float norm(sf::Vector2f v)
+{
+    return std::sqrt(v.x * v.x + v.y * v.y);
+}
+
+inline sf::Vector2f normalize(sf::Vector2f v)
+{
+    return v / norm(v);
+}
+
+inline sf::Vector2f lerp(sf::Vector2f A, sf::Vector2f B, float t)
+{
+    return A * (1 - t) + t * B;
+}
+
+inline sf::Vector2f bezier(std::vector<sf::Vector2f> poly, float t)
+{
+    sf::Vector2f result;
+    std::vector<std::vector<sf::Vector2f>> vectors;
+    vectors.push_back(poly);
+    for (int i = 0; i < poly.size(); i++)
+    {
+		std::vector<sf::Vector2f> v;
+        v.clear();
+        for (int j = 0; j < vectors[i].size() - 1; j++)
+        {
+            v.push_back(lerp(vectors[i][j], vectors[i][j + 1], t));
+        }
+        vectors.push_back(v);
+    }
+    return vectors[poly.size()-1][0];
+}
+
+// works on a copy of the points on the stack, paths are at most maxPathPoints long
+inline sf::Vector2f computeBezierPointDeCasteljau(const sf::Vector2f* points, int count, float t)
+{
+    sf::Vector2f controlPoints[maxPathPoints];
+    count = std::min(count, (int)maxPathPoints);
+    std::copy(points, points + count, controlPoints);
+    for (int i = count - 1; i > 0; i--)
+    {
+        for (int j = 0; j < i; j++)
+        {
+            controlPoints[j] = controlPoints[j] * (1 - t) + controlPoints[j + 1] * t;
+        }
+    }
+    return controlPoints[0];
+}
+
+// xorshift64*, one stream per simulation so a run replays exactly from its seed
+struct Rng
+{
+    std::uint64_t state{ 0x9E3779B97F4A7C15ull };
+
+    void seed(std::uint64_t seed)
+    {
+        this->state = seed ^ 0x9E3779B97F4A7C15ull;
+        if (this->state == 0)
+        {
+            this->state = 1;
+        }
+    }
+
+    std::uint32_t next()
+    {
+        this->state ^= this->state >> 12;
+        this->state ^= this->state << 25;
+        this->state ^= this->state >> 27;
+        return (std::uint32_t)((this->state * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+
+    // uniform-ish integer in [0, n)
+    int below(int n)
+    {
+        return (int)(this->next() % (std::uint32_t)n);
+    }
+};
+
+// one bit per input, held for the whole step
+enum SimAction : std::uint32_t
+{
+    ACTION_LEFT = 1,
+    ACTION_RIGHT = 2,
+    ACTION_FIRE_LASER = 4,
+    ACTION_FIRE_MISSILES = 8,
+    ACTION_FIRE_BEAM = 16
+};
+
+// co-op: every ship has its own inputs and cooldown, the match is shared
+const int maxPlayers = 2;
+
+enum class SimStatus
+{
+    RUNNING = 0,
+    VICTORY = 1,
+    GAME_OVER = 2
+};
+
+// things the presentation side reacts to with sounds, particles and animations.
+// the list is cleared at the start of every step
+struct SimEvent
+{
+    enum Type
+    {
+        PLAYER_LASER = 0,
+        PLAYER_MISSILES = 1,
+        ENEMY_LASER = 2,
+        ENEMY_HIT = 3,
+        ENEMY_KILLED = 4,
+        SHIELD_BROKEN = 5,
+        POWERUP_PICKUP = 6
+    };
+    Type type;
+    sf::Vector2f position;
+};
+
+// -------------------------------
+// components
+// -------------------------------
+
+// plain data, stored packed per type in the World. behaviour lives in the systems in Simulation.
+
+enum class Faction
+{
+    PLAYER = 0,
+    ENEMY = 1
+};
+
+enum class RenderLayer
+{
+    ENEMIES = 0,
+    ANIMATIONS = 1,
+    PLAYER_PROJECTILES = 2,
+    ENEMY_PROJECTILES = 3,
+    POWERUPS = 4,
+    PLAYER = 5,
+    COUNT = 6
+};
+
+struct Transform
+{
+    sf::Vector2f position;
+    sf::Vector2f size;
+
+    sf::FloatRect bounds() const
+    {
+        return sf::FloatRect(this->position - this->size / 2.0f, this->size);
+    }
+};
+
+struct Motion
+{
+    sf::Vector2f velocity;
+    sf::Vector2f acceleration;
+};
+
+struct Renderable
+{
+    TextureId texture;
+    RenderLayer layer;
+    sf::IntRect textureRect; // empty rect means the whole texture
+};
+
+struct Projectile
+{
+    int damage{ 100 };
+    Faction faction{ Faction::PLAYER };
+};
+
+// follows a bezier curve instead of integrating Motion. missiles keep extrapolating
+// the curve until they leave the arena, enemy dives stop at the end of it.
+// the control points are stored inline, spawning a missile doesn't allocate
+struct PathFollower
+{
+    sf::Vector2f path[maxPathPoints];
+    int pathLength{ 0 };
+    float currentTime{ 0.0f };
+    float totalTime{ 1.0f };
+    bool extrapolate{ false };
+    bool finished{ false };
+
+    // points past maxPathPoints are dropped
+    void setPath(const sf::Vector2f* points, std::size_t count)
+    {
+        this->pathLength = (int)std::min<std::size_t>(count, maxPathPoints);
+        std::copy(points, points + this->pathLength, this->path);
+    }
+};
+
+// where a projectile was at the start of the tick. collisions test the whole segment it
+// swept this tick, so fast shots can't tunnel through a ship between two frames
+struct SweptCollider
+{
+    sf::Vector2f previous;
+};
+
+// steers toward an enemy, turning at most turnRate radians a second. the target is picked
+// again (the nearest live enemy) every retargetTicks ticks, or as soon as it dies
+struct Homing
+{
+    Entity target;
+    float speed{ 300.0f };
+    float turnRate{ 4.0f };
+    int retargetTicks{ 6 };
+    int ticksLeft{ 0 };
+};
+
+// emits particles at a steady rate while the entity lives, e.g. missile exhaust
+struct ParticleTrail
+{
+    float rate{ 60.0f };
+    float accumulator{ 0.0f };
+};
+
+struct Powerup
+{
+    enum class PowerupTypes
+    {
+        SHIELD = 0,
+        FIRE = 1
+    };
+    PowerupTypes type;
+};
+
+struct Enemy
+{
+    int index{ 0 };
+    int hp{ 100 };
+    float speed{ 100.0f };
+    float descend{ 100.0f };
+    float minx, maxx;
+    // ships with a fire rate of their own (armEnemy) shoot on their own timer, on top of the
+    // formation's volleys. 0 for none
+    float fireRate{ 0.0f };
+    TimerId weapon{ nullTimer };
+
+    int hit(int damage)
+    {
+        this->hp -= damage;
+        return this->hp;
+    }
+};
+
+// what the simulation's timer wheel hands back when a timer comes due
+struct SimTimer
+{
+    enum Kind : std::uint32_t
+    {
+        COOLDOWN = 0,     // nothing to do, something is ready again once it stops pending
+        ENEMY_VOLLEY = 1, // the formation fires from a random ship
+        ENEMY_WEAPON = 2  // 'entity' fires its own weapon
+    };
+    std::uint32_t kind{ COOLDOWN };
+    Entity entity{ nullEntity };
+};
+
+struct Boss
+{
+    int maxHp{ 2000 };
+};
+
+// the grid enemies of a wave move as one block, so the block is what moves: one offset
+// and one velocity, bouncing 'bounce' to either side of where the wave spawned. members
+// only remember their spawn position and have no Motion of their own
+struct Formation
+{
+    sf::Vector2f offset;
+    sf::Vector2f velocity;
+    sf::Vector2f acceleration;
+    float bounce{ 0.0f };
+    float descend{ 0.0f };
+    // member Transforms are behind the offset until syncFormation writes them
+    bool dirty{ false };
+    // lowest member spawn y, for the end of tick check; recomputed when members leave
+    float bottom{ 0.0f };
+    std::size_t bottomMembers{ 0 };
+};
+
+struct FormationSlot
+{
+    sf::Vector2f home;
+};
+
+// units per second; the net client predicts its own ship with it too
+const float playerShipSpeed = 400.0f;
+
+struct Player
+{
+    int slot{ 0 };
+    std::uint32_t actions{ 0 };
+    // lasers and missiles are ready again when this stops pending
+    TimerId laserCooldown{ nullTimer };
+    bool powerupShield{ false };
+    bool powerupFire{ false };
+    bool leftEngineActive{ false }, rightEngineActive{ false };
+    float playerSpeed{ playerShipSpeed };
+    int hp{ 100 };
+    int laserDamage{ 100 };
+    int missileDamage{ 200 };
+    float playerLaserSpeed{ 400.0f };
+    float playerMissileSpeed{ 200.0f };
+    sf::Vector2f playerLaserSize{ 7.5f, 20.0f };
+    sf::Vector2f playerMissileSize{ 10.0f, 25.0f };
+    // the beam hits the first ship above the player every tick it is held, and deals its
+    // damage in beamTickDamage chunks. 'beam' is the entity that draws it
+    float beamDamagePerSecond{ 300.0f };
+    int beamTickDamage{ 25 };
+    float beamWidth{ 6.0f };
+    float beamCharge{ 0.0f };
+    Entity beam;
+
+    int hit(int damage)
+    {
+        if (this->powerupShield)
+        {
+            this->powerupShield = false;
+            this->powerupFire = false;
+        }
+        else
+        {
+            this->hp -= damage;
+        }
+        return this->hp;
+    }
+};
+
+// entity factories
+
+inline Entity spawnProjectile(World& world, sf::Vector2f position, sf::Vector2f velocity, TextureId texture, sf::Vector2f size, int damage, Faction faction)
+{
+    Entity e = world.create();
+    world.add(e, Transform{ position, size });
+    world.add(e, Motion{ velocity, { 0, 0 } });
+    world.add(e, Renderable{ texture, faction == Faction::PLAYER ? RenderLayer::PLAYER_PROJECTILES : RenderLayer::ENEMY_PROJECTILES });
+    world.add(e, Projectile{ damage, faction });
+    world.add(e, SweptCollider{ position });
+    return e;
+}
+
+// ===================================
+// FIRING PATTERNS
+// ===================================
+
+// a pattern is a constexpr table of shots. firePattern<id> expands its table at compile
+// time, one spawn per shot and no loop, so firing never allocates or makes a virtual
+// call and a 64 way radial costs the same per projectile as a single laser. the runtime
+// id picks the expansion through a switch:
+//   firePattern(FiringPatternId::LASER_BURST, world, arena, style, position);
+// the spawned entities go into an optional caller-owned span.
+
+// std::sin and std::cos aren't constexpr, the tables use these. good to double precision
+// for any angle the tables use
+constexpr double constSin(double x)
+{
+    const double twoPi = 6.283185307179586;
+    while (x > twoPi / 2)
+    {
+        x -= twoPi;
+    }
+    while (x < -twoPi / 2)
+    {
+        x += twoPi;
+    }
+    double term = x, sum = x;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constCos(double x)
+{
+    return constSin(x + 1.5707963267948966);
+}
+
+enum class FiringPatternId : std::uint8_t
+{
+    LASER_SINGLE = 0,
+    LASER_BURST = 1,
+    MISSILES = 2,
+    RADIAL_8 = 3,
+    RADIAL_16 = 4,
+    RADIAL_64 = 5,
+    HOMING_MISSILES = 6,
+    COUNT
+};
+
+// what the projectiles of a pattern look like and do. shots point up (-y); a negative
+// speed fires down, the way enemies shoot
+struct ProjectileStyle
+{
+    TextureId texture{ TextureId::PLAYER_LASER };
+    sf::Vector2f size{ 7.5f, 20.0f };
+    float speed{ 400.0f };
+    int damage{ 100 };
+    Faction faction{ Faction::PLAYER };
+};
+
+// one projectile: unit direction, speed relative to the style's, spawn offset from the shooter
+struct Shot
+{
+    float dx, dy;
+    float speed;
+    float offsetX, offsetY;
+};
+
+constexpr std::array<Shot, 1> singleLaserShots{ { { 0.0f, -1.0f, 1.0f, 0.0f, 0.0f } } };
+
+// straight ahead, plus two 15 degrees to either side
+constexpr std::array<Shot, 3> burstLaserShots{ {
+    { 0.0f, -1.0f, 1.0f, 0.0f, 0.0f },
+    { (float)constCos(5 * pi / 12), -(float)constSin(5 * pi / 12), 1.0f, 0.0f, 0.0f },
+    { -(float)constCos(5 * pi / 12), -(float)constSin(5 * pi / 12), 1.0f, 0.0f, 0.0f }
+} };
+
+// evenly spaced around the shooter, the first one straight ahead
+template <std::size_t N>
+constexpr std::array<Shot, N> radialShots()
+{
+    std::array<Shot, N> shots{};
+    for (std::size_t i = 0; i < N; i++)
+    {
+        double angle = 6.283185307179586 * i / N;
+        shots[i] = { (float)constSin(angle), -(float)constCos(angle), 1.0f, 0.0f, 0.0f };
+    }
+    return shots;
+}
+
+template <FiringPatternId id>
+constexpr auto patternShots()
+{
+    if constexpr (id == FiringPatternId::LASER_SINGLE)
+    {
+        return singleLaserShots;
+    }
+    else if constexpr (id == FiringPatternId::LASER_BURST)
+    {
+        return burstLaserShots;
+    }
+    else if constexpr (id == FiringPatternId::RADIAL_8)
+    {
+        return radialShots<8>();
+    }
+    else if constexpr (id == FiringPatternId::RADIAL_16)
+    {
+        return radialShots<16>();
+    }
+    else
+    {
+        static_assert(id == FiringPatternId::RADIAL_64, "pattern without a shot table");
+        return radialShots<64>();
+    }
+}
+
+// missiles follow bezier paths instead. a point is 'x' to the side of the shooter and
+// height * arena height + top * arena bottom above it
+struct MissilePoint
+{
+    float x, height, top;
+};
+
+struct MissilePath
+{
+    std::uint32_t length;
+    MissilePoint points[maxPathPoints];
+};
+
+// homing missiles leave in a fan and turn toward their targets from there
+constexpr std::array<Shot, 4> homingMissileShots{ {
+    { -(float)constCos(pi / 3), -(float)constSin(pi / 3), 1.0f, -12.0f, 0.0f },
+    { -(float)constCos(5 * pi / 12), -(float)constSin(5 * pi / 12), 1.0f, -4.0f, 0.0f },
+    { (float)constCos(5 * pi / 12), -(float)constSin(5 * pi / 12), 1.0f, 4.0f, 0.0f },
+    { (float)constCos(pi / 3), -(float)constSin(pi / 3), 1.0f, 12.0f, 0.0f }
+} };
+
+// two curling out to the right, their mirror images on the left
+constexpr std::array<MissilePath, 4> missilePaths{ {
+    { 6, { { 0.0f, 0.0f, 0.0f }, { 100.0f, 0.0f, 0.0f }, { 100.0f, 1.0f / 3, 0.0f }, { -100.0f, 1.0f / 3, 0.0f }, { -100.0f, 2.0f / 3, 0.0f }, { 100.0f, 0.0f, 1.0f } } },
+    { 4, { { 0.0f, 0.0f, 0.0f }, { 150.0f, 0.0f, 0.0f }, { 150.0f, 2.0f / 3, 0.0f }, { -150.0f, 0.0f, 1.0f } } },
+    { 6, { { 0.0f, 0.0f, 0.0f }, { -100.0f, 0.0f, 0.0f }, { -100.0f, 1.0f / 3, 0.0f }, { 100.0f, 1.0f / 3, 0.0f }, { 100.0f, 2.0f / 3, 0.0f }, { -100.0f, 0.0f, 1.0f } } },
+    { 4, { { 0.0f, 0.0f, 0.0f }, { -150.0f, 0.0f, 0.0f }, { -150.0f, 2.0f / 3, 0.0f }, { 150.0f, 0.0f, 1.0f } } }
+} };
+
+inline Entity spawnMissile(World& world, const Config& arena, const ProjectileStyle& style, sf::Vector2f position, const MissilePath& path)
+{
+    Entity e = world.create();
+    world.add(e, Transform{ position, style.size });
+    world.add(e, Renderable{ style.texture, style.faction == Faction::PLAYER ? RenderLayer::PLAYER_PROJECTILES : RenderLayer::ENEMY_PROJECTILES });
+    world.add(e, Projectile{ style.damage, style.faction });
+    PathFollower follower;
+    follower.pathLength = (int)path.length;
+    for (std::uint32_t i = 0; i < path.length; i++)
+    {
+        const MissilePoint& point = path.points[i];
+        follower.path[i] = position + sf::Vector2f(point.x, -(point.height * (arena.maxy - arena.miny) + point.top * arena.maxy));
+    }
+    follower.totalTime = std::fabs((arena.maxy - arena.miny) / style.speed);
+    follower.extrapolate = true;
+    world.add(e, follower);
+    world.add(e, ParticleTrail{});
+    world.add(e, SweptCollider{ position });
+    return e;
+}
+
+inline Entity spawnHomingMissile(World& world, const ProjectileStyle& style, sf::Vector2f position, sf::Vector2f direction)
+{
+    Entity e = spawnProjectile(world, position, direction * style.speed, style.texture, style.size, style.damage, style.faction);
+    Homing homing;
+    homing.speed = style.speed;
+    // spread the nearest enemy searches of a salvo over the ticks
+    homing.ticksLeft = (int)(e.index % homing.retargetTicks);
+    world.add(e, homing);
+    world.add(e, ParticleTrail{});
+    return e;
+}
+
+template <FiringPatternId id>
+std::size_t firePattern(World& world, const Config& arena, const ProjectileStyle& style, sf::Vector2f position, std::span<Entity> fired = {})
+{
+    std::size_t count = 0;
+    auto emit = [&](Entity e)
+        {
+            if (count < fired.size())
+            {
+                fired[count] = e;
+            }
+            count++;
+        };
+    if constexpr (id == FiringPatternId::MISSILES)
+    {
+        for (const MissilePath& path : missilePaths)
+        {
+            emit(spawnMissile(world, arena, style, position, path));
+        }
+    }
+    else if constexpr (id == FiringPatternId::HOMING_MISSILES)
+    {
+        for (const Shot& shot : homingMissileShots)
+        {
+            emit(spawnHomingMissile(world, style, position + sf::Vector2f(shot.offsetX, shot.offsetY), sf::Vector2f(shot.dx, shot.dy)));
+        }
+    }
+    else
+    {
+        static constexpr auto shots = patternShots<id>();
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            (emit(spawnProjectile(world, position + sf::Vector2f(shots[I].offsetX, shots[I].offsetY),
+                sf::Vector2f(shots[I].dx, shots[I].dy) * (style.speed * shots[I].speed), style.texture, style.size, style.damage, style.faction)), ...);
+        }(std::make_index_sequence<shots.size()>());
+    }
+    return count;
+}
+
+// returns how many projectiles the pattern spawned, the first fired.size() are stored there
+inline std::size_t firePattern(FiringPatternId id, World& world, const Config& arena, const ProjectileStyle& style, sf::Vector2f position, std::span<Entity> fired = {})
+{
+    switch (id)
+    {
+    case FiringPatternId::LASER_SINGLE:
+        return firePattern<FiringPatternId::LASER_SINGLE>(world, arena, style, position, fired);
+    case FiringPatternId::LASER_BURST:
+        return firePattern<FiringPatternId::LASER_BURST>(world, arena, style, position, fired);
+    case FiringPatternId::MISSILES:
+        return firePattern<FiringPatternId::MISSILES>(world, arena, style, position, fired);
+    case FiringPatternId::RADIAL_8:
+        return firePattern<FiringPatternId::RADIAL_8>(world, arena, style, position, fired);
+    case FiringPatternId::RADIAL_16:
+        return firePattern<FiringPatternId::RADIAL_16>(world, arena, style, position, fired);
+    case FiringPatternId::RADIAL_64:
+        return firePattern<FiringPatternId::RADIAL_64>(world, arena, style, position, fired);
+    case FiringPatternId::HOMING_MISSILES:
+        return firePattern<FiringPatternId::HOMING_MISSILES>(world, arena, style, position, fired);
+    default:
+        return 0;
+    }
+}
+
+// a ship may shoot when no ship of its own column is below it. formation members share a
+// column when their slots share an x; a ship out of the formation (a diver, a boss) is a
+// column of its own. one pass over the ships keeps the lowest member of every column in an
+// open addressing table, a second collects the lowest ones in pool order for the rng to
+// pick from, so a volley costs the same handful of steps per ship however many there are
+inline Entity randomEnemyFireImproved(World& world, Rng& rng, std::pmr::memory_resource* memory)
+{
+    const std::uint32_t empty = 0xFFFFFFFF;
+    ComponentPool<Enemy>& enemies = world.pool<Enemy>();
+    std::uint32_t count = (std::uint32_t)enemies.size();
+    int bits = 4;
+    while ((1u << bits) < count * 2)
+    {
+        bits++;
+    }
+    std::uint32_t capacity = 1u << bits;
+    FrameVector<std::uint32_t> lowest(capacity, empty, memory);
+    FrameVector<const FormationSlot*> slots(count, nullptr, memory);
+    auto column = [&](float x)
+        {
+            // fibonacci hashing on the top bits: the low bits of a whole number float are zeros
+            std::uint32_t key;
+            std::memcpy(&key, &x, sizeof(key));
+            std::uint32_t at = (key * 2654435769u) >> (32 - bits);
+            while (lowest[at] != empty && slots[lowest[at]]->home.x != x)
+            {
+                at = (at + 1) & (capacity - 1);
+            }
+            return at;
+        };
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        slots[i] = world.tryGet<FormationSlot>(enemies.entities[i]);
+        if (!slots[i])
+        {
+            continue;
+        }
+        std::uint32_t at = column(slots[i]->home.x);
+        // members move together, so the lowest home is the lowest ship
+        if (lowest[at] == empty || slots[i]->home.y > slots[lowest[at]]->home.y)
+        {
+            lowest[at] = i;
+        }
+    }
+
+    FrameVector<Entity> viable(memory);
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        if (!slots[i] || lowest[column(slots[i]->home.x)] == i)
+        {
+            viable.push_back(enemies.entities[i]);
+        }
+    }
+    int select = rng.below((int)viable.size());
+    return viable[select];
+}
+
+class Simulation
+{
+public:
+    // every ship, projectile and powerup lives here
+    World world;
+    std::vector<Entity> finishedPaths;
+    std::vector<SimEvent> events;
+    // scratch memory of a single tick, every step starts with it empty
+    FrameArena frameArena;
+    Rng rng;
+    SimStatus status{ SimStatus::RUNNING };
+    std::uint64_t tick{ 0 };
+
+    // game area boundaries
+    Config arena;
+    float minx, maxx, miny, maxy;
+
+    int score, scorePerKill;
+    float rateOfFire;
+    float enemyRateOfFire;
+    // cooldowns and shots at tick granularity, see SimTimer
+    TimerWheel<SimTimer> timers;
+
+    // players, set playerCount before reset
+    int playerCount{ 1 };
+    Entity players[maxPlayers];
+    ProjectileStyle playerLaser, playerMissile, enemyLaser;
+
+    // level and wave progress. the level is read only, so simulations can share one
+    std::shared_ptr<const Level> level;
+    // opaque texels of the ship textures, shared like the level. without them ships
+    // are hit anywhere inside their rectangle
+    std::shared_ptr<const CollisionMasks> masks;
+    int currentWave;
+    // the level timeline (levelScript) and whatever it starts. kills raise ENEMY_KILLED,
+    // a tick in which a boss took damage raises BOSS_DAMAGED
+    ScriptScheduler scripts;
+    bool bossDamaged{ false };
+
+    // enemy
+    Formation formation;
+    bool bossActive;
+    // the scripted boss attacks (bullets.h) running this match
+    BulletVM bullets;
+
+    // where the enemies and the projectiles are, for nearest / radius / box / segment
+    // queries. each grid is filled the first time it is asked for in a tick and holds
+    // the positions of that moment
+    SpatialGrid enemyGrid, projectileGrid;
+    std::uint64_t enemyGridTick{ 0 }, projectileGridTick{ 0 };
+
+    // loads the default level unless one was handed in already
+    bool loadDefaultLevel()
+    {
+        std::shared_ptr<Level> level = std::make_shared<Level>();
+        if (!loadLevel(*level, "level1"))
+        {
+            return false;
+        }
+        this->level = level;
+        return true;
+    }
+
+    // starts a new match. the same seed and the same actions give the same match
+    void reset(std::uint64_t seed)
+    {
+        this->rng.seed(seed);
+        this->status = SimStatus::RUNNING;
+        this->tick = 0;
+        this->events.clear();
+
+        // clear entities
+        this->world.clear();
+        this->finishedPaths.clear();
+
+        this->minx = this->arena.minx;
+        this->maxx = this->arena.maxx;
+        this->miny = this->arena.miny;
+        this->maxy = this->arena.maxy;
+
+        this->score = 0;
+        this->scorePerKill = 100;
+        this->rateOfFire = 0.25f;
+        this->enemyRateOfFire = 0.5f;
+        this->timers.clear();
+        this->timers.schedule(0, { SimTimer::ENEMY_VOLLEY, nullEntity });
+
+        // player entities, spread evenly along the bottom
+        this->playerCount = std::clamp(this->playerCount, 1, maxPlayers);
+        for (int i = 0; i < this->playerCount; i++)
+        {
+            this->players[i] = this->world.create();
+            float x = this->minx + (this->maxx - this->minx) * (i + 1) / (this->playerCount + 1);
+            this->world.add(this->players[i], Transform{ sf::Vector2f(x, this->maxy - 50.0f), { 50, 50 } });
+            this->world.add(this->players[i], Motion{});
+            this->world.add(this->players[i], Renderable{ TextureId::PLAYER, RenderLayer::PLAYER });
+            Player player;
+            player.slot = i;
+            this->world.add(this->players[i], player);
+        }
+        const Player& player = this->world.get<Player>(this->players[0]);
+
+        this->playerLaser = ProjectileStyle{ TextureId::PLAYER_LASER, player.playerLaserSize, player.playerLaserSpeed, player.laserDamage, Faction::PLAYER };
+        this->playerMissile = ProjectileStyle{ TextureId::PLAYER_MISSILE, player.playerMissileSize, player.playerMissileSpeed, player.missileDamage, Faction::PLAYER };
+        this->enemyLaser = ProjectileStyle{ TextureId::ENEMY_LASER, { 7.5f, 20.0f }, -400.0f, 100, Faction::ENEMY };
+
+        // enemy
+        this->formation = Formation();
+        this->bossActive = false;
+        this->bullets.clear();
+        this->bullets.script = this->level ? &this->level->bullets : nullptr;
+        sf::FloatRect area(this->minx, this->miny, this->maxx - this->minx, this->maxy - this->miny);
+        this->enemyGrid.setBounds(area, 64.0f);
+        this->projectileGrid.setBounds(area, 64.0f);
+        this->enemyGridTick = this->projectileGridTick = ~0ull;
+        this->currentWave = -1;
+        this->bossDamaged = false;
+        this->scripts.clear();
+        if (this->level)
+        {
+            this->scripts.start(this->levelScript());
+        }
+    }
+
+    // advances the match by dt seconds with the given inputs held down. in co-op these
+    // are the first player's, the others idle
+    SimStatus step(std::uint32_t actions, float dt)
+    {
+        std::uint32_t all[maxPlayers] = { actions };
+        return this->stepPlayers(all, dt);
+    }
+
+    // same, one action bitset per player
+    SimStatus stepPlayers(const std::uint32_t* actions, float dt)
+    {
+        this->events.clear();
+        this->frameArena.reset();
+        if (this->status != SimStatus::RUNNING)
+        {
+            return this->status;
+        }
+        this->tick++;
+
+        for (int i = 0; i < this->playerCount; i++)
+        {
+            Player& player = this->world.get<Player>(this->players[i]);
+            player.actions = actions[i];
+
+            // collision with world boundary
+            Transform& playerTransform = this->world.get<Transform>(this->players[i]);
+            if (playerTransform.bounds().left < this->minx)
+            {
+                playerTransform.position.x = this->minx + playerTransform.size.x / 2;
+            }
+            if (playerTransform.bounds().left + playerTransform.bounds().width > this->maxx)
+            {
+                playerTransform.position.x = this->maxx - playerTransform.size.x / 2;
+            }
+            this->playerFireSystem(player, playerTransform.position);
+        }
+
+        // checking projectile collision
+        this->projectileCollisionSystem();
+        this->beamSystem(dt);
+        // checking dead enemy ships
+        this->deadEnemySystem();
+        // out of bounds
+        this->outOfBoundsSystem();
+        // powerups
+        this->powerupPickupSystem();
+        // timers of the level scripts, boss phases
+        this->scripts.advance(dt);
+        if (this->bossDamaged)
+        {
+            this->bossDamaged = false;
+            this->scripts.raise(ScriptSignal::BOSS_DAMAGED);
+        }
+        // cooldowns, enemy lasers
+        this->timerSystem(dt);
+        this->bulletSystem(dt);
+
+        // movement
+        this->sweepSystem();
+        this->playerSystem(dt);
+        this->formationSystem(dt);
+        this->enemyMovementSystem(dt);
+        this->homingSystem(dt);
+        this->motionSystem(dt);
+        this->pathSystem(dt);
+
+        // check victory condition
+        if (this->world.count<Enemy>() == 0)
+        {
+            this->bossActive = false;
+            this->status = SimStatus::VICTORY;
+            return this->status;
+        }
+        // check defeat condition, co-op ships share their fate
+        for (int i = 0; i < this->playerCount; i++)
+        {
+            if (this->world.get<Player>(this->players[i]).hp <= 0)
+            {
+                this->status = SimStatus::GAME_OVER;
+                return this->status;
+            }
+        }
+        if (this->lowestEnemy() > this->maxy)
+        {
+            this->status = SimStatus::GAME_OVER;
+            return this->status;
+        }
+        return this->status;
+    }
+
+    // a hash of the match as it stands: counters, the random state, where everything is and
+    // how much health it has left. two runs with equal checksums at a tick are the same match
+    std::uint64_t checksum()
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const void* data, std::size_t size)
+            {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for (std::size_t i = 0; i < size; i++)
+                {
+                    hash = (hash ^ bytes[i]) * 1099511628211ull;
+                }
+            };
+        // member Transforms are behind when nothing drew the frame
+        this->syncFormation();
+        mix(&this->tick, sizeof(this->tick));
+        mix(&this->score, sizeof(this->score));
+        mix(&this->currentWave, sizeof(this->currentWave));
+        mix(&this->rng.state, sizeof(this->rng.state));
+        mix(&this->formation.offset, sizeof(this->formation.offset));
+        // slots and not generations, which carry on from the rounds before
+        this->world.each<Transform>([&](Entity e, Transform& transform)
+            {
+                mix(&e.index, sizeof(e.index));
+                mix(&transform.position, sizeof(transform.position));
+            });
+        this->world.each<Enemy>([&](Entity e, Enemy& enemy) { mix(&enemy.hp, sizeof(enemy.hp)); });
+        this->world.each<Player>([&](Entity e, Player& player) { mix(&player.hp, sizeof(player.hp)); });
+        return hash;
+    }
+
+    // debug victory trigger: kills every ship and skips the remaining waves
+    void clearAllWaves()
+    {
+        this->scripts.clear();
+        ComponentPool<Enemy>& enemies = this->world.pool<Enemy>();
+        for (int i = 0; i < enemies.size(); i++)
+        {
+            this->world.destroyLater(enemies.entities[i]);
+        }
+        this->world.flush();
+        if (this->level)
+        {
+            this->currentWave = (int)this->level->waveCount();
+        }
+    }
+
+    // -------------------------------
+    // level scripts
+    // -------------------------------
+
+    // the waves one after another. a wave's drops come as the ship count falls to their
+    // thresholds, and the next wave starts when the last ship is gone
+    ScriptTask levelScript()
+    {
+        for (int wave = 0; wave < (int)this->level->waveCount(); wave++)
+        {
+            this->startWave(wave);
+            const WaveRecord& record = this->level->waves[wave];
+            if (record.ship == WaveRecord::BOSS && record.phaseCount > 0)
+            {
+                this->scripts.start(this->bossScript(wave, this->world.pool<Boss>().entities[0]));
+            }
+            for (std::uint32_t i = 0; i < record.dropCount; i++)
+            {
+                const DropRecord& drop = this->level->drops[record.firstDrop + i];
+                co_await this->scripts.when(ScriptSignal::ENEMY_KILLED, [this, &drop]() { return this->world.count<Enemy>() <= drop.remaining; });
+                if (this->world.count<Enemy>() == 0)
+                {
+                    break;
+                }
+                this->dropItem(drop);
+            }
+            co_await this->scripts.when(ScriptSignal::ENEMY_KILLED, [this]() { return this->world.count<Enemy>() == 0; });
+        }
+    }
+
+    // boss phases switch fire rate and speed once the boss hp falls below their threshold
+    ScriptTask bossScript(int wave, Entity boss)
+    {
+        const WaveRecord& record = this->level->waves[wave];
+        int maxHp = this->world.get<Boss>(boss).maxHp;
+        for (std::uint32_t i = 0; i < record.phaseCount; i++)
+        {
+            const PhaseRecord& phase = this->level->phases[record.firstPhase + i];
+            co_await this->scripts.when(ScriptSignal::BOSS_DAMAGED, [this, boss, maxHp, &phase]()
+                {
+                    const Enemy* enemy = this->world.tryGet<Enemy>(boss);
+                    return !enemy || (float)enemy->hp / maxHp <= phase.hpFraction;
+                });
+            if (!this->world.has<Enemy>(boss))
+            {
+                co_return;
+            }
+            this->enterPhase(boss, phase);
+        }
+    }
+
+    void enterPhase(Entity boss, const PhaseRecord& phase)
+    {
+        this->enemyRateOfFire = phase.fireRate;
+        this->world.get<Enemy>(boss).speed = phase.speed;
+        if (Motion* motion = this->world.tryGet<Motion>(boss))
+        {
+            motion->velocity.x = motion->velocity.x < 0 ? -phase.speed : phase.speed;
+        }
+        // a phase's script replaces the attack of the one before
+        if (phase.script != 0)
+        {
+            this->bullets.stopOwnedBy(boss);
+            this->bullets.start(this->level->bullets.find(phase.script), boss, this->positionOf(boss));
+        }
+    }
+
+    // a powerup falls from a random ship, or a random ship leaves the grid for a dive
+    void dropItem(const DropRecord& drop)
+    {
+        this->syncFormation();
+        if (drop.kind == DropRecord::POWERUP)
+        {
+            Powerup::PowerupTypes type{ Powerup::PowerupTypes::SHIELD };
+            TextureId t = TextureId::POWERUP_SHIELD;
+            if (this->allShielded())
+            {
+                type = Powerup::PowerupTypes::FIRE;
+                t = TextureId::POWERUP_FIRE;
+            }
+            Entity e = randomEnemyFireImproved(this->world, this->rng, &this->frameArena);
+            Entity p = this->world.create();
+            this->world.add(p, Transform{ this->world.get<Transform>(e).position, { 30, 30 } });
+            this->world.add(p, Motion{ { 0, 100 }, { 0, 100 } });
+            this->world.add(p, Renderable{ t, RenderLayer::POWERUPS });
+            this->world.add(p, Powerup{ type });
+        }
+        else if (drop.kind == DropRecord::BONUS)
+        {
+            Entity e = randomEnemyFireImproved(this->world, this->rng, &this->frameArena);
+            this->changeEnemyMovement(e);
+            this->armEnemy(e, this->enemyRateOfFire);
+        }
+    }
+
+    // spawns every ship of a wave straight from the compiled level records
+    void startWave(int wave)
+    {
+        if (wave >= (int)this->level->waveCount())
+        {
+            return;
+        }
+        this->currentWave = wave;
+
+        const WaveRecord& record = this->level->waves[wave];
+        this->enemyRateOfFire = record.fireRate;
+        bool boss = record.ship == WaveRecord::BOSS;
+        this->formation = Formation();
+        this->formation.velocity = { record.speed, 0 };
+        this->formation.bounce = record.bounce;
+        this->formation.descend = record.descend;
+        for (std::uint32_t i = 0; i < record.slotCount; i++)
+        {
+            const SlotRecord& slot = this->level->slots[record.firstSlot + i];
+            sf::Vector2f position{ this->minx + slot.x, this->miny + slot.y };
+            Entity ship = this->world.create();
+            this->world.add(ship, Transform{ position, { record.sizeX, record.sizeY } });
+            // bosses move on their own, everyone else rides the formation
+            if (boss)
+            {
+                this->world.add(ship, Motion{ { record.speed, 0 }, { 0, 0 } });
+            }
+            else
+            {
+                this->world.add(ship, FormationSlot{ position });
+            }
+            this->world.add(ship, Renderable{ boss ? TextureId::BOSS : TextureId::ENEMY, RenderLayer::ENEMIES });
+            Enemy enemy;
+            enemy.index = (int)i;
+            enemy.hp = record.hp;
+            enemy.speed = record.speed;
+            enemy.descend = record.descend;
+            enemy.minx = position.x - record.bounce;
+            enemy.maxx = position.x + record.bounce;
+            this->world.add(ship, enemy);
+            if (boss)
+            {
+                this->world.add(ship, Boss{ record.hp });
+            }
+        }
+        this->bossActive = boss;
+    }
+
+    // -------------------------------
+    // systems
+    // -------------------------------
+
+    // IMMA FIRING MAH LAZOR
+    void playerFireSystem(Player& player, sf::Vector2f playerPosition)
+    {
+        if (player.actions & ACTION_FIRE_LASER)
+        {
+            if (!this->timers.pending(player.laserCooldown))
+            {
+                player.laserCooldown = this->timers.schedule(this->timers.ticksFor(this->rateOfFire), SimTimer{});
+                FiringPatternId pattern = player.powerupFire ? FiringPatternId::LASER_BURST : FiringPatternId::LASER_SINGLE;
+                firePattern(pattern, this->world, this->arena, this->playerLaser, playerPosition);
+                this->events.push_back({ SimEvent::PLAYER_LASER, playerPosition });
+            }
+        }
+        if (player.actions & ACTION_FIRE_MISSILES)
+        {
+            if (!this->timers.pending(player.laserCooldown))
+            {
+                player.laserCooldown = this->timers.schedule(this->timers.ticksFor(this->rateOfFire), SimTimer{});
+                FiringPatternId pattern = player.powerupFire ? FiringPatternId::HOMING_MISSILES : FiringPatternId::MISSILES;
+                firePattern(pattern, this->world, this->arena, this->playerMissile, playerPosition);
+                this->events.push_back({ SimEvent::PLAYER_MISSILES, playerPosition });
+            }
+        }
+    }
+
+    void playerSystem(float dt)
+    {
+        this->world.each<Player, Motion>([](Entity e, Player& player, Motion& motion)
+            {
+                motion.velocity = { 0, 0 };
+                if (player.actions & ACTION_LEFT)
+                {
+                    player.rightEngineActive = true;
+                    motion.velocity = { -player.playerSpeed, 0 };
+                }
+                else
+                {
+                    player.rightEngineActive = false;
+                }
+                if (player.actions & ACTION_RIGHT)
+                {
+                    player.leftEngineActive = true;
+                    motion.velocity = { player.playerSpeed, 0 };
+                }
+                else
+                {
+                    player.leftEngineActive = false;
+                }
+            });
+    }
+
+    // remembers where every projectile starts the tick, before anything moves it
+    void sweepSystem()
+    {
+        this->world.each<SweptCollider, Transform>([](Entity e, SweptCollider& swept, Transform& transform)
+            {
+                swept.previous = transform.position;
+            });
+    }
+
+    void motionSystem(float dt)
+    {
+        this->world.each<Motion, Transform>([dt](Entity e, Motion& motion, Transform& transform)
+            {
+                motion.velocity += motion.acceleration * dt;
+                transform.position += motion.velocity * dt;
+            });
+    }
+
+    void pathSystem(float dt)
+    {
+        this->world.each<PathFollower, Transform>([this, dt](Entity e, PathFollower& follower, Transform& transform)
+            {
+                follower.currentTime += dt;
+                transform.position = computeBezierPointDeCasteljau(follower.path, follower.pathLength, follower.currentTime / follower.totalTime);
+                if (follower.currentTime > follower.totalTime && !follower.extrapolate)
+                {
+                    this->finishedPaths.push_back(e);
+                }
+            });
+
+        // enemies that finished their dive rejoin the grid
+        for (int i = 0; i < this->finishedPaths.size(); i++)
+        {
+            Entity e = this->finishedPaths[i];
+            this->world.remove<PathFollower>(e);
+            if (Enemy* enemy = this->world.tryGet<Enemy>(e))
+            {
+                this->world.add(e, Motion{ { enemy->speed, 0 }, { 0, 0 } });
+            }
+        }
+        this->finishedPaths.clear();
+    }
+
+    // the formation bounces between its bounds and steps down on every bounce, the same
+    // rule single ships follow below
+    void formationSystem(float dt)
+    {
+        Formation& formation = this->formation;
+        if (this->world.count<FormationSlot>() == 0)
+        {
+            return;
+        }
+        if (formation.offset.x < -formation.bounce || formation.offset.x > formation.bounce)
+        {
+            formation.velocity = { -formation.velocity.x, formation.descend };
+            formation.acceleration.y = -formation.descend;
+        }
+        if (formation.velocity.y < 0)
+        {
+            formation.velocity.y = 0.0f;
+            formation.acceleration.y = 0.0f;
+        }
+        formation.velocity += formation.acceleration * dt;
+        formation.offset += formation.velocity * dt;
+        formation.dirty = true;
+    }
+
+    // the world position pass for formation members. only readers that walk many ship
+    // Transforms at once need it (drawing, observations, picking a shooter)
+    void syncFormation()
+    {
+        if (!this->formation.dirty)
+        {
+            return;
+        }
+        sf::Vector2f offset = this->formation.offset;
+        this->world.each<FormationSlot, Transform>([offset](Entity e, FormationSlot& slot, Transform& transform)
+            {
+                transform.position = slot.home + offset;
+            });
+        this->formation.dirty = false;
+    }
+
+    sf::Vector2f positionOf(Entity e)
+    {
+        if (FormationSlot* slot = this->world.tryGet<FormationSlot>(e))
+        {
+            return slot->home + this->formation.offset;
+        }
+        return this->world.get<Transform>(e).position;
+    }
+
+    sf::FloatRect boundsOf(Entity e)
+    {
+        sf::Vector2f size = this->world.get<Transform>(e).size;
+        return sf::FloatRect(this->positionOf(e) - size / 2.0f, size);
+    }
+
+    // how far down the lowest ship is; the formation answers for all its members at once
+    float lowestEnemy()
+    {
+        Formation& formation = this->formation;
+        if (formation.bottomMembers != this->world.count<FormationSlot>())
+        {
+            formation.bottomMembers = this->world.count<FormationSlot>();
+            formation.bottom = -std::numeric_limits<float>::max();
+            this->world.each<FormationSlot>([&](Entity e, FormationSlot& slot)
+                {
+                    formation.bottom = std::max(formation.bottom, slot.home.y);
+                });
+        }
+        float lowest = formation.bottomMembers > 0 ? formation.bottom + formation.offset.y : -std::numeric_limits<float>::max();
+        this->world.each<Motion, Enemy, Transform>([&](Entity e, Motion& motion, Enemy& enemy, Transform& transform)
+            {
+                lowest = std::max(lowest, transform.position.y);
+            });
+        this->world.each<PathFollower, Enemy, Transform>([&](Entity e, PathFollower& follower, Enemy& enemy, Transform& transform)
+            {
+                lowest = std::max(lowest, transform.position.y);
+            });
+        return lowest;
+    }
+
+    // ships out of the formation (bosses, bonus ships back from their dive) bounce between
+    // their own bounds
+    void enemyMovementSystem(float dt)
+    {
+        this->world.each<Motion, Enemy, Transform>([](Entity e, Motion& motion, Enemy& enemy, Transform& transform)
+            {
+                if (transform.position.x < enemy.minx || transform.position.x > enemy.maxx)
+                {
+                    motion.velocity = { -motion.velocity.x, enemy.descend };
+                    motion.acceleration.y = -enemy.descend;
+                }
+                if (motion.velocity.y < 0)
+                {
+                    motion.velocity.y = 0.0f;
+                    motion.acceleration.y = 0.0f;
+                }
+            });
+    }
+
+    // rectangle test first, then ships with a mask need an opaque texel under the shot
+    bool sweptHit(const SweptCollider& swept, const Transform& projectile, Entity target, float& t)
+    {
+        sf::FloatRect bounds = this->boundsOf(target);
+        if (!segmentIntersectsRect(swept.previous, projectile.position, bounds, t))
+        {
+            return false;
+        }
+        if (!this->masks)
+        {
+            return true;
+        }
+        Renderable* renderable = this->world.tryGet<Renderable>(target);
+        const CollisionMask* mask = renderable ? this->masks->get((int)renderable->texture) : nullptr;
+        return mask == nullptr || mask->sweep(bounds, swept.previous, projectile.position, projectile.size.x / 2, t);
+    }
+
+    SpatialGrid& enemyIndex()
+    {
+        if (this->enemyGridTick != this->tick)
+        {
+            this->enemyGridTick = this->tick;
+            this->enemyGrid.clear();
+            ComponentPool<Enemy>& enemies = this->world.pool<Enemy>();
+            for (std::size_t i = 0; i < enemies.size(); i++)
+            {
+                this->enemyGrid.insert(enemies.entities[i], this->boundsOf(enemies.entities[i]));
+            }
+            this->enemyGrid.build();
+        }
+        return this->enemyGrid;
+    }
+
+    SpatialGrid& projectileIndex()
+    {
+        if (this->projectileGridTick != this->tick)
+        {
+            this->projectileGridTick = this->tick;
+            this->projectileGrid.clear();
+            this->world.each<Projectile, Transform>([this](Entity e, Projectile& projectile, Transform& transform)
+                {
+                    this->projectileGrid.insert(e, transform.bounds());
+                });
+            this->projectileGrid.build();
+        }
+        return this->projectileGrid;
+    }
+
+    void projectileCollisionSystem()
+    {
+        SpatialGrid& enemies = this->enemyIndex();
+
+        this->world.each<Projectile, Transform, SweptCollider>([&](Entity e, Projectile& projectile, Transform& transform, SweptCollider& swept)
+            {
+                float t;
+                if (projectile.faction == Faction::PLAYER)
+                {
+                    // a shot crossing several ships this tick hits the one it reached first
+                    SpatialHit hit;
+                    bool hitShip = enemies.firstHit(swept.previous, transform.position, hit, [&](Entity ship, float& t)
+                        {
+                            return this->sweptHit(swept, transform, ship, t);
+                        });
+                    if (hitShip)
+                    {
+                        this->damageEnemy(hit.entity, projectile.damage);
+                        this->events.push_back({ SimEvent::ENEMY_HIT, lerp(swept.previous, transform.position, hit.t) });
+                        this->world.destroyLater(e);
+                    }
+                }
+                else
+                {
+                    for (int i = 0; i < this->playerCount; i++)
+                    {
+                        if (!this->sweptHit(swept, transform, this->players[i], t))
+                        {
+                            continue;
+                        }
+                        Player& player = this->world.get<Player>(this->players[i]);
+                        bool shielded = player.powerupShield;
+                        player.hit(projectile.damage);
+                        if (shielded && !player.powerupShield)
+                        {
+                            this->events.push_back({ SimEvent::SHIELD_BROKEN, this->world.get<Transform>(this->players[i]).position });
+                        }
+                        this->world.destroyLater(e);
+                        break;
+                    }
+                }
+            });
+        this->world.flush();
+    }
+
+    // a held beam runs from the player's nose to the first ship above it, or to the top
+    void beamSystem(float dt)
+    {
+        for (int i = 0; i < this->playerCount; i++)
+        {
+            Player& player = this->world.get<Player>(this->players[i]);
+            if (!(player.actions & ACTION_FIRE_BEAM))
+            {
+                if (this->world.alive(player.beam))
+                {
+                    this->world.destroy(player.beam);
+                }
+                player.beam = nullEntity;
+                player.beamCharge = 0.0f;
+                continue;
+            }
+            // no lasers or missiles while the beam is on
+            std::uint32_t cooldown = this->timers.ticksFor(this->rateOfFire);
+            if (this->timers.remaining(player.laserCooldown) < cooldown)
+            {
+                player.laserCooldown = this->timers.restart(player.laserCooldown, cooldown, SimTimer{});
+            }
+
+            const Transform& ship = this->world.get<Transform>(this->players[i]);
+            sf::Vector2f start = ship.position - sf::Vector2f(0.0f, ship.size.y / 2);
+            sf::Vector2f end(start.x, this->miny);
+            SpatialHit hit;
+            if (this->enemyIndex().firstHit(start, end, hit, [this](Entity e, float& t) { return this->world.has<Enemy>(e); }))
+            {
+                end = lerp(start, end, hit.t);
+                player.beamCharge += player.beamDamagePerSecond * dt;
+                while (player.beamCharge >= player.beamTickDamage)
+                {
+                    player.beamCharge -= player.beamTickDamage;
+                    this->damageEnemy(hit.entity, player.beamTickDamage);
+                    this->events.push_back({ SimEvent::ENEMY_HIT, end });
+                }
+            }
+            else
+            {
+                player.beamCharge = 0.0f;
+            }
+
+            if (!this->world.alive(player.beam))
+            {
+                player.beam = this->world.create();
+                this->world.add(player.beam, Transform{});
+                this->world.add(player.beam, Renderable{ TextureId::PLAYER_LASER, RenderLayer::PLAYER_PROJECTILES });
+            }
+            Transform& beam = this->world.get<Transform>(player.beam);
+            beam.position = (start + end) / 2.0f;
+            beam.size = { player.beamWidth, std::max(start.y - end.y, 1.0f) };
+        }
+    }
+
+    // homing missiles turn their velocity toward their target
+    void homingSystem(float dt)
+    {
+        this->world.each<Homing, Motion, Transform>([&](Entity e, Homing& homing, Motion& motion, Transform& transform)
+            {
+                if (--homing.ticksLeft <= 0 || !this->world.has<Enemy>(homing.target))
+                {
+                    homing.ticksLeft = homing.retargetTicks;
+                    Entity nearest[1] = { nullEntity };
+                    this->enemyIndex().nearest(transform.position, nearest, [this](Entity ship) { return this->world.has<Enemy>(ship); });
+                    homing.target = nearest[0];
+                }
+                if (!this->world.has<Enemy>(homing.target))
+                {
+                    return;
+                }
+                sf::Vector2f to = this->positionOf(homing.target) - transform.position;
+                float heading = std::atan2(motion.velocity.y, motion.velocity.x);
+                float turn = std::atan2(to.y, to.x) - heading;
+                turn = std::remainder(turn, 2 * pi);
+                heading += std::clamp(turn, -homing.turnRate * dt, homing.turnRate * dt);
+                motion.velocity = sf::Vector2f(std::cos(heading), std::sin(heading)) * homing.speed;
+            });
+    }
+
+    void outOfBoundsSystem()
+    {
+        this->world.each<Projectile, Transform>([this](Entity e, Projectile& projectile, Transform& transform)
+            {
+                if (transform.position.y + transform.size.y / 2 < this->miny
+                    || transform.position.y - transform.size.y / 2 > this->maxy
+                    || transform.position.x < this->minx
+                    || transform.position.x > this->maxx)
+                {
+                    this->world.destroyLater(e);
+                }
+            });
+        this->world.each<Powerup, Transform>([this](Entity e, Powerup& powerup, Transform& transform)
+            {
+                if (transform.position.y > this->maxy)
+                {
+                    this->world.destroyLater(e);
+                }
+            });
+        this->world.flush();
+    }
+
+    void powerupPickupSystem()
+    {
+        this->world.each<Powerup, Transform>([&](Entity e, Powerup& powerup, Transform& transform)
+            {
+                for (int i = 0; i < this->playerCount; i++)
+                {
+                    if (this->world.get<Transform>(this->players[i]).bounds().contains(transform.position))
+                    {
+                        Player& player = this->world.get<Player>(this->players[i]);
+                        if (player.powerupShield)
+                        {
+                            player.powerupFire = true;
+                        }
+                        player.powerupShield = true;
+                        this->events.push_back({ SimEvent::POWERUP_PICKUP, transform.position });
+                        this->world.destroyLater(e);
+                        break;
+                    }
+                }
+            });
+        this->world.flush();
+    }
+
+    void damageEnemy(Entity ship, int damage)
+    {
+        this->world.get<Enemy>(ship).hit(damage);
+        this->bossDamaged = this->bossDamaged || this->world.has<Boss>(ship);
+    }
+
+    void deadEnemySystem()
+    {
+        std::uint32_t kills = 0;
+        this->world.each<Enemy>([&](Entity e, Enemy& enemy)
+            {
+                if (enemy.hp <= 0)
+                {
+                    this->events.push_back({ SimEvent::ENEMY_KILLED, this->positionOf(e) });
+                    this->score += this->scorePerKill;
+                    this->timers.cancel(enemy.weapon);
+                    this->world.destroyLater(e);
+                    kills++;
+                }
+            });
+        this->world.flush();
+        // drops and the next wave
+        if (kills > 0)
+        {
+            this->scripts.raise(ScriptSignal::ENEMY_KILLED, kills);
+        }
+    }
+
+    // what the bullet scripts see of the match: emitters ride their ship, aim at the
+    // nearest player and fire enemy lasers
+    struct BulletHost
+    {
+        Simulation& sim;
+
+        bool ownerPosition(Entity owner, sf::Vector2f& position)
+        {
+            if (!this->sim.world.alive(owner))
+            {
+                return false;
+            }
+            position = this->sim.positionOf(owner);
+            return true;
+        }
+
+        sf::Vector2f aimTarget(sf::Vector2f from)
+        {
+            sf::Vector2f target = from + sf::Vector2f(0.0f, 1.0f);
+            float best = std::numeric_limits<float>::max();
+            for (int i = 0; i < this->sim.playerCount; i++)
+            {
+                sf::Vector2f position = this->sim.world.get<Transform>(this->sim.players[i]).position;
+                float distance = norm(position - from);
+                if (distance < best)
+                {
+                    best = distance;
+                    target = position;
+                }
+            }
+            return target;
+        }
+
+        bool inside(sf::Vector2f position)
+        {
+            return position.x >= this->sim.minx && position.x <= this->sim.maxx && position.y >= this->sim.miny && position.y <= this->sim.maxy;
+        }
+
+        void fire(sf::Vector2f position, sf::Vector2f velocity, sf::Vector2f acceleration)
+        {
+            const ProjectileStyle& style = this->sim.enemyLaser;
+            Entity e = spawnProjectile(this->sim.world, position, velocity, style.texture, style.size, style.damage, style.faction);
+            this->sim.world.get<Motion>(e).acceleration = acceleration;
+        }
+    };
+
+    void bulletSystem(float dt)
+    {
+        if (this->bullets.emitters.empty())
+        {
+            return;
+        }
+        BulletHost host{ *this };
+        this->bullets.update(dt, host);
+    }
+
+    // runs the timers that came due: cooldowns end, the formation and the ships with weapons
+    // of their own fire
+    void timerSystem(float dt)
+    {
+        this->timers.advance(dt, [this](const SimTimer& timer)
+            {
+                if (timer.kind == SimTimer::ENEMY_VOLLEY)
+                {
+                    this->enemyVolley();
+                }
+                else if (timer.kind == SimTimer::ENEMY_WEAPON)
+                {
+                    this->enemyWeaponFire(timer.entity);
+                }
+            });
+    }
+
+    // one laser from a random ship every enemyRateOfFire seconds, as soon as there are ships
+    void enemyVolley()
+    {
+        if (this->world.count<Enemy>() == 0)
+        {
+            this->timers.schedule(0, { SimTimer::ENEMY_VOLLEY, nullEntity });
+            return;
+        }
+        this->timers.schedule(this->timers.ticksFor(this->enemyRateOfFire), { SimTimer::ENEMY_VOLLEY, nullEntity });
+        this->syncFormation();
+        Entity shooter = randomEnemyFireImproved(this->world, this->rng, &this->frameArena);
+        firePattern<FiringPatternId::LASER_SINGLE>(this->world, this->arena, this->enemyLaser, this->world.get<Transform>(shooter).position);
+        this->events.push_back({ SimEvent::ENEMY_LASER, this->world.get<Transform>(shooter).position });
+    }
+
+    // gives a ship a weapon of its own that fires every 'fireRate' seconds while it lives
+    void armEnemy(Entity ship, float fireRate)
+    {
+        Enemy& enemy = this->world.get<Enemy>(ship);
+        enemy.fireRate = fireRate;
+        enemy.weapon = this->timers.restart(enemy.weapon, this->timers.ticksFor(fireRate), { SimTimer::ENEMY_WEAPON, ship });
+    }
+
+    void enemyWeaponFire(Entity ship)
+    {
+        Enemy* enemy = this->world.tryGet<Enemy>(ship);
+        if (!enemy || enemy->fireRate <= 0.0f)
+        {
+            return;
+        }
+        enemy->weapon = this->timers.schedule(this->timers.ticksFor(enemy->fireRate), { SimTimer::ENEMY_WEAPON, ship });
+        sf::Vector2f position = this->positionOf(ship);
+        firePattern<FiringPatternId::LASER_SINGLE>(this->world, this->arena, this->enemyLaser, position);
+        this->events.push_back({ SimEvent::ENEMY_LASER, position });
+    }
+
+    // bonus enemies leave the grid and swoop down along a bezier curve
+    void changeEnemyMovement(Entity ship)
+    {
+        Enemy& enemy = this->world.get<Enemy>(ship);
+        sf::Vector2f position = this->positionOf(ship);
+        // the ship leaves the formation where it currently is
+        this->world.get<Transform>(ship).position = position;
+        this->world.remove<FormationSlot>(ship);
+        FrameVector<sf::Vector2f> path(&this->frameArena);
+        int divePath = this->level->waves[this->currentWave].divePath;
+        if (divePath >= 0)
+        {
+            // level paths are drawn for a ship on the left side, mirror them on the right
+            const PathRecord& record = this->level->paths[divePath];
+            float mirror = position.x - enemy.minx > enemy.maxx - position.x ? 1.0f : -1.0f;
+            for (std::uint32_t i = 0; i < record.pointCount; i++)
+            {
+                const PointRecord& point = this->level->points[record.firstPoint + i];
+                path.push_back({ position.x + mirror * point.x, position.y + point.y });
+            }
+        }
+        else if (position.x - enemy.minx > enemy.maxx - position.x)
+        {
+            path.push_back(position);
+            path.push_back({ position.x, this->maxy / 2 });
+            path.push_back({ enemy.minx, this->maxy / 2 });
+            path.push_back({ enemy.minx, position.y });
+        }
+        else
+        {
+            path.push_back(position);
+            path.push_back({ position.x, this->maxy / 2 });
+            path.push_back({ enemy.maxx, this->maxy / 2 });
+            path.push_back({ enemy.maxx, position.y });
+        }
+        PathFollower follower;
+        follower.setPath(path.data(), path.size());
+        follower.totalTime = std::fabs((enemy.maxx - enemy.minx) / enemy.speed);
+        this->world.remove<Motion>(ship);
+        this->world.add(ship, follower);
+    }
+
+    bool allShielded()
+    {
+        for (int i = 0; i < this->playerCount; i++)
+        {
+            if (!this->world.get<Player>(this->players[i]).powerupShield)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// --bench-sim: steps one headless simulation with random inputs, restarting finished matches
+inline void benchmarkSimulation(std::uint64_t ticks)
+{
+    Simulation sim;
+    if (!sim.loadDefaultLevel())
+    {
+        return;
+    }
+    sim.reset(1);
+    Rng inputs;
+    std::uint32_t action = 0;
+    std::uint64_t matches = 1;
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < ticks; i++)
+    {
+        // hold each random input for a few ticks, like a player would
+        if (i % 8 == 0)
+        {
+            action = inputs.next() & 0xF;
+        }
+        if (sim.step(action, 1.0f / 60.0f) != SimStatus::RUNNING)
+        {
+            sim.reset(++matches);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "ticks: " << ticks << ", matches: " << matches << std::endl;
+    std::cout << "time: " << seconds * 1000.0 << " ms, " << ticks / seconds << " ticks/s, " << ticks / seconds * 60.0 / 1e6 << " million ticks/min" << std::endl;
+}
+
+// --bench-formation: one wave of 'ships' grid enemies firing a volley every half second,
+// so the tick is enemy movement plus picking a shooter among every ship. the worst tick is
+// a volley tick. the world position pass is timed separately, it only runs when a frame or
+// an observation is produced
+inline void benchmarkFormation(int ships, int ticks)
+{
+    int columns = 100;
+    std::stringstream text;
+    text << "wave\n ship enemy\n size 4 4\n hp 100\n speed 100\n descend 0\n bounce 200\n fire_rate 0.5\n origin 300 20\n";
+    text << " grid " << columns << " " << (ships + columns - 1) / columns << " 4 4\nend\n";
+    LevelCompiler compiler;
+    std::shared_ptr<Level> level = std::make_shared<Level>();
+    if (!compiler.compile(text) || !level->loadFromMemory(compiler.serialize()))
+    {
+        std::cout << "formation level: " << compiler.error << std::endl;
+        return;
+    }
+    Simulation sim;
+    sim.level = level;
+    sim.reset(1);
+
+    double stepSeconds = 0.0, worstSeconds = 0.0;
+    for (int i = 0; i < ticks; i++)
+    {
+        auto tickStart = std::chrono::steady_clock::now();
+        sim.step(0, 1.0f / 60.0f);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tickStart).count();
+        stepSeconds += seconds;
+        worstSeconds = std::max(worstSeconds, seconds);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ticks; i++)
+    {
+        sim.formation.dirty = true;
+        sim.syncFormation();
+    }
+    double syncSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "ships: " << sim.world.count<Enemy>() << ", tick: " << stepSeconds / ticks * 1e6 << " us, worst tick: " << worstSeconds * 1e6 << " us, world position pass: " << syncSeconds / ticks * 1e6 << " us" << std::endl;
+}
+
+// --bench-patterns: fires each pattern 'shots' times into a world that is emptied every
+// 64 shots, so the pools stay warm. reports the cost per shot and per projectile
+inline void benchmarkFiringPatterns(int shots)
+{
+    const char* names[(int)FiringPatternId::COUNT] = { "single laser", "burst laser", "missiles", "radial 8", "radial 16", "radial 64", "homing missiles" };
+    Config arena;
+    ProjectileStyle style;
+    for (int id = 0; id < (int)FiringPatternId::COUNT; id++)
+    {
+        World world;
+        std::size_t projectiles = 0;
+        double seconds = 0.0;
+        for (int fired = 0; fired < shots; )
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < 64 && fired < shots; i++, fired++)
+            {
+                projectiles += firePattern((FiringPatternId)id, world, arena, style, { 800.0f, 400.0f });
+            }
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            world.clear();
+        }
+        std::cout << names[id] << ": " << seconds / shots * 1e9 << " ns per shot, " << seconds / projectiles * 1e9 << " ns per projectile" << std::endl;
+    }
+}
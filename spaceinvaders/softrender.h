@@ -0,0 +1,391 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include "render.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SOFTRENDER_SSE 1
+#endif
+
+// =================================
+// SOFTWARE RENDERER
+// =================================
+
+// rasterizes the game on the CPU into an RGBA framebuffer, no window, OpenGL context or
+// display needed. textures are loaded as sf::Image, which is plain memory.
+// a world rectangle ('view') is mapped onto the framebuffer, so the same scene renders at
+// 1600x800 for screenshots or squashed down to 84x84 for agent observations.
+// pixels are RGBA8 with red in the lowest byte (same layout as sf::Image); the framebuffer
+// is always opaque. text is skipped, there is no font rasterizer.
+
+class SoftwareRenderer : public RenderBackend
+{
+public:
+    enum class Sampling
+    {
+        NEAREST = 0,
+        BILINEAR = 1
+    };
+
+    struct Image
+    {
+        int width{ 0 };
+        int height{ 0 };
+        std::vector<std::uint32_t> pixels;
+    };
+
+    int width{ 0 };
+    int height{ 0 };
+    std::vector<std::uint32_t> pixels;
+    sf::FloatRect view;
+    float scaleX{ 1.0f }, scaleY{ 1.0f };
+    Sampling sampling{ Sampling::NEAREST };
+    std::vector<Image> textures;
+    std::vector<std::uint32_t> span; // one row of source pixels waiting to be blended
+
+    void resize(int width, int height, sf::FloatRect view)
+    {
+        this->width = width;
+        this->height = height;
+        this->view = view;
+        this->scaleX = width / view.width;
+        this->scaleY = height / view.height;
+        this->pixels.assign((std::size_t)width * height, 0xFF000000);
+        this->span.resize(width);
+    }
+
+    // same files as the window textures, see textureFile in render.h
+    bool loadTextures()
+    {
+        this->textures.assign((int)TextureId::COUNT, Image());
+        bool ok = true;
+        for (int i = 0; i < (int)TextureId::COUNT; i++)
+        {
+            sf::Image image;
+            if (!image.loadFromFile(textureFile((TextureId)i)))
+            {
+                ok = false;
+                continue;
+            }
+            this->setTexture((TextureId)i, image);
+        }
+        return ok;
+    }
+
+    void setTexture(TextureId id, const sf::Image& image)
+    {
+        Image& texture = this->textures[(int)id];
+        texture.width = (int)image.getSize().x;
+        texture.height = (int)image.getSize().y;
+        texture.pixels.resize((std::size_t)texture.width * texture.height);
+        if (!texture.pixels.empty())
+        {
+            std::memcpy(texture.pixels.data(), image.getPixelsPtr(), texture.pixels.size() * 4);
+        }
+    }
+
+    bool saveToFile(const std::string& filename) const
+    {
+        sf::Image image;
+        image.create(this->width, this->height, reinterpret_cast<const sf::Uint8*>(this->pixels.data()));
+        return image.saveToFile(filename);
+    }
+
+    // palettized copy, one byte per pixel in 3-3-2 RGB, for compact observations
+    void toRGB332(std::uint8_t* out) const
+    {
+        for (std::size_t i = 0; i < this->pixels.size(); i++)
+        {
+            std::uint32_t p = this->pixels[i];
+            out[i] = (std::uint8_t)((p & 0xE0) | ((p >> 11) & 0x1C) | ((p >> 22) & 0x03));
+        }
+    }
+
+    // -------------------------------
+    // RenderBackend
+    // -------------------------------
+
+    void clear(sf::Color color) override
+    {
+        std::fill(this->pixels.begin(), this->pixels.end(), pack(color) | 0xFF000000);
+    }
+
+    sf::Vector2u textureSize(TextureId texture) override
+    {
+        const Image& image = this->textures[(int)texture];
+        return { (unsigned int)image.width, (unsigned int)image.height };
+    }
+
+    void drawSprite(TextureId texture, sf::IntRect rect, sf::Vector2f center, sf::Vector2f size, sf::Color color) override
+    {
+        sf::Vector2f topLeft = center - size / 2.0f;
+        this->drawTextured(this->textures[(int)texture], { topLeft, size },
+            (float)rect.left, (float)rect.top, (float)(rect.left + rect.width), (float)(rect.top + rect.height), color);
+    }
+
+    void drawQuads(TextureId texture, const sf::Vertex* vertices, std::size_t vertexCount) override
+    {
+        const Image& image = this->textures[(int)texture];
+        for (std::size_t i = 0; i + 3 < vertexCount; i += 4)
+        {
+            const sf::Vertex& a = vertices[i];
+            const sf::Vertex& c = vertices[i + 2];
+            this->drawTextured(image, { a.position, c.position - a.position }, a.texCoords.x, a.texCoords.y, c.texCoords.x, c.texCoords.y, a.color);
+        }
+    }
+
+    // DDA, one blended pixel per step along the longer axis
+    void drawLineStrip(const sf::Vector2f* points, std::size_t count, sf::Color color) override
+    {
+        std::uint32_t c = pack(color);
+        for (std::size_t i = 0; i + 1 < count; i++)
+        {
+            float x0 = this->toPixelX(points[i].x), y0 = this->toPixelY(points[i].y);
+            float x1 = this->toPixelX(points[i + 1].x), y1 = this->toPixelY(points[i + 1].y);
+            int steps = (int)std::max(std::fabs(x1 - x0), std::fabs(y1 - y0)) + 1;
+            float dx = (x1 - x0) / steps, dy = (y1 - y0) / steps;
+            for (int s = 0; s <= steps; s++)
+            {
+                this->plot((int)std::floor(x0 + dx * s), (int)std::floor(y0 + dy * s), c);
+            }
+        }
+    }
+
+    void drawPoints(const sf::Vector2f* points, std::size_t count, sf::Color color) override
+    {
+        std::uint32_t c = pack(color);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            this->plot((int)std::floor(this->toPixelX(points[i].x)), (int)std::floor(this->toPixelY(points[i].y)), c);
+        }
+    }
+
+    void fillRect(sf::FloatRect rect, sf::Color color) override
+    {
+        int x0, y0, x1, y1;
+        if (!this->pixelBounds(rect, x0, y0, x1, y1))
+        {
+            return;
+        }
+        std::fill(this->span.begin(), this->span.begin() + (x1 - x0), pack(color));
+        for (int y = y0; y < y1; y++)
+        {
+            blendSpan(&this->pixels[(std::size_t)y * this->width + x0], this->span.data(), x1 - x0);
+        }
+    }
+
+    void drawText(std::string_view text, sf::Vector2f position, unsigned int size, sf::Color color) override
+    {
+    }
+
+    // -------------------------------
+    // rasterization
+    // -------------------------------
+
+    static std::uint32_t pack(sf::Color c)
+    {
+        return (std::uint32_t)c.r | ((std::uint32_t)c.g << 8) | ((std::uint32_t)c.b << 16) | ((std::uint32_t)c.a << 24);
+    }
+
+    // per channel a * b / 255
+    static std::uint32_t modulate(std::uint32_t a, std::uint32_t b)
+    {
+        std::uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            std::uint32_t t = ((a >> shift) & 0xFF) * ((b >> shift) & 0xFF) + 128;
+            out |= (((t + (t >> 8)) >> 8) & 0xFF) << shift;
+        }
+        return out;
+    }
+
+    // dst = src * a + dst * (1 - a), with a the source alpha. the result is left opaque.
+    // the sum of both products stays under 65536, so the math fits 16 bit lanes
+    static void blendSpan(std::uint32_t* dst, const std::uint32_t* src, int count)
+    {
+        int i = 0;
+#ifdef SOFTRENDER_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i full = _mm_set1_epi16(255);
+        const __m128i half = _mm_set1_epi16(128);
+        const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+            __m128i out[2];
+            for (int h = 0; h < 2; h++)
+            {
+                __m128i s16 = h == 0 ? _mm_unpacklo_epi8(s, zero) : _mm_unpackhi_epi8(s, zero);
+                __m128i d16 = h == 0 ? _mm_unpacklo_epi8(d, zero) : _mm_unpackhi_epi8(d, zero);
+                __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+                __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s16, a), _mm_mullo_epi16(d16, _mm_sub_epi16(full, a))), half);
+                out[h] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            }
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(out[0], out[1]), opaque));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            std::uint32_t s = src[i], d = dst[i];
+            std::uint32_t a = s >> 24;
+            std::uint32_t out = 0xFF000000;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                std::uint32_t t = ((s >> shift) & 0xFF) * a + ((d >> shift) & 0xFF) * (255 - a) + 128;
+                out |= ((t + (t >> 8)) >> 8) << shift;
+            }
+            dst[i] = out;
+        }
+    }
+
+    float toPixelX(float x) const
+    {
+        return (x - this->view.left) * this->scaleX;
+    }
+
+    float toPixelY(float y) const
+    {
+        return (y - this->view.top) * this->scaleY;
+    }
+
+    // pixels whose centers fall inside the world rect, clipped to the framebuffer
+    bool pixelBounds(const sf::FloatRect& rect, int& x0, int& y0, int& x1, int& y1) const
+    {
+        x0 = std::max(0, (int)std::ceil(this->toPixelX(rect.left) - 0.5f));
+        y0 = std::max(0, (int)std::ceil(this->toPixelY(rect.top) - 0.5f));
+        x1 = std::min(this->width, (int)std::ceil(this->toPixelX(rect.left + rect.width) - 0.5f));
+        y1 = std::min(this->height, (int)std::ceil(this->toPixelY(rect.top + rect.height) - 0.5f));
+        return x0 < x1 && y0 < y1;
+    }
+
+    void plot(int x, int y, std::uint32_t color)
+    {
+        if (x >= 0 && x < this->width && y >= 0 && y < this->height)
+        {
+            blendSpan(&this->pixels[(std::size_t)y * this->width + x], &color, 1);
+        }
+    }
+
+    static int wrap(int v, int size)
+    {
+        v %= size;
+        return v < 0 ? v + size : v;
+    }
+
+    std::uint32_t sampleBilinear(const Image& image, float u, float v) const
+    {
+        u -= 0.5f;
+        v -= 0.5f;
+        float fu = std::floor(u), fv = std::floor(v);
+        int x0 = wrap((int)fu, image.width), y0 = wrap((int)fv, image.height);
+        int x1 = wrap(x0 + 1, image.width), y1 = wrap(y0 + 1, image.height);
+        int wu = (int)((u - fu) * 256), wv = (int)((v - fv) * 256);
+        std::uint32_t p00 = image.pixels[(std::size_t)y0 * image.width + x0], p10 = image.pixels[(std::size_t)y0 * image.width + x1];
+        std::uint32_t p01 = image.pixels[(std::size_t)y1 * image.width + x0], p11 = image.pixels[(std::size_t)y1 * image.width + x1];
+        std::uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            int top = ((p00 >> shift) & 0xFF) * (256 - wu) + ((p10 >> shift) & 0xFF) * wu;
+            int bottom = ((p01 >> shift) & 0xFF) * (256 - wu) + ((p11 >> shift) & 0xFF) * wu;
+            out |= (std::uint32_t)(((top * (256 - wv) + bottom * wv) >> 16) & 0xFF) << shift;
+        }
+        return out;
+    }
+
+    // maps texture rect (u0, v0)-(u1, v1) onto the world rect, one row at a time:
+    // sample into the span buffer, then blend the whole row
+    void drawTextured(const Image& image, const sf::FloatRect& rect, float u0, float v0, float u1, float v1, sf::Color color)
+    {
+        if (image.width == 0 || image.height == 0 || rect.width <= 0.0f || rect.height <= 0.0f)
+        {
+            return;
+        }
+        int x0, y0, x1, y1;
+        if (!this->pixelBounds(rect, x0, y0, x1, y1))
+        {
+            return;
+        }
+        bool tint = color != sf::Color::White;
+        std::uint32_t c = pack(color);
+        float du = (u1 - u0) / (rect.width * this->scaleX);
+        float dv = (v1 - v0) / (rect.height * this->scaleY);
+        float startU = u0 + (x0 + 0.5f - this->toPixelX(rect.left)) * du;
+        for (int y = y0; y < y1; y++)
+        {
+            float v = v0 + (y + 0.5f - this->toPixelY(rect.top)) * dv;
+            float u = startU;
+            if (this->sampling == Sampling::NEAREST)
+            {
+                const std::uint32_t* row = &image.pixels[(std::size_t)wrap((int)std::floor(v), image.height) * image.width];
+                for (int x = x0; x < x1; x++, u += du)
+                {
+                    this->span[x - x0] = row[wrap((int)std::floor(u), image.width)];
+                }
+            }
+            else
+            {
+                for (int x = x0; x < x1; x++, u += du)
+                {
+                    this->span[x - x0] = this->sampleBilinear(image, u, v);
+                }
+            }
+            if (tint)
+            {
+                for (int x = 0; x < x1 - x0; x++)
+                {
+                    this->span[x] = modulate(this->span[x], c);
+                }
+            }
+            blendSpan(&this->pixels[(std::size_t)y * this->width + x0], this->span.data(), x1 - x0);
+        }
+    }
+};
+
+// --render-frames: plays a headless match with random inputs and rasterizes every frame
+inline void benchmarkSoftwareRenderer(int frames, int width, int height, SoftwareRenderer::Sampling sampling)
+{
+    Simulation sim;
+    if (!sim.loadDefaultLevel())
+    {
+        return;
+    }
+    sim.masks = loadCollisionMasks();
+    sim.reset(1);
+    SoftwareRenderer renderer;
+    renderer.resize(width, height, { sim.arena.minx, sim.arena.miny, sim.arena.maxx - sim.arena.minx, sim.arena.maxy - sim.arena.miny });
+    renderer.sampling = sampling;
+    if (!renderer.loadTextures())
+    {
+        std::cout << "software renderer: some textures failed to load" << std::endl;
+    }
+
+    Rng inputs;
+    std::uint32_t action = 0;
+    double renderSeconds = 0.0;
+    for (int i = 0; i < frames; i++)
+    {
+        if (i % 8 == 0)
+        {
+            action = inputs.next() & 0xF;
+        }
+        if (sim.step(action, 1.0f / 60.0f) != SimStatus::RUNNING)
+        {
+            sim.reset(i);
+        }
+        auto start = std::chrono::steady_clock::now();
+        renderer.clear(sf::Color::Black);
+        drawSimulation(sim, renderer);
+        renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::string filename = "frame_" + std::to_string(width) + "x" + std::to_string(height) + ".png";
+    renderer.saveToFile(filename);
+    std::cout << "frames: " << frames << " at " << width << "x" << height << ", " << frames / renderSeconds << " frames/s, last frame saved to " << filename << std::endl;
+}
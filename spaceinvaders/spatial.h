@@ -0,0 +1,568 @@
+#pragma once
+#include <SFML/System/Vector2.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <vector>
+#include <span>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include <chrono>
+#include "ecs.h"
+
+// slab test of the segment a->b against an axis aligned box. on a hit 't' is the fraction
+// of the way from a to b where the segment enters the box (0 if a is already inside)
+inline bool segmentIntersectsRect(sf::Vector2f a, sf::Vector2f b, const sf::FloatRect& box, float& t)
+{
+    float start[2] = { a.x, a.y };
+    float delta[2] = { b.x - a.x, b.y - a.y };
+    float low[2] = { box.left, box.top };
+    float high[2] = { box.left + box.width, box.top + box.height };
+    float enter = 0.0f, exit = 1.0f;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        if (std::fabs(delta[axis]) < 1e-6f)
+        {
+            // parallel to this slab: either always inside it or never
+            if (start[axis] < low[axis] || start[axis] > high[axis])
+            {
+                return false;
+            }
+            continue;
+        }
+        float t1 = (low[axis] - start[axis]) / delta[axis];
+        float t2 = (high[axis] - start[axis]) / delta[axis];
+        if (t1 > t2)
+        {
+            std::swap(t1, t2);
+        }
+        enter = std::max(enter, t1);
+        exit = std::min(exit, t2);
+        if (enter > exit)
+        {
+            return false;
+        }
+    }
+    t = enter;
+    return true;
+}
+
+// squared distance from a point to a box, 0 inside it
+inline float distanceSquared(sf::Vector2f point, const sf::FloatRect& box)
+{
+    float dx = std::max({ box.left - point.x, 0.0f, point.x - (box.left + box.width) });
+    float dy = std::max({ box.top - point.y, 0.0f, point.y - (box.top + box.height) });
+    return dx * dx + dy * dy;
+}
+
+// =================================
+// SPATIAL QUERIES
+// =================================
+
+// a uniform grid of cells over the arena, holding entities by their bounds. it is filled
+// from scratch (clear, insert..., build) whenever the things in it have moved: build() lays
+// the items out cell by cell in one array, so after the first few fills nothing allocates.
+// an item goes into every cell its bounds touch; things outside the grid land in the border
+// cells. queries only look at the cells they cover, so their cost follows what is near,
+// not how much there is.
+//
+// results go to buffers the caller owns. every query returns how many items matched and
+// stores the first out.size() of them, like firePattern:
+//   Entity near[8];
+//   std::size_t found = grid.radius(position, 200.0f, near);
+// nearest() and segment() sort what they store, nearest / earliest first.
+
+// an item the segment crosses, 't' is the fraction of the segment where it enters it
+struct SpatialHit
+{
+    Entity entity;
+    float t;
+};
+
+class SpatialGrid
+{
+public:
+    // the area the cells cover
+    void setBounds(sf::FloatRect area, float cellSize)
+    {
+        this->origin = { area.left, area.top };
+        this->cellSize = cellSize;
+        this->columns = std::max(1, (int)std::ceil(area.width / cellSize));
+        this->rows = std::max(1, (int)std::ceil(area.height / cellSize));
+        this->clear();
+    }
+
+    void clear()
+    {
+        this->items.clear();
+        this->cellStart.assign((std::size_t)this->columns * this->rows + 1, 0);
+        this->cellItems.clear();
+    }
+
+    void insert(Entity e, sf::FloatRect bounds)
+    {
+        this->items.push_back({ e, bounds });
+    }
+
+    // sorts the inserted items into their cells: count per cell, prefix sums, then fill
+    void build()
+    {
+        std::fill(this->cellStart.begin(), this->cellStart.end(), 0);
+        for (const Item& item : this->items)
+        {
+            CellRange range = this->cellsOf(item.bounds);
+            for (int y = range.top; y <= range.bottom; y++)
+            {
+                for (int x = range.left; x <= range.right; x++)
+                {
+                    this->cellStart[this->cellIndex(x, y) + 1]++;
+                }
+            }
+        }
+        for (std::size_t c = 1; c < this->cellStart.size(); c++)
+        {
+            this->cellStart[c] += this->cellStart[c - 1];
+        }
+        this->cellItems.resize(this->cellStart.back());
+        this->cursor.assign(this->cellStart.begin(), this->cellStart.end() - 1);
+        for (std::uint32_t i = 0; i < this->items.size(); i++)
+        {
+            CellRange range = this->cellsOf(this->items[i].bounds);
+            for (int y = range.top; y <= range.bottom; y++)
+            {
+                for (int x = range.left; x <= range.right; x++)
+                {
+                    this->cellItems[this->cursor[this->cellIndex(x, y)]++] = i;
+                }
+            }
+        }
+        this->stamps.assign(this->items.size(), 0);
+        this->stamp = 0;
+    }
+
+    std::size_t size() const
+    {
+        return this->items.size();
+    }
+
+    // items whose bounds overlap 'area'
+    std::size_t box(sf::FloatRect area, std::span<Entity> out)
+    {
+        std::size_t found = 0;
+        this->visit(this->cellsOf(area), [&](const Item& item)
+            {
+                if (item.bounds.intersects(area))
+                {
+                    store(out, found++, item.entity);
+                }
+            });
+        return found;
+    }
+
+    // items with any part within 'radius' of 'center'
+    std::size_t radius(sf::Vector2f center, float radius, std::span<Entity> out)
+    {
+        std::size_t found = 0;
+        float limit = radius * radius;
+        sf::FloatRect area(center.x - radius, center.y - radius, radius * 2, radius * 2);
+        this->visit(this->cellsOf(area), [&](const Item& item)
+            {
+                if (distanceSquared(center, item.bounds) <= limit)
+                {
+                    store(out, found++, item.entity);
+                }
+            });
+        return found;
+    }
+
+    // the out.size() items closest to 'point' that 'accept' lets through, nearest first.
+    // cells are searched in growing rings around the point, and the search stops once the
+    // next ring can't hold anything closer than the farthest item kept
+    template <typename F>
+    std::size_t nearest(sf::Vector2f point, std::span<Entity> out, F&& accept)
+    {
+        std::size_t k = out.size();
+        if (k == 0 || this->items.empty())
+        {
+            return 0;
+        }
+        this->distances.resize(k);
+        std::size_t found = 0;
+        int cx = this->column(point.x), cy = this->row(point.y);
+        int rings = std::max({ cx, this->columns - 1 - cx, cy, this->rows - 1 - cy });
+        this->nextStamp();
+        for (int ring = 0; ring <= rings; ring++)
+        {
+            // everything not seen yet is at least this far: the point is inside the center cell
+            float reach = (ring - 1) * this->cellSize;
+            if (found == k && ring > 0 && this->distances[k - 1] <= reach * reach)
+            {
+                break;
+            }
+            for (int y = cy - ring; y <= cy + ring; y++)
+            {
+                if (y < 0 || y >= this->rows)
+                {
+                    continue;
+                }
+                // inner rows of the ring only have their two end cells
+                int step = (y == cy - ring || y == cy + ring) ? 1 : std::max(ring * 2, 1);
+                for (int x = cx - ring; x <= cx + ring; x += step)
+                {
+                    if (x < 0 || x >= this->columns)
+                    {
+                        continue;
+                    }
+                    this->visitCell(this->cellIndex(x, y), [&](const Item& item)
+                        {
+                            if (!accept(item.entity))
+                            {
+                                return;
+                            }
+                            float distance = distanceSquared(point, item.bounds);
+                            if (found == k && distance >= this->distances[k - 1])
+                            {
+                                return;
+                            }
+                            // insertion into the sorted list of kept items
+                            std::size_t slot = std::min(found, k - 1);
+                            while (slot > 0 && this->distances[slot - 1] > distance)
+                            {
+                                this->distances[slot] = this->distances[slot - 1];
+                                out[slot] = out[slot - 1];
+                                slot--;
+                            }
+                            this->distances[slot] = distance;
+                            out[slot] = item.entity;
+                            found = std::min(found + 1, k);
+                        });
+                }
+            }
+        }
+        return found;
+    }
+
+    std::size_t nearest(sf::Vector2f point, std::span<Entity> out)
+    {
+        return this->nearest(point, out, [](Entity) { return true; });
+    }
+
+    // items the segment a->b crosses, earliest first
+    std::size_t segment(sf::Vector2f a, sf::Vector2f b, std::span<SpatialHit> out)
+    {
+        std::size_t found = 0;
+        this->walk(a, b, [&](const Item& item, float cellExit)
+            {
+                float t;
+                if (segmentIntersectsRect(a, b, item.bounds, t))
+                {
+                    if (found < out.size())
+                    {
+                        std::size_t slot = found;
+                        while (slot > 0 && out[slot - 1].t > t)
+                        {
+                            out[slot] = out[slot - 1];
+                            slot--;
+                        }
+                        out[slot] = { item.entity, t };
+                    }
+                    found++;
+                }
+                return false;
+            });
+        return found;
+    }
+
+    // the first item along a->b that 'test' confirms. test(entity, t) starts with t at the
+    // box entry and may push it later (a mask test) or reject the item. cells are walked in
+    // order, so the walk ends at the first cell that ends past the best hit so far
+    template <typename F>
+    bool firstHit(sf::Vector2f a, sf::Vector2f b, SpatialHit& hit, F&& test)
+    {
+        hit.t = 2.0f;
+        this->walk(a, b, [&](const Item& item, float cellExit)
+            {
+                float t;
+                if (segmentIntersectsRect(a, b, item.bounds, t) && t < hit.t && test(item.entity, t) && t < hit.t)
+                {
+                    hit = { item.entity, t };
+                }
+                return hit.t <= cellExit;
+            });
+        return hit.t <= 1.0f;
+    }
+
+    bool firstHit(sf::Vector2f a, sf::Vector2f b, SpatialHit& hit)
+    {
+        return this->firstHit(a, b, hit, [](Entity, float&) { return true; });
+    }
+
+private:
+    struct Item
+    {
+        Entity entity;
+        sf::FloatRect bounds;
+    };
+
+    struct CellRange
+    {
+        int left, top, right, bottom;
+    };
+
+    sf::Vector2f origin;
+    float cellSize{ 64.0f };
+    int columns{ 1 }, rows{ 1 };
+    std::vector<Item> items;
+    // the item indexes of cell c are cellItems[cellStart[c]] .. cellItems[cellStart[c + 1] - 1]
+    std::vector<std::uint32_t> cellStart;
+    std::vector<std::uint32_t> cellItems;
+    std::vector<std::uint32_t> cursor;
+    // items spanning several cells are reported once per query: the query's stamp marks them
+    std::vector<std::uint32_t> stamps;
+    std::uint32_t stamp{ 0 };
+    std::vector<float> distances;
+
+    static void store(std::span<Entity> out, std::size_t index, Entity e)
+    {
+        if (index < out.size())
+        {
+            out[index] = e;
+        }
+    }
+
+    int column(float x) const
+    {
+        return std::clamp((int)std::floor((x - this->origin.x) / this->cellSize), 0, this->columns - 1);
+    }
+
+    int row(float y) const
+    {
+        return std::clamp((int)std::floor((y - this->origin.y) / this->cellSize), 0, this->rows - 1);
+    }
+
+    std::size_t cellIndex(int x, int y) const
+    {
+        return (std::size_t)y * this->columns + x;
+    }
+
+    CellRange cellsOf(const sf::FloatRect& bounds) const
+    {
+        return { this->column(bounds.left), this->row(bounds.top), this->column(bounds.left + bounds.width), this->row(bounds.top + bounds.height) };
+    }
+
+    void nextStamp()
+    {
+        if (++this->stamp == 0)
+        {
+            std::fill(this->stamps.begin(), this->stamps.end(), 0);
+            this->stamp = 1;
+        }
+    }
+
+    template <typename F>
+    void visitCell(std::size_t cell, F&& f)
+    {
+        for (std::uint32_t i = this->cellStart[cell]; i < this->cellStart[cell + 1]; i++)
+        {
+            std::uint32_t item = this->cellItems[i];
+            if (this->stamps[item] != this->stamp)
+            {
+                this->stamps[item] = this->stamp;
+                f(this->items[item]);
+            }
+        }
+    }
+
+    template <typename F>
+    void visit(CellRange range, F&& f)
+    {
+        if (this->items.empty())
+        {
+            return;
+        }
+        this->nextStamp();
+        for (int y = range.top; y <= range.bottom; y++)
+        {
+            for (int x = range.left; x <= range.right; x++)
+            {
+                this->visitCell(this->cellIndex(x, y), f);
+            }
+        }
+    }
+
+    // the cells a->b passes through, in order (a grid DDA). f(item, t where the segment
+    // leaves the cell) returns true to stop
+    template <typename F>
+    void walk(sf::Vector2f a, sf::Vector2f b, F&& f)
+    {
+        if (this->items.empty())
+        {
+            return;
+        }
+        this->nextStamp();
+        int x = this->column(a.x), y = this->row(a.y);
+        int endX = this->column(b.x), endY = this->row(b.y);
+        sf::Vector2f delta = b - a;
+        int stepX = delta.x > 0 ? 1 : -1, stepY = delta.y > 0 ? 1 : -1;
+        const float never = std::numeric_limits<float>::max();
+        // t of the next vertical / horizontal cell border, and the t between two of them
+        float nextX = never, nextY = never, strideX = never, strideY = never;
+        if (std::fabs(delta.x) > 1e-6f)
+        {
+            float border = this->origin.x + (x + (stepX > 0 ? 1 : 0)) * this->cellSize;
+            nextX = (border - a.x) / delta.x;
+            strideX = this->cellSize / std::fabs(delta.x);
+        }
+        if (std::fabs(delta.y) > 1e-6f)
+        {
+            float border = this->origin.y + (y + (stepY > 0 ? 1 : 0)) * this->cellSize;
+            nextY = (border - a.y) / delta.y;
+            strideY = this->cellSize / std::fabs(delta.y);
+        }
+        while (true)
+        {
+            bool last = (x == endX && y == endY) || std::min(nextX, nextY) > 1.0f;
+            float exit = last ? 1.0f : std::min(nextX, nextY);
+            bool stop = false;
+            this->visitCell(this->cellIndex(x, y), [&](const Item& item)
+                {
+                    stop = f(item, exit) || stop;
+                });
+            if (stop || last)
+            {
+                return;
+            }
+            if (nextX < nextY)
+            {
+                x += stepX;
+                nextX += strideX;
+            }
+            else
+            {
+                y += stepY;
+                nextY += strideY;
+            }
+            // clamped ends can leave the segment's line outside the grid: stop at the border
+            if (x < 0 || x >= this->columns || y < 0 || y >= this->rows)
+            {
+                return;
+            }
+        }
+    }
+};
+
+// --bench-spatial: the grid against scanning every item, on the same random boxes and
+// queries. also checks that both agree
+inline void benchmarkSpatial(int itemCount, int queryCount)
+{
+    sf::FloatRect area(0.0f, 0.0f, 1600.0f, 800.0f);
+    std::uint32_t state = 12345;
+    auto random = [&](float min, float max)
+        {
+            state = state * 1664525u + 1013904223u;
+            return min + (max - min) * (float)(state >> 8) / (float)(1u << 24);
+        };
+    std::vector<Entity> entities(itemCount);
+    std::vector<sf::FloatRect> bounds(itemCount);
+    SpatialGrid grid;
+    grid.setBounds(area, 64.0f);
+    for (int i = 0; i < itemCount; i++)
+    {
+        entities[i] = { (std::uint32_t)i, 0 };
+        float size = random(8.0f, 80.0f);
+        bounds[i] = sf::FloatRect(random(0.0f, 1600.0f), random(0.0f, 800.0f), size, size);
+        grid.insert(entities[i], bounds[i]);
+    }
+    grid.build();
+    std::vector<sf::Vector2f> points(queryCount);
+    for (int q = 0; q < queryCount; q++)
+    {
+        points[q] = { random(0.0f, 1600.0f), random(0.0f, 800.0f) };
+    }
+    typedef std::chrono::high_resolution_clock Clock;
+    auto seconds = [](Clock::time_point since) { return std::chrono::duration<double>(Clock::now() - since).count(); };
+    int mismatches = 0;
+    Entity nearest[1];
+    Entity near[64];
+
+    Clock::time_point start = Clock::now();
+    std::size_t checksum = 0;
+    for (int q = 0; q < queryCount; q++)
+    {
+        checksum += grid.nearest(points[q], nearest) ? nearest[0].index : 0;
+    }
+    double gridNearest = seconds(start);
+    start = Clock::now();
+    std::size_t scanChecksum = 0;
+    for (int q = 0; q < queryCount; q++)
+    {
+        float best = std::numeric_limits<float>::max();
+        std::uint32_t closest = 0;
+        for (int i = 0; i < itemCount; i++)
+        {
+            float distance = distanceSquared(points[q], bounds[i]);
+            if (distance < best)
+            {
+                best = distance;
+                closest = (std::uint32_t)i;
+            }
+        }
+        scanChecksum += itemCount ? closest : 0;
+    }
+    double scanNearest = seconds(start);
+    mismatches += checksum != scanChecksum;
+
+    start = Clock::now();
+    checksum = 0;
+    for (int q = 0; q < queryCount; q++)
+    {
+        checksum += grid.radius(points[q], 100.0f, near);
+    }
+    double gridRadius = seconds(start);
+    start = Clock::now();
+    scanChecksum = 0;
+    for (int q = 0; q < queryCount; q++)
+    {
+        for (int i = 0; i < itemCount; i++)
+        {
+            scanChecksum += distanceSquared(points[q], bounds[i]) <= 100.0f * 100.0f;
+        }
+    }
+    double scanRadius = seconds(start);
+    mismatches += checksum != scanChecksum;
+
+    // vertical beams from the bottom edge, the first thing each one hits
+    start = Clock::now();
+    checksum = 0;
+    SpatialHit hit;
+    for (int q = 0; q < queryCount; q++)
+    {
+        checksum += grid.firstHit({ points[q].x, 800.0f }, { points[q].x, 0.0f }, hit) ? hit.entity.index : 0;
+    }
+    double gridRay = seconds(start);
+    start = Clock::now();
+    scanChecksum = 0;
+    for (int q = 0; q < queryCount; q++)
+    {
+        float earliest = 2.0f, t;
+        std::uint32_t first = 0;
+        for (int i = 0; i < itemCount; i++)
+        {
+            if (segmentIntersectsRect({ points[q].x, 800.0f }, { points[q].x, 0.0f }, bounds[i], t) && t < earliest)
+            {
+                earliest = t;
+                first = (std::uint32_t)i;
+            }
+        }
+        scanChecksum += earliest <= 1.0f ? first : 0;
+    }
+    double scanRay = seconds(start);
+    mismatches += checksum != scanChecksum;
+
+    std::cout << itemCount << " items, " << queryCount << " queries of each kind" << std::endl;
+    std::cout << "  nearest: grid " << gridNearest * 1e9 / queryCount << " ns, scan " << scanNearest * 1e9 / queryCount << " ns" << std::endl;
+    std::cout << "  radius:  grid " << gridRadius * 1e9 / queryCount << " ns, scan " << scanRadius * 1e9 / queryCount << " ns" << std::endl;
+    std::cout << "  ray:     grid " << gridRay * 1e9 / queryCount << " ns, scan " << scanRay * 1e9 / queryCount << " ns" << std::endl;
+    std::cout << (mismatches ? "  results differ from the scan" : "  results match the scan") << std::endl;
+}
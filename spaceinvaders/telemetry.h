@@ -0,0 +1,458 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+
+// =================================
+// TELEMETRY
+// =================================
+
+// what a real session did, cheap enough to leave on. recording a value is a clock read and
+// a store into a ring buffer owned by the calling thread (single producer, single
+// consumer, no locks); a background thread drains every ring a few times a second and
+// appends the records to the log. a full ring drops records instead of waiting, and the
+// drop count is logged at the end of the session.
+//
+// the log is a header followed by fixed-size records, like compiled levels:
+//   spaceinvaders --telemetry session.sitl [summary|csv|json]
+
+const char telemetryMagic[4] = { 'S', 'I', 'T', 'L' };
+const std::uint32_t telemetryVersion = 1;
+
+enum class TelemetryEvent : std::uint16_t
+{
+    FRAME = 0, // durations in nanoseconds
+    PHASE_INPUT = 1,
+    PHASE_SIMULATION = 2,
+    PHASE_EFFECTS = 3,
+    PHASE_RECORD = 4,
+    PHASE_SUBMIT = 5,
+    ENTITIES = 6, // alive entities after the step
+    SHOT = 7, // counters, value 1
+    HIT = 8,
+    KILL = 9,
+    POWERUP = 10,
+    STATE = 11, // navigation state entered
+    DROPPED = 12, // records lost to full rings, written once at the end
+    COUNT
+};
+
+inline const char* telemetryEventName(TelemetryEvent event)
+{
+    static const char* names[(int)TelemetryEvent::COUNT] = {
+        "frame", "input", "simulation", "effects", "record", "submit",
+        "entities", "shot", "hit", "kill", "powerup", "state", "dropped"
+    };
+    return (int)event < (int)TelemetryEvent::COUNT ? names[(int)event] : "unknown";
+}
+
+inline bool telemetryIsDuration(TelemetryEvent event)
+{
+    return event <= TelemetryEvent::PHASE_SUBMIT;
+}
+
+struct TelemetryHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint32_t reserved;
+    std::uint64_t startTime; // system clock, nanoseconds since the epoch
+};
+
+struct TelemetryRecord
+{
+    std::uint64_t time; // nanoseconds since the session started
+    std::uint16_t type;
+    std::uint16_t thread;
+    std::uint32_t value;
+};
+static_assert(sizeof(TelemetryRecord) == 16, "records are written as is");
+
+// one per recording thread. only that thread advances head, only the writer advances tail
+struct TelemetryRing
+{
+    static const std::size_t capacity = 1 << 14;
+    TelemetryRecord records[capacity];
+    alignas(64) std::atomic<std::size_t> head{ 0 };
+    alignas(64) std::atomic<std::size_t> tail{ 0 };
+    std::uint16_t thread{ 0 };
+
+    bool push(const TelemetryRecord& record)
+    {
+        std::size_t head = this->head.load(std::memory_order_relaxed);
+        if (head - this->tail.load(std::memory_order_acquire) == capacity)
+        {
+            return false;
+        }
+        this->records[head & (capacity - 1)] = record;
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename F>
+    void drain(F&& consume)
+    {
+        std::size_t tail = this->tail.load(std::memory_order_relaxed);
+        std::size_t head = this->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++)
+        {
+            consume(this->records[tail & (capacity - 1)]);
+        }
+        this->tail.store(tail, std::memory_order_release);
+    }
+};
+
+class Telemetry
+{
+public:
+    ~Telemetry()
+    {
+        this->stop();
+    }
+
+    bool start(const std::string& filename)
+    {
+        this->stop();
+        this->file.open(filename, std::ios::binary | std::ios::trunc);
+        if (!this->file)
+        {
+            return false;
+        }
+        TelemetryHeader header;
+        std::memcpy(header.magic, telemetryMagic, 4);
+        header.version = telemetryVersion;
+        header.recordSize = sizeof(TelemetryRecord);
+        header.reserved = 0;
+        header.startTime = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        this->file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        this->startedAt = std::chrono::steady_clock::now();
+        this->dropped.store(0);
+        this->stopping = false;
+        this->active.store(true, std::memory_order_release);
+        this->writer = std::thread([this]() { this->writerLoop(); });
+        return true;
+    }
+
+    // drains what is left and closes the log
+    void stop()
+    {
+        if (!this->writer.joinable())
+        {
+            return;
+        }
+        this->active.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_one();
+        this->writer.join();
+        this->drainAll();
+        TelemetryRecord dropped{ this->now(), (std::uint16_t)TelemetryEvent::DROPPED, 0, (std::uint32_t)this->dropped.load() };
+        this->buffer.push_back(dropped);
+        this->writeBuffer();
+        this->file.close();
+    }
+
+    bool enabled() const
+    {
+        return this->active.load(std::memory_order_relaxed);
+    }
+
+    // a listener that sees every record as it is made, on the recording thread, whether or
+    // not a session is being logged. the flight recorder builds its frames from them
+    typedef void (*Tap)(void* context, TelemetryEvent event, std::uint32_t value);
+
+    void setTap(Tap tap, void* context)
+    {
+        this->tap = tap;
+        this->tapContext = context;
+    }
+
+    // durations are worth measuring: someone logs or listens
+    bool timing() const
+    {
+        return this->tap != nullptr || this->enabled();
+    }
+
+    std::uint64_t now() const
+    {
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->startedAt).count();
+    }
+
+    void record(TelemetryEvent event, std::uint32_t value = 1)
+    {
+        if (this->tap)
+        {
+            this->tap(this->tapContext, event, value);
+        }
+        if (!this->enabled())
+        {
+            return;
+        }
+        TelemetryRing* ring = this->threadRing();
+        if (!ring->push({ this->now(), (std::uint16_t)event, ring->thread, value }))
+        {
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // durations are recorded as nanoseconds, clamped to the 32 bit value (4.2 s)
+    void recordDuration(TelemetryEvent event, std::uint64_t begin)
+    {
+        if (this->timing())
+        {
+            this->record(event, (std::uint32_t)std::min<std::uint64_t>(this->now() - begin, 0xFFFFFFFFu));
+        }
+    }
+
+    // times the rest of the enclosing block
+    struct Scope
+    {
+        Telemetry& telemetry;
+        TelemetryEvent event;
+        std::uint64_t begin;
+
+        Scope(Telemetry& telemetry, TelemetryEvent event) : telemetry(telemetry), event(event), begin(telemetry.timing() ? telemetry.now() : 0)
+        {
+        }
+
+        ~Scope()
+        {
+            this->telemetry.recordDuration(this->event, this->begin);
+        }
+    };
+
+private:
+    // rings are looked up by session id, a later session may reuse this object's address
+    std::uint64_t id{ nextId() };
+    std::atomic<bool> active{ false };
+    std::chrono::steady_clock::time_point startedAt;
+    std::atomic<std::uint64_t> dropped{ 0 };
+    Tap tap{ nullptr };
+    void* tapContext{ nullptr };
+
+    // rings live as long as the Telemetry object, threads keep their pointer to them
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<TelemetryRing>> rings;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping{ false };
+    std::ofstream file;
+    std::vector<TelemetryRecord> buffer;
+
+    TelemetryRing* threadRing()
+    {
+        thread_local TelemetryRing* ring = nullptr;
+        thread_local std::uint64_t owner = 0;
+        if (owner != this->id)
+        {
+            std::lock_guard<std::mutex> lock(this->ringsMutex);
+            this->rings.push_back(std::make_unique<TelemetryRing>());
+            ring = this->rings.back().get();
+            ring->thread = (std::uint16_t)(this->rings.size() - 1);
+            owner = this->id;
+        }
+        return ring;
+    }
+
+    static std::uint64_t nextId()
+    {
+        static std::atomic<std::uint64_t> counter{ 0 };
+        return ++counter;
+    }
+
+    void drainAll()
+    {
+        std::lock_guard<std::mutex> lock(this->ringsMutex);
+        for (std::size_t i = 0; i < this->rings.size(); i++)
+        {
+            this->rings[i]->drain([this](const TelemetryRecord& record) { this->buffer.push_back(record); });
+        }
+    }
+
+    void writeBuffer()
+    {
+        this->file.write(reinterpret_cast<const char*>(this->buffer.data()), this->buffer.size() * sizeof(TelemetryRecord));
+        this->buffer.clear();
+    }
+
+    void writerLoop()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (!this->stopping)
+        {
+            this->wake.wait_for(lock, std::chrono::milliseconds(50));
+            this->drainAll();
+            this->writeBuffer();
+        }
+    }
+};
+
+// one session per process, the game and its tools record into it
+inline Telemetry telemetry;
+
+// -------------------------------
+// offline tool
+// -------------------------------
+
+inline bool loadTelemetry(const std::string& filename, TelemetryHeader& header, std::vector<TelemetryRecord>& records)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+    std::size_t size = (std::size_t)file.tellg();
+    file.seekg(0);
+    if (size < sizeof(TelemetryHeader))
+    {
+        return false;
+    }
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (std::memcmp(header.magic, telemetryMagic, 4) != 0 || header.version != telemetryVersion || header.recordSize != sizeof(TelemetryRecord))
+    {
+        return false;
+    }
+    // a session that crashed leaves a partial last record, which is ignored
+    records.resize((size - sizeof(TelemetryHeader)) / sizeof(TelemetryRecord));
+    file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(TelemetryRecord));
+    // rings are drained one after another, so threads interleave out of order
+    std::stable_sort(records.begin(), records.end(), [](const TelemetryRecord& a, const TelemetryRecord& b) { return a.time < b.time; });
+    return (bool)file;
+}
+
+inline double telemetryPercentile(const std::vector<std::uint32_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    return sorted[std::min(sorted.size() - 1, (std::size_t)(p * (sorted.size() - 1) + 0.5))];
+}
+
+// --telemetry file [summary|csv|json]
+inline bool dumpTelemetry(const std::string& filename, const std::string& format)
+{
+    TelemetryHeader header;
+    std::vector<TelemetryRecord> records;
+    if (!loadTelemetry(filename, header, records))
+    {
+        std::cout << filename << ": not a telemetry log" << std::endl;
+        return false;
+    }
+
+    if (format == "csv")
+    {
+        std::cout << "time_ns,thread,event,value" << std::endl;
+        for (const TelemetryRecord& record : records)
+        {
+            std::cout << record.time << "," << record.thread << "," << telemetryEventName((TelemetryEvent)record.type) << "," << record.value << "\n";
+        }
+        return true;
+    }
+    if (format == "json")
+    {
+        std::cout << "{\"start\":" << header.startTime << ",\"records\":[";
+        for (std::size_t i = 0; i < records.size(); i++)
+        {
+            const TelemetryRecord& record = records[i];
+            std::cout << (i ? "," : "") << "\n{\"t\":" << record.time << ",\"thread\":" << record.thread << ",\"event\":\"" << telemetryEventName((TelemetryEvent)record.type) << "\",\"value\":" << record.value << "}";
+        }
+        std::cout << "\n]}" << std::endl;
+        return true;
+    }
+
+    // summary: percentiles of every duration, totals of every counter
+    std::vector<std::uint32_t> values[(int)TelemetryEvent::COUNT];
+    for (const TelemetryRecord& record : records)
+    {
+        if (record.type < (int)TelemetryEvent::COUNT)
+        {
+            values[record.type].push_back(record.value);
+        }
+    }
+    double seconds = records.empty() ? 0.0 : records.back().time / 1e9;
+    std::cout << records.size() << " records over " << seconds << " s" << std::endl;
+    for (int i = 0; i < (int)TelemetryEvent::COUNT; i++)
+    {
+        TelemetryEvent event = (TelemetryEvent)i;
+        std::vector<std::uint32_t>& v = values[i];
+        if (v.empty())
+        {
+            continue;
+        }
+        std::sort(v.begin(), v.end());
+        if (telemetryIsDuration(event))
+        {
+            std::cout << telemetryEventName(event) << " ms: p50 " << telemetryPercentile(v, 0.5) / 1e6 << ", p90 " << telemetryPercentile(v, 0.9) / 1e6
+                << ", p99 " << telemetryPercentile(v, 0.99) / 1e6 << ", max " << v.back() / 1e6 << " (" << v.size() << " samples)" << std::endl;
+        }
+        else if (event == TelemetryEvent::ENTITIES)
+        {
+            std::cout << "entities: p50 " << telemetryPercentile(v, 0.5) << ", p99 " << telemetryPercentile(v, 0.99) << ", max " << v.back() << std::endl;
+        }
+        else if (event == TelemetryEvent::STATE)
+        {
+            std::cout << "state changes: " << v.size() << std::endl;
+        }
+        else
+        {
+            std::uint64_t total = 0;
+            for (std::uint32_t value : v)
+            {
+                total += value;
+            }
+            std::cout << telemetryEventName(event) << ": " << total << std::endl;
+        }
+    }
+    return true;
+}
+
+// --bench-telemetry: cost of one record with the writer draining in the background,
+// against the handful of records a frame makes
+inline void benchmarkTelemetry(int records)
+{
+    Telemetry session;
+    if (!session.start("bench.sitl"))
+    {
+        return;
+    }
+    const int perFrame = 20, perBatch = 2000;
+    double seconds = 0.0;
+    for (int i = 0; i < records; i += perBatch)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < perBatch; j += perFrame)
+        {
+            std::uint64_t begin = session.now();
+            for (int k = 0; k < perFrame - 1; k++)
+            {
+                session.record(TelemetryEvent::SHOT);
+            }
+            session.recordDuration(TelemetryEvent::FRAME, begin);
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // the game makes a few thousand records a second; back to back a ring fills
+        // faster than the writer drains it, so batches are spaced out (and not timed)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    session.stop();
+    double perRecord = seconds / records * 1e9;
+    std::cout << "record: " << perRecord << " ns, " << perFrame << " per frame = " << perRecord * perFrame / (1e9 / 60.0) * 100.0 << "% of a 60 Hz frame" << std::endl;
+    dumpTelemetry("bench.sitl", "summary");
+}
@@ -0,0 +1,389 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <chrono>
+
+// =================================
+// TIMER WHEEL
+// =================================
+
+// cooldowns and delayed actions at tick granularity. a timer carries a payload and is
+// handed back to the caller on the tick it comes due:
+//   TimerId id = timers.schedule(timers.ticksFor(0.5f), { ... });
+//   timers.cancel(id);                        // fine after it fired too, the id just goes stale
+//   timers.advance(dt, [&](const Payload& payload) { ... });
+//
+// the wheel is hierarchical: 4 levels of 64 slots, each level's slot as long as the whole
+// level below it. a timer goes into the slot its due tick falls in at the finest level that
+// reaches that far, and when the wheel turns past the end of a level, the next slot of the
+// level above is emptied into the finer levels. schedule and cancel are a linked list insert
+// and unlink, and a tick only looks at one slot per level, so the cost of a tick is the
+// timers that fire in it and not the ones waiting.
+//
+// timers due on the same tick fire in the order they were scheduled, cascaded or not, and
+// nothing depends on wall time, so the same inputs give the same firings on every run.
+
+struct TimerId
+{
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    bool operator==(const TimerId& other) const
+    {
+        return this->index == other.index && this->generation == other.generation;
+    }
+};
+
+const TimerId nullTimer{ 0xFFFFFFFFu, 0 };
+
+template <typename Payload>
+class TimerWheel
+{
+public:
+    static constexpr int levelBits = 6;
+    static constexpr int levelCount = 4;
+    static constexpr std::uint32_t slotsPerLevel = 1u << levelBits;
+    // anything longer waits this long and is clamped
+    static constexpr std::uint32_t maxDelay = (1u << (levelBits * levelCount)) - 1;
+
+    // how long a tick is when the wheel is advanced by seconds
+    float tickSeconds{ 1.0f / 60.0f };
+
+    TimerWheel()
+    {
+        this->clear();
+    }
+
+    // drops every timer. ids handed out before stay stale
+    void clear()
+    {
+        for (std::size_t i = 0; i < this->nodes.size(); i++)
+        {
+            if (this->nodes[i].list != freeList)
+            {
+                this->release((std::uint32_t)i);
+            }
+        }
+        for (List& list : this->lists)
+        {
+            list = List();
+        }
+        this->count = 0;
+        this->scheduled = 0;
+        this->now = 0;
+        this->accumulator = 0.0f;
+    }
+
+    std::uint64_t currentTick() const
+    {
+        return this->now;
+    }
+
+    std::size_t size() const
+    {
+        return this->count;
+    }
+
+    // whole ticks in 'seconds', at least one
+    std::uint32_t ticksFor(float seconds) const
+    {
+        long ticks = std::lround(seconds / this->tickSeconds);
+        return (std::uint32_t)std::clamp(ticks, 1l, (long)maxDelay);
+    }
+
+    // fires 'delay' ticks from now; a delay of 0 fires on the next tick like 1 does
+    TimerId schedule(std::uint32_t delay, const Payload& payload)
+    {
+        std::uint32_t index;
+        if (this->freeHead != nil)
+        {
+            index = this->freeHead;
+            this->freeHead = this->nodes[index].next;
+        }
+        else
+        {
+            index = (std::uint32_t)this->nodes.size();
+            this->nodes.push_back(Node());
+        }
+        Node& node = this->nodes[index];
+        node.payload = payload;
+        node.due = this->now + std::clamp(delay, 1u, maxDelay);
+        node.sequence = this->scheduled++;
+        // the latest timer scheduled, so it goes behind everything in its slot
+        std::uint32_t slot = this->slotFor(node.due);
+        this->link(index, slot, this->lists[slot].tail);
+        this->count++;
+        return { index, node.generation };
+    }
+
+    bool pending(TimerId id) const
+    {
+        return id.index < this->nodes.size() && this->nodes[id.index].generation == id.generation && this->nodes[id.index].list != freeList;
+    }
+
+    // ticks until the timer fires, 0 when it is not pending
+    std::uint64_t remaining(TimerId id) const
+    {
+        return this->pending(id) ? this->nodes[id.index].due - this->now : 0;
+    }
+
+    // returns whether the timer was still pending
+    bool cancel(TimerId id)
+    {
+        if (!this->pending(id))
+        {
+            return false;
+        }
+        this->unlink(id.index);
+        this->release(id.index);
+        return true;
+    }
+
+    // cancels 'id' if it is pending and schedules the payload again
+    TimerId restart(TimerId id, std::uint32_t delay, const Payload& payload)
+    {
+        this->cancel(id);
+        return this->schedule(delay, payload);
+    }
+
+    // runs the ticks that fit in 'seconds', carrying the rest over to the next call
+    template <typename F>
+    void advance(float seconds, F&& fire)
+    {
+        this->accumulator += seconds;
+        while (this->accumulator >= this->tickSeconds)
+        {
+            this->accumulator -= this->tickSeconds;
+            this->tick(fire);
+        }
+    }
+
+    // one tick: fire(payload) for every timer due on it. fire may schedule and cancel timers,
+    // including the others due on this tick
+    template <typename F>
+    void tick(F&& fire)
+    {
+        this->now++;
+        // when the finer levels wrapped around, bring the next slot of the coarser ones down.
+        // the coarsest first, so what it hands down gets sorted further the same tick
+        int wrapped = 0;
+        while (wrapped < levelCount - 1 && ((this->now >> (levelBits * (wrapped + 1))) << (levelBits * (wrapped + 1))) == this->now)
+        {
+            wrapped++;
+        }
+        for (int level = wrapped; level >= 1; level--)
+        {
+            this->cascade(this->slotOf(level, this->now));
+        }
+
+        // the due list is detached first, so cancels from inside fire() unlink from it safely
+        List& slot = this->lists[this->slotOf(0, this->now)];
+        List& due = this->lists[dueList];
+        due = slot;
+        slot = List();
+        for (std::uint32_t i = due.head; i != nil; i = this->nodes[i].next)
+        {
+            this->nodes[i].list = dueList;
+        }
+        while (due.head != nil)
+        {
+            std::uint32_t index = due.head;
+            this->unlink(index);
+            Payload payload = this->nodes[index].payload;
+            this->release(index);
+            fire(payload);
+        }
+    }
+
+private:
+    static constexpr std::uint32_t nil = 0xFFFFFFFFu;
+    static constexpr std::uint32_t slotCount = slotsPerLevel * levelCount;
+    static constexpr std::uint32_t dueList = slotCount;
+    static constexpr std::uint32_t freeList = slotCount + 1;
+
+    struct Node
+    {
+        Payload payload{};
+        std::uint64_t due{ 0 };
+        // schedule order, what same tick timers fire by
+        std::uint64_t sequence{ 0 };
+        std::uint32_t prev{ nil }, next{ nil };
+        std::uint32_t list{ freeList };
+        std::uint32_t generation{ 0 };
+    };
+
+    struct List
+    {
+        std::uint32_t head{ nil }, tail{ nil };
+    };
+
+    std::vector<Node> nodes;
+    // every slot of every level, then the timers firing this tick
+    List lists[slotCount + 1];
+    std::uint32_t freeHead{ nil };
+    std::size_t count{ 0 };
+    std::uint64_t scheduled{ 0 };
+    std::uint64_t now{ 0 };
+    float accumulator{ 0.0f };
+
+    static std::uint32_t slotOf(int level, std::uint64_t tick)
+    {
+        return (std::uint32_t)level * slotsPerLevel + (std::uint32_t)((tick >> (levelBits * level)) & (slotsPerLevel - 1));
+    }
+
+    // the finest level whose span reaches the due tick
+    std::uint32_t slotFor(std::uint64_t due) const
+    {
+        std::uint64_t delay = due - this->now;
+        int level = 0;
+        while (level < levelCount - 1 && delay >= (1ull << (levelBits * (level + 1))))
+        {
+            level++;
+        }
+        return this->slotOf(level, due);
+    }
+
+    // into 'slot' right after 'before', at the head when it is nil
+    void link(std::uint32_t index, std::uint32_t slot, std::uint32_t before)
+    {
+        Node& node = this->nodes[index];
+        List& list = this->lists[slot];
+        node.list = slot;
+        node.prev = before;
+        node.next = before != nil ? this->nodes[before].next : list.head;
+        if (before != nil)
+        {
+            this->nodes[before].next = index;
+        }
+        else
+        {
+            list.head = index;
+        }
+        if (node.next != nil)
+        {
+            this->nodes[node.next].prev = index;
+        }
+        else
+        {
+            list.tail = index;
+        }
+    }
+
+    void unlink(std::uint32_t index)
+    {
+        Node& node = this->nodes[index];
+        List& list = this->lists[node.list];
+        if (node.prev != nil)
+        {
+            this->nodes[node.prev].next = node.next;
+        }
+        else
+        {
+            list.head = node.next;
+        }
+        if (node.next != nil)
+        {
+            this->nodes[node.next].prev = node.prev;
+        }
+        else
+        {
+            list.tail = node.prev;
+        }
+        node.prev = node.next = nil;
+    }
+
+    void release(std::uint32_t index)
+    {
+        Node& node = this->nodes[index];
+        node.list = freeList;
+        node.generation++;
+        node.payload = Payload();
+        node.next = this->freeHead;
+        this->freeHead = index;
+        this->count--;
+    }
+
+    // the slot and every finer list are in schedule order, so the timers coming down are merged
+    // in with one cursor per finer slot: past the ones scheduled before them, ahead of the ones
+    // scheduled straight into the finer slot after them. each list is walked once
+    void cascade(std::uint32_t slot)
+    {
+        std::uint32_t index = this->lists[slot].head;
+        this->lists[slot] = List();
+        std::uint32_t cursor[slotCount];
+        std::fill(cursor, cursor + slotCount, nil);
+        while (index != nil)
+        {
+            std::uint32_t next = this->nodes[index].next;
+            std::uint32_t target = this->slotFor(this->nodes[index].due);
+            std::uint32_t before = cursor[target];
+            std::uint32_t after = before != nil ? this->nodes[before].next : this->lists[target].head;
+            while (after != nil && this->nodes[after].sequence < this->nodes[index].sequence)
+            {
+                before = after;
+                after = this->nodes[after].next;
+            }
+            this->link(index, target, before);
+            cursor[target] = index;
+            index = next;
+        }
+    }
+};
+
+// --bench-timers: 'weapons' ships reloading every half second to four seconds, run for
+// 'ticks' ticks once on the wheel and once as per ship countdowns scanned every tick
+inline void benchmarkTimers(int weapons, int ticks)
+{
+    std::uint32_t state = 12345;
+    std::vector<std::uint32_t> reload(weapons);
+    for (int i = 0; i < weapons; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        reload[i] = 30 + (state >> 8) % 210;
+    }
+    typedef std::chrono::high_resolution_clock Clock;
+    auto seconds = [](Clock::time_point since) { return std::chrono::duration<double>(Clock::now() - since).count(); };
+
+    TimerWheel<std::uint32_t> wheel;
+    for (int i = 0; i < weapons; i++)
+    {
+        wheel.schedule(reload[i], (std::uint32_t)i);
+    }
+    std::uint64_t wheelShots = 0, wheelChecksum = 0;
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t < ticks; t++)
+    {
+        wheel.tick([&](std::uint32_t ship)
+            {
+                wheelShots++;
+                wheelChecksum += ship * wheel.currentTick();
+                wheel.schedule(reload[ship], ship);
+            });
+    }
+    double wheelSeconds = seconds(start);
+
+    std::vector<std::uint32_t> countdown(reload);
+    std::uint64_t scanShots = 0, scanChecksum = 0;
+    start = Clock::now();
+    for (int t = 0; t < ticks; t++)
+    {
+        for (int i = 0; i < weapons; i++)
+        {
+            if (--countdown[i] == 0)
+            {
+                countdown[i] = reload[i];
+                scanShots++;
+                scanChecksum += (std::uint64_t)i * (t + 1);
+            }
+        }
+    }
+    double scanSeconds = seconds(start);
+
+    std::cout << weapons << " weapons, " << ticks << " ticks, " << wheelShots << " shots" << std::endl;
+    std::cout << "  wheel: " << wheelSeconds * 1e6 / ticks << " us/tick, scan: " << scanSeconds * 1e6 / ticks << " us/tick" << std::endl;
+    std::cout << (wheelShots == scanShots && wheelChecksum == scanChecksum ? "  shots match the scan" : "  shots differ from the scan") << std::endl;
+}